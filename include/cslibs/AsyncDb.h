@@ -0,0 +1,158 @@
+/**
+ * @file AsyncDb.h
+ *
+ * @author dankeenan
+ * @date 5/16/21
+ * @copyright (c) 2021 Dan Keenan
+ */
+
+#ifndef CS_PROFILE_EDITOR_INCLUDE_CSLIBS_ASYNCDB_H_
+#define CS_PROFILE_EDITOR_INCLUDE_CSLIBS_ASYNCDB_H_
+
+#include <SQLiteCpp/Exception.h>
+#include <sqlite3.h>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include "DbPool.h"
+#include "WorkerPool.h"
+#include "except.h"
+
+namespace cslibs {
+
+/**
+ * Cancels queries submitted to AsyncDb.
+ *
+ * Copies share state, so cancelling any copy cancels them all.
+ */
+class CancelToken {
+ private:
+  struct State;
+
+ public:
+  /**
+   * Keeps an interrupt added by AddInterrupt() until destroyed.
+   */
+  class InterruptRegistration {
+   public:
+    InterruptRegistration(InterruptRegistration &&other) noexcept;
+    InterruptRegistration(const InterruptRegistration &) = delete;
+    InterruptRegistration &operator=(const InterruptRegistration &) = delete;
+    InterruptRegistration &operator=(InterruptRegistration &&) = delete;
+    /**
+     * Remove the interrupt.  Waits for a concurrent Cancel() to finish using it.
+     */
+    ~InterruptRegistration();
+
+   private:
+    friend class CancelToken;
+    InterruptRegistration(std::shared_ptr<State> state, std::uint64_t id);
+
+    std::shared_ptr<State> state_;
+    std::uint64_t id_;
+  };
+
+  CancelToken();
+
+  /**
+   * Cancel the queries using this token.
+   *
+   * A query that has not started will not run; running queries are interrupted.  Either way, their futures throw
+   * except::QueryCancelled.  Safe to call from any thread, any number of times.
+   */
+  void Cancel();
+
+  [[nodiscard]] bool IsCancelled() const;
+
+  /**
+   * Add a function Cancel() uses to stop a running query.
+   *
+   * Each query sharing the token adds its own interrupt, so Cancel() stops all of them.
+   *
+   * @param interrupt
+   * @return The registration, which removes @p interrupt when destroyed; nothing if already cancelled.
+   */
+  [[nodiscard]] std::optional<InterruptRegistration> AddInterrupt(std::function<void()> interrupt);
+
+ private:
+  std::shared_ptr<State> state_;
+};
+
+/**
+ * Runs queries on worker threads, each with a connection from a pool.
+ *
+ * @tparam T Db subclass the queries use
+ */
+template<class T>
+class AsyncDb {
+ public:
+  /**
+   * @param pool Connections to use; may hold a subclass of @p T.
+   * @param workers
+   */
+  template<class U, typename = std::enable_if_t<std::is_base_of_v<T, U>>>
+  AsyncDb(std::shared_ptr<DbPool<U>> pool, std::shared_ptr<WorkerPool> workers) :
+      acquire_([pool = std::move(pool)]() -> std::shared_ptr<T> {
+        // The connection is returned when the last reference to it goes away; keep the pool alive until then.
+        struct Holder {
+          std::shared_ptr<DbPool<U>> pool;
+          typename DbPool<U>::Lease lease;
+        };
+        auto holder = std::make_shared<Holder>(Holder{pool, pool->Acquire()});
+        return std::shared_ptr<T>(holder, &*holder->lease);
+      }),
+      workers_(std::move(workers)) {}
+
+  /**
+   * Use the same connections as @p other, through a base class.
+   * @param other
+   */
+  template<class U, typename = std::enable_if_t<std::is_base_of_v<T, U> && !std::is_same_v<T, U>>>
+  explicit AsyncDb(const AsyncDb<U> &other) :
+      acquire_([acquire = other.acquire_]() -> std::shared_ptr<T> { return acquire(); }),
+      workers_(other.workers_) {}
+
+  /**
+   * Queue @p query to run on a worker thread.
+   *
+   * @param query Callable taking a `T &`.  The connection must not be used after it returns.
+   * @param token
+   * @return Future holding the query's result or exception.  Throws except::QueryCancelled if @p token was cancelled.
+   */
+  template<typename Query>
+  std::future<std::invoke_result_t<Query, T &>> Submit(Query query, CancelToken token = {}) {
+    return workers_->Submit([acquire = acquire_, query = std::move(query), token]() mutable {
+      if (token.IsCancelled()) {
+        throw except::QueryCancelled();
+      }
+      const std::shared_ptr<T> db = acquire();
+      // Declared after the connection, so the interrupt is removed before the connection is returned.
+      const auto interrupt_registration = token.AddInterrupt([&db]() { db->Interrupt(); });
+      if (!interrupt_registration.has_value()) {
+        throw except::QueryCancelled();
+      }
+
+      try {
+        return query(*db);
+      } catch (const SQLite::Exception &e) {
+        if (e.getErrorCode() == SQLITE_INTERRUPT) {
+          throw except::QueryCancelled();
+        }
+        throw;
+      }
+    });
+  }
+
+ private:
+  template<class> friend class AsyncDb;
+
+  std::function<std::shared_ptr<T>()> acquire_;
+  std::shared_ptr<WorkerPool> workers_;
+};
+
+} // cslibs
+
+#endif //CS_PROFILE_EDITOR_INCLUDE_CSLIBS_ASYNCDB_H_
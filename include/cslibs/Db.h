@@ -10,7 +10,11 @@
 #define CS_PROFILE_EDITOR_INCLUDE_CSLIBS_DB_H_
 
 #include <SQLiteCpp/Database.h>
+#include <SQLiteCpp/Statement.h>
+#include <array>
 #include <functional>
+#include <memory>
+#include <mutex>
 #include "DefsFile.h"
 #include "Entity.h"
 
@@ -28,9 +32,47 @@ class Db {
    */
   using ProgressCallback = std::function<void(unsigned long, unsigned long)>;
 
+  /**
+   * Record found by Search()
+   */
+  struct SearchResult {
+    /** Row id in the database's records */
+    std::int64_t id;
+    std::string dcid;
+    std::string code;
+    std::string name;
+    std::string manufacturer;
+    std::string series;
+    /**
+     * Lower is a better match; only comparable between results from the same query.
+     *
+     * Full-text matches have negative ranks.  Without the full-text index, results are ranked 1, 2, 3... in name
+     * order, after any full-text match.
+     */
+    double rank;
+  };
+
+  /**
+   * Connection settings used while Update() runs.
+   *
+   * The previous settings are restored once the import finishes.
+   */
+  struct ImportPragmas {
+    /** PRAGMA synchronous; 0 == OFF.  Safe because the import is one transaction. */
+    int synchronous = 0;
+    /** PRAGMA cache_size; negative values are in KiB. */
+    int cache_size = -64 * 1024;
+    /** PRAGMA temp_store; 2 == MEMORY */
+    int temp_store = 2;
+  };
+
   /**
    * Open the database at @p db_path with defs from @p defs_path
    *
+   * Use one writer per database and as many read-only connections as needed (e.g. from a DbPool).  The database is
+   * in WAL mode, so readers neither wait for nor block the writer.  Read-only connections skip SQLite's locking, so
+   * each must only be used by one thread at a time; the writer may be shared between threads.
+   *
    * @param defs_path
    * @param db_path
    * @param allow_writing
@@ -44,37 +86,179 @@ class Db {
    *
    * @return
    */
-  [[nodiscard]] bool UpToDate();
+  [[nodiscard]] virtual bool UpToDate();
 
   /**
    * Initialize the database.
    *
+   * The import runs in a single transaction; if it fails, the previous contents are kept.
+   *
    * @throws except::DefsError When the defs file cannot be parsed.
    */
   void Update(const ProgressCallback &progress_callback = {});
 
+  /**
+   * Set the connection settings used by Update().
+   * @param import_pragmas
+   */
+  void SetImportPragmas(const ImportPragmas &import_pragmas) {
+    import_pragmas_ = import_pragmas;
+  }
+
   /**
    * Clear the database
    */
   void Reset();
 
+  /**
+   * Upgrade the database schema in place.
+   *
+   * Does nothing if the schema is current or the database is read-only.  Update() also calls this.
+   *
+   * @throws except::DbError When the upgrade fails.
+   */
+  void Migrate();
+
+  /**
+   * Make the query running on this connection stop as soon as possible.
+   *
+   * Safe to call from any thread.  The interrupted query throws SQLite::Exception with SQLITE_INTERRUPT; queries
+   * started after it returns are not affected.
+   */
+  void Interrupt();
+
   [[nodiscard]] std::vector<Manufacturer> GetManufacturers();
   [[nodiscard]] std::vector<Series> GetSeriesForManufacturer(const Manufacturer &manufacturer);
 
+  /**
+   * Case-insensitive collation, registered on every connection.
+   *
+   * Orders text the same way as boost::algorithm::ilexicographical_compare, which SQLite's NOCASE does not (NOCASE
+   * folds to lower case, so it sorts e.g. "_" differently).
+   */
+  static inline const auto kCollation = "ICASE";
+
+  /**
+   * Find records whose code, name, manufacturer, or series start with every word in @p query.
+   *
+   * Uses the full-text index built by Update(); databases without one (e.g. when SQLite was built without FTS5, or
+   * before the next Update()) fall back to a slower substring search.
+   *
+   * @param query
+   * @param limit
+   * @return Best match first.
+   */
+  [[nodiscard]] std::vector<SearchResult> Search(const std::string &query, std::size_t limit);
+
+  /**
+   * Search() several databases and merge the results.
+   *
+   * @param dbs Missing databases are skipped.
+   * @param query
+   * @param limit
+   * @return Pairs of (index into @p dbs, result), best match first.
+   */
+  [[nodiscard]] static std::vector<std::pair<std::size_t, SearchResult>> SearchAll(const std::vector<std::shared_ptr<Db>> &dbs,
+                                                                                   const std::string &query,
+                                                                                   std::size_t limit);
+
+  /**
+   * Merge results from Search() on several databases.
+   *
+   * Full-text ranks are scaled so the best match from each database has rank -1, which makes them comparable.
+   *
+   * @param results Results from each database.
+   * @param limit
+   * @return Pairs of (index into @p results, result), best match first.
+   */
+  [[nodiscard]] static std::vector<std::pair<std::size_t, SearchResult>> MergeSearchResults(std::vector<std::vector<SearchResult>> results,
+                                                                                            std::size_t limit);
+
+
  protected:
+  /** How long to wait for a lock (e.g. while the WAL is checkpointed) before failing, in milliseconds */
+  static inline const int kBusyTimeout = 5000;
   std::string defs_file_path_;
   std::optional<SQLite::Database> db_;
+  ImportPragmas import_pragmas_;
+
+  /**
+   * Change to the schema of an existing database.
+   */
+  using Migration = std::function<void()>;
 
+  /**
+   * Table containing this database's records
+   * @return
+   */
+  [[nodiscard]] virtual const char *GetBaseTable() const = 0;
   virtual void CreateTables() = 0;
+  /**
+   * Get the migrations for this database, oldest first.
+   *
+   * The schema version is the number of migrations applied.  New databases start at the latest version, because
+   * CreateTables() creates the current schema.
+   *
+   * @return
+   */
+  [[nodiscard]] virtual std::vector<Migration> GetMigrations() {
+    return {};
+  }
   virtual void LoadFromDefsFile(const ProgressCallback &progress_callback) = 0;
   virtual void ClearRecords() = 0;
   void SetUserVersion(const DefsFile::Version &version);
   void CreateManufacturerSeriesTables();
   void Optimize();
+  [[nodiscard]] unsigned int GetSchemaVersion();
+  /**
+   * Get a value that changes whenever another connection commits to the database.
+   *
+   * Use to notice when caches of the records are out of date.
+   * @return
+   */
+  [[nodiscard]] std::int64_t GetDataVersion();
+  [[nodiscard]] ImportPragmas GetPragmas();
+  void ApplyPragmas(const ImportPragmas &pragmas);
+  /**
+   * Open the connection, closing the current one if any.
+   * @param db_path
+   * @param allow_writing
+   */
+  void Open(const std::string &db_path, bool allow_writing);
   void ReOpen(const std::string &db_path, bool allow_writing);
+  void RegisterCollation();
+  /**
+   * Rebuild the full-text search table from the records, if this SQLite supports it.
+   */
+  void CreateSearchIndex();
+  /**
+   * Split @p query into words.
+   * @param query
+   * @return
+   */
+  [[nodiscard]] static std::vector<std::string> GetSearchTerms(const std::string &query);
   void UseFreshDatabase(const std::string &db_path, bool allow_writing);
   bool DatabaseIsReadOnly();
 
+  /**
+   * Statements used for every record during import, prepared once per import.
+   */
+  struct ImportStatements {
+    explicit ImportStatements(SQLite::Database &db);
+
+    SQLite::Statement manufacturer_get;
+    SQLite::Statement manufacturer_insert;
+    SQLite::Statement series_get;
+    SQLite::Statement series_insert;
+  };
+  /** Only set while importing; use GetImportStatements(). */
+  std::optional<ImportStatements> import_statements_;
+  /**
+   * Get the import statements, preparing them if needed.
+   * @return
+   */
+  [[nodiscard]] ImportStatements &GetImportStatements();
+
   using ManufacturerIdCache = std::unordered_map<std::string, unsigned int>;
   using SeriesIdCache = std::unordered_map<unsigned int, std::unordered_map<std::string, unsigned int>>;
   /**
@@ -106,6 +290,32 @@ class ImageDb : public Db {
     kCode,
   };
 
+  /**
+   * How images are stored
+   */
+  enum class ImageStorage {
+    /** Copy the image into the database */
+    kBlob,
+    /**
+     * Store the image's location in the data file; the data file must not change.
+     *
+     * Once the data file has moved between imports, later imports copy images like kBlob instead.
+     */
+    kReference,
+  };
+
+  /**
+   * Callback that renders a thumbnail of an image, taking arguments:
+   * - image data
+   * - size in pixels; the thumbnail must fit in a square of this size
+   *
+   * Returns the encoded thumbnail, or none if the image cannot be rendered.  Called from multiple threads at once.
+   */
+  using ThumbnailRenderer = std::function<std::optional<std::vector<char>>(std::string_view, unsigned int)>;
+
+  /** Thumbnail sizes rendered by Update(), in pixels */
+  static inline const std::array<unsigned int, 2> kThumbnailSizes{32, 64};
+
   /**
    * Open the database at @p db_path with defs from @p defs_path
    *
@@ -125,6 +335,24 @@ class ImageDb : public Db {
 
   [[nodiscard]] virtual std::vector<ImageEntity> GetForSeries(const Series &series, Sort sort_by = Sort::kCode);
 
+  /**
+   * Like GetForSeries(), but without loading any images.
+   *
+   * Use GetImagesForDcids() to fetch the images that are needed.
+   *
+   * @param series
+   * @param sort_by
+   * @return
+   */
+  [[nodiscard]] std::vector<ImageEntityInfo> GetInfoForSeries(const Series &series, Sort sort_by = Sort::kCode);
+
+  /**
+   * Get the images associated with @p dcids in as few queries as possible.
+   * @param dcids
+   * @return dcid => image; dcids without an image are left out.
+   */
+  [[nodiscard]] std::unordered_map<std::string, std::vector<char>> GetImagesForDcids(const std::vector<std::string> &dcids);
+
   /**
    * Get the image associated with the given @p dcid.
    * @param dcid
@@ -132,16 +360,150 @@ class ImageDb : public Db {
    */
   [[nodiscard]] virtual std::optional<std::vector<char>> GetImageForDcid(const std::string &dcid);
 
+  /**
+   * Get the image in the row with the given @p id.
+   * @param id
+   * @return
+   */
+  [[nodiscard]] std::optional<std::vector<char>> GetImageForId(std::int64_t id);
+
+  /**
+   * Get the dcid and row id of every image.
+   * @return
+   */
+  [[nodiscard]] std::vector<std::pair<std::string, std::int64_t>> GetDcidIds();
+
+  /**
+   * Also returns FALSE when stored image references no longer match the data file.
+   * @return
+   */
+  [[nodiscard]] bool UpToDate() override;
+
+  /**
+   * Set how Update() stores images.
+   * @param image_storage
+   */
+  void SetImageStorage(ImageStorage image_storage) {
+    image_storage_ = image_storage;
+  }
+
+  /**
+   * Set how Update() renders thumbnails.  Update() does not create thumbnails without a renderer.
+   * @param thumbnail_renderer
+   */
+  void SetThumbnailRenderer(ThumbnailRenderer thumbnail_renderer) {
+    thumbnail_renderer_ = std::move(thumbnail_renderer);
+  }
+
+  /**
+   * Get the thumbnails associated with @p dcids.
+   * @param dcids
+   * @param size One of kThumbnailSizes
+   * @return dcid => thumbnail; dcids without a thumbnail are left out.
+   */
+  [[nodiscard]] std::unordered_map<std::string, std::vector<char>> GetThumbnailsForDcids(const std::vector<std::string> &dcids,
+                                                                                         unsigned int size);
+
+  /**
+   * Get the thumbnail for the image in the row with the given @p id.
+   * @param id
+   * @param size One of kThumbnailSizes
+   * @return
+   */
+  [[nodiscard]] std::optional<std::vector<char>> GetThumbnailForId(std::int64_t id, unsigned int size);
+
  protected:
   void CreateTables() override;
   void ClearRecords() override;
+  [[nodiscard]] std::vector<Migration> GetMigrations() override;
 
- protected:
   std::string data_index_path_;
   std::string data_path_;
+  /** Binary copy of the data index, shared by all image databases in the same directory */
+  std::string data_index_cache_path_;
+  ImageStorage image_storage_ = ImageStorage::kBlob;
+  ThumbnailRenderer thumbnail_renderer_;
+  /** Keeps the number of bound parameters well under SQLite's limit */
+  static inline const std::size_t kMaxDcidsPerQuery = 256;
 
-  [[nodiscard]] virtual const char *GetBaseTable() const = 0;
   virtual void CreateImageTable();
+  void CreateThumbnailTable();
+  void CreateSortIndexes();
+
+  /**
+   * Decide how the next import stores images.  Call before importing.
+   *
+   * @return kReference if requested and the data file can be relied on, otherwise kBlob.
+   */
+  [[nodiscard]] ImageStorage GetImportImageStorage();
+
+  /**
+   * Remember which data file image references point into.  Call after importing.
+   *
+   * @param image_storage How the import stored images, from GetImportImageStorage().
+   */
+  void SaveImageSource(ImageStorage image_storage);
+
+  /**
+   * Get the referenced image from the data file.
+   *
+   * @param offset
+   * @param size
+   * @return The image, or none if the data file has changed since import.
+   */
+  [[nodiscard]] std::optional<std::string_view> GetReferencedImage(unsigned long offset, unsigned long size);
+
+  /**
+   * Read the image from the first row of @p q, which selects image, image_offset, and image_size.
+   * @param q
+   * @return
+   */
+  [[nodiscard]] std::optional<std::vector<char>> ReadImage(SQLite::Statement &q);
+
+  /**
+   * Get a list of @p count SQL parameter placeholders, for use with IN.
+   * @param count
+   * @return
+   */
+  [[nodiscard]] static std::string MakePlaceholders(std::size_t count);
+
+ private:
+  /** Data file identity, as stored in the image_source table */
+  struct ImageSource {
+    std::int64_t size;
+    std::int64_t modified;
+
+    bool operator==(const ImageSource &rhs) const {
+      return size == rhs.size && modified == rhs.modified;
+    }
+  };
+  /** Mapping of the data file, and the file's identity when it was mapped */
+  struct DataFile {
+    ImageSource source;
+    std::shared_ptr<const MappedFile> file;
+  };
+  /**
+   * Guards data_file_, which is filled on first use by whichever thread gets there first.  Held by pointer so the
+   * database stays movable.
+   */
+  std::unique_ptr<std::mutex> data_file_mutex_ = std::make_unique<std::mutex>();
+  /** Only holds a mapping that the stored references point into; failures are not kept, so they are tried again. */
+  std::optional<DataFile> data_file_;
+
+  [[nodiscard]] std::optional<ImageSource> GetCurrentImageSource() const;
+  /**
+   * Get the data file's path in the form stored in the image_source table.
+   * @return
+   */
+  [[nodiscard]] std::string GetDataPathForSource() const;
+  /**
+   * Get the data file, if it is the one that the stored references point into.
+   *
+   * The file is checked on every call, so a data file that is replaced while open is mapped again (or rejected).
+   * @return
+   */
+  [[nodiscard]] std::shared_ptr<const MappedFile> GetReferencedDataFile();
+  [[nodiscard]] bool HasImageReferences();
 };
 
 } // cslibs
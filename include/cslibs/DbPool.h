@@ -0,0 +1,177 @@
+/**
+ * @file DbPool.h
+ *
+ * @author dankeenan
+ * @date 5/16/21
+ * @copyright (c) 2021 Dan Keenan
+ */
+
+#ifndef CS_PROFILE_EDITOR_INCLUDE_CSLIBS_DBPOOL_H_
+#define CS_PROFILE_EDITOR_INCLUDE_CSLIBS_DBPOOL_H_
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace cslibs {
+
+/**
+ * Set of database connections, each used by one thread at a time.
+ *
+ * Connections are opened on demand, up to the limit, and kept open for reuse.
+ *
+ * @tparam T Db subclass
+ */
+template<class T>
+class DbPool {
+ public:
+  /**
+   * Opens a new connection.
+   */
+  using Factory = std::function<std::unique_ptr<T>()>;
+
+  /**
+   * Connection borrowed from the pool; returned when destroyed.
+   */
+  class Lease {
+   public:
+    Lease(Lease &&other) noexcept:
+        pool_(std::exchange(other.pool_, nullptr)), db_(std::move(other.db_)), generation_(other.generation_) {}
+    Lease &operator=(Lease &&other) noexcept {
+      if (this != &other) {
+        Return();
+        pool_ = std::exchange(other.pool_, nullptr);
+        db_ = std::move(other.db_);
+        generation_ = other.generation_;
+      }
+      return *this;
+    }
+    Lease(const Lease &) = delete;
+    Lease &operator=(const Lease &) = delete;
+
+    ~Lease() {
+      Return();
+    }
+
+    T &operator*() const {
+      return *db_;
+    }
+
+    T *operator->() const {
+      return db_.get();
+    }
+
+   private:
+    friend DbPool;
+    DbPool *pool_;
+    std::unique_ptr<T> db_;
+    unsigned int generation_;
+
+    Lease(DbPool *pool, std::unique_ptr<T> db, unsigned int generation) :
+        pool_(pool), db_(std::move(db)), generation_(generation) {}
+
+    void Return() {
+      if (pool_ != nullptr) {
+        pool_->Release(std::move(db_), generation_);
+        pool_ = nullptr;
+      }
+    }
+  };
+
+  /**
+   * @param factory
+   * @param max_size Most connections open at once; 0 == one per hardware thread
+   */
+  explicit DbPool(Factory factory, unsigned int max_size = 0) :
+      factory_(std::move(factory)),
+      max_size_(max_size == 0 ? std::max(1u, std::thread::hardware_concurrency()) : max_size) {}
+
+  DbPool(const DbPool &) = delete;
+  DbPool &operator=(const DbPool &) = delete;
+
+  /**
+   * Borrow a connection, waiting for one to be returned if the pool is at its limit.
+   *
+   * The pool must outlive the lease.
+   *
+   * @return
+   * @throws Whatever the factory throws.
+   */
+  [[nodiscard]] Lease Acquire() {
+    std::unique_lock lock(mutex_);
+    available_.wait(lock, [this]() { return !idle_.empty() || open_count_ < max_size_; });
+    const auto generation = generation_;
+    if (!idle_.empty()) {
+      auto db = std::move(idle_.back());
+      idle_.pop_back();
+      return Lease(this, std::move(db), generation);
+    }
+
+    // Open outside the lock; opening may take a while.
+    ++open_count_;
+    lock.unlock();
+    try {
+      return Lease(this, factory_(), generation);
+    } catch (...) {
+      lock.lock();
+      --open_count_;
+      lock.unlock();
+      available_.notify_one();
+      throw;
+    }
+  }
+
+  /**
+   * Close all connections, e.g. after the database has been rebuilt.
+   *
+   * Connections that are currently leased are closed when they are returned.
+   */
+  void Clear() {
+    std::vector<std::unique_ptr<T>> closing;
+    {
+      std::lock_guard lock(mutex_);
+      ++generation_;
+      open_count_ -= idle_.size();
+      closing.swap(idle_);
+    }
+    available_.notify_all();
+  }
+
+  [[nodiscard]] unsigned int GetMaxSize() const {
+    return max_size_;
+  }
+
+ private:
+  Factory factory_;
+  const unsigned int max_size_;
+  /** Connections that exist, leased or idle */
+  unsigned int open_count_ = 0;
+  /** Incremented by Clear(); leases from older generations are closed on return. */
+  unsigned int generation_ = 0;
+  std::vector<std::unique_ptr<T>> idle_;
+  std::mutex mutex_;
+  std::condition_variable available_;
+
+  void Release(std::unique_ptr<T> db, unsigned int generation) {
+    {
+      std::lock_guard lock(mutex_);
+      if (generation == generation_) {
+        idle_.push_back(std::move(db));
+      } else {
+        --open_count_;
+      }
+    }
+    // Close stale connections outside the lock.
+    db.reset();
+    available_.notify_one();
+  }
+};
+
+} // cslibs
+
+#endif //CS_PROFILE_EDITOR_INCLUDE_CSLIBS_DBPOOL_H_
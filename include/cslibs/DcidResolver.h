@@ -0,0 +1,85 @@
+/**
+ * @file DcidResolver.h
+ *
+ * @author dankeenan
+ * @date 5/16/21
+ * @copyright (c) 2021 Dan Keenan
+ */
+
+#ifndef CS_PROFILE_EDITOR_INCLUDE_CSLIBS_DCIDRESOLVER_H_
+#define CS_PROFILE_EDITOR_INCLUDE_CSLIBS_DCIDRESOLVER_H_
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Db.h"
+
+namespace cslibs {
+
+/**
+ * Find which image library a dcid belongs to without querying every library.
+ *
+ * Keeps an in-memory map of every dcid in the libraries.  Not thread safe.
+ */
+class DcidResolver {
+ public:
+  /**
+   * Where a dcid's image is stored
+   */
+  struct Location {
+    /** Index into the libraries passed to the constructor */
+    std::uint8_t library;
+    /** Row id in that library */
+    std::int64_t id;
+  };
+
+  /**
+   * Load the dcids from @p libraries.
+   *
+   * @param libraries Searched in order; when a dcid is in more than one library, the first library wins.
+   */
+  explicit DcidResolver(std::vector<std::shared_ptr<ImageDb>> libraries);
+
+  /**
+   * Re-read the dcids from the libraries, e.g. after updating them.
+   */
+  void Reload();
+
+  /**
+   * Find the location of @p dcid.
+   *
+   * @param dcid
+   * @return The location, or none if no library has @p dcid.
+   */
+  [[nodiscard]] std::optional<Location> Resolve(const std::string &dcid) const;
+
+  /**
+   * Get the image associated with the given @p dcid from whichever library has it.
+   * @param dcid
+   * @return
+   */
+  [[nodiscard]] std::optional<std::vector<char>> GetImageForDcid(const std::string &dcid) const;
+
+  /**
+   * Get the thumbnail associated with the given @p dcid from whichever library has it.
+   * @param dcid
+   * @param size One of ImageDb::kThumbnailSizes
+   * @return
+   */
+  [[nodiscard]] std::optional<std::vector<char>> GetThumbnailForDcid(const std::string &dcid, unsigned int size) const;
+
+  [[nodiscard]] std::size_t GetSize() const {
+    return index_.size();
+  }
+
+ private:
+  std::vector<std::shared_ptr<ImageDb>> libraries_;
+  std::unordered_map<std::string, Location> index_;
+};
+
+} // cslibs
+
+#endif //CS_PROFILE_EDITOR_INCLUDE_CSLIBS_DCIDRESOLVER_H_
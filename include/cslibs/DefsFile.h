@@ -10,11 +10,16 @@
 #define CS_PROFILE_EDITOR_INCLUDE_CSLIBS_DEFSFILE_H_
 
 #include <iterator>
+#include <memory>
 #include <fstream>
+#include <string_view>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 #include <optional>
+#include <boost/container/small_vector.hpp>
+#include "ImageDataIndex.h"
+#include "MappedFile.h"
 
 namespace cslibs {
 
@@ -47,8 +52,51 @@ class DefsFile {
     }
   };
 
+  /**
+   * File header
+   */
+  struct Header {
+    /** Contents of the IDENT line, empty if not found */
+    std::string ident;
+    Version version;
+
+    /**
+     * Is this a file format this class can read?
+     * @return
+     */
+    [[nodiscard]] bool IsValid() const {
+      return ident == kIdent;
+    }
+  };
+
+  /**
+   * List of values in a record field (e.g. `Apollo,Gel`).
+   *
+   * Sized so typical fields don't need heap allocation.
+   */
+  using ValueList = boost::container::small_vector<std::string_view, 8>;
+
+  /**
+   * Record that refers to the file contents instead of copying them.
+   *
+   * Only valid for the lifetime of the DefsFile that created it.
+   */
+  struct DefView {
+    std::string_view record_name;
+    boost::container::small_vector<std::pair<std::string_view, std::string_view>, 8> contents;
+
+    /**
+     * Get the value for @p key.
+     *
+     * @param key
+     * @return The value, or none if the record does not contain @p key.
+     */
+    [[nodiscard]] std::optional<std::string_view> Get(std::string_view key) const;
+  };
+
   struct Def {
     explicit Def(std::string name) : record_name(std::move(name)) {}
+    explicit Def(const DefView &view);
 
     std::string record_name;
     std::unordered_map<std::string, std::string> contents;
@@ -63,8 +111,27 @@ class DefsFile {
     }
   };
 
+  /**
+   * Open the defs file at @p file_path.
+   *
+   * The file is mapped into memory for the lifetime of this object.
+   *
+   * @param file_path
+   * @throws except::DefsError When the file cannot be read or is not valid.
+   */
   explicit DefsFile(const std::string &file_path);
 
+  /**
+   * Read the header of the defs file at @p file_path without loading the rest of the file.
+   *
+   * Only the first kHeaderProbeSize bytes are read.
+   *
+   * @param file_path
+   * @return
+   * @throws except::DefsError When the file cannot be read.
+   */
+  [[nodiscard]] static Header ProbeHeader(const std::string &file_path);
+
   /**
    * Get data version.
    * @return
@@ -79,14 +146,50 @@ class DefsFile {
    */
   [[nodiscard]] std::optional<Def> GetNextRecord();
 
-  [[nodiscard]] unsigned long GetSize();
-  [[nodiscard]] unsigned long GetPosition();
+  /**
+   * Fetch the next record in the file without copying its contents, or none if no records remain.
+   * @return
+   */
+  [[nodiscard]] std::optional<DefView> GetNextRecordView();
+
+  /**
+   * Split a field value on commas.
+   *
+   * @param value
+   * @return Views into @p value.
+   */
+  [[nodiscard]] static ValueList SplitValue(std::string_view value);
+
+  [[nodiscard]] unsigned long GetSize() const;
+  [[nodiscard]] unsigned long GetPosition() const;
 
  protected:
-  std::ifstream file_stream_;
+  MappedFile file_;
+  /** Offset of the next unread line */
+  std::string_view::size_type position_ = 0;
   Version version_;
-  std::optional<unsigned long> size_;
+  /** Record name found at the end of the last call to GetNextRecordView() */
+  std::optional<std::string_view> next_record_name_;
   static inline const auto kIdent = "3:0";
+  /** The header is always near the start of the file; this is plenty. */
+  static inline const std::size_t kHeaderProbeSize = 8 * 1024;
+
+  /**
+   * Find the header fields in @p data.
+   *
+   * Stops as soon as both fields are found.
+   *
+   * @param data
+   * @return
+   * @throws except::DefsError When the version is malformed.
+   */
+  [[nodiscard]] static Header ScanHeader(std::string_view data);
+
+  /**
+   * Read the next line, not including the line terminator.
+   * @return The line, or none at EOF.
+   */
+  [[nodiscard]] std::optional<std::string_view> GetNextLine();
 };
 
 /**
@@ -94,33 +197,44 @@ class DefsFile {
  */
 class ImageDefsFile : public DefsFile {
  public:
-
+  /**
+   * @param file_path
+   * @param data_index_path *.idx file
+   * @param data_path *.dat file
+   * @param data_index_cache_path Where to cache the parsed *.idx file; empty to not cache it.
+   * @throws except::DefsError When a file cannot be read or is not valid.
+   */
   explicit ImageDefsFile(const std::string &file_path,
                          const std::string &data_index_path,
-                         const std::string &data_path);
+                         const std::string &data_path,
+                         const std::string &data_index_cache_path = {});
 
   /**
    * Get the data for the given type and dcid, or none if there is no data.
    *
+   * Safe to call from multiple threads.
+   *
    * @param type
    * @param dcid
+   * @return View into the data file, valid for the lifetime of this object.
+   */
+  [[nodiscard]] std::optional<std::string_view> GetDataForDcid(std::string_view type, std::string_view dcid) const;
+
+  /**
+   * Get the position of @p data in the data file.
+   *
+   * @param data A view returned by GetDataForDcid().
    * @return
    */
-  [[nodiscard]] std::optional<std::vector<char>> GetDataForDcid(const std::string &type, const std::string &dcid);
+  [[nodiscard]] std::size_t GetDataOffset(std::string_view data) const {
+    return data.data() - data_file_.GetData().data();
+  }
 
  private:
-  struct DataPosition {
-    unsigned int offset = 0;
-    /** -1 == until EOF */
-    int size = -1;
-  };
-
-  std::ifstream data_index_stream_;
-  std::ifstream data_stream_;
-  /** Cache: Media type > dcid > offset in data file */
-  std::unordered_map<std::string, std::unordered_map<std::string, DataPosition>> type_dcid_offsets_;
+  std::shared_ptr<const ImageDataIndex> data_index_;
+  MappedFile data_file_;
 
-  void LoadOffsetsForType(const std::string &type);
+  static MappedFile OpenDataFile(const std::string &data_path);
 };
 
 } // cslibs
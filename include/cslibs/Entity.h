@@ -77,6 +77,47 @@ class Series {
   std::string name_;
 };
 
+/**
+ * Image entity without its image, for listings.
+ */
+class ImageEntityInfo {
+  friend std::ostream &operator<<(std::ostream &out, const ImageEntityInfo &info) {
+    out << "<ImageEntityInfo " << info.dcid_ << ": " << info.code_ << ", " << info.name_ << ">";
+    return out;
+  }
+
+ public:
+  explicit ImageEntityInfo(std::string dcid, std::string code, std::string name) :
+      dcid_(std::move(dcid)), code_(std::move(code)), name_(std::move(name)) {}
+
+  [[nodiscard]] const std::string &GetDcid() const {
+    return dcid_;
+  }
+
+  [[nodiscard]] const std::string &GetCode() const {
+    return code_;
+  }
+
+  [[nodiscard]] const std::string &GetName() const {
+    return name_;
+  }
+
+  bool operator==(const ImageEntityInfo &rhs) const {
+    return dcid_ == rhs.dcid_ &&
+        code_ == rhs.code_ &&
+        name_ == rhs.name_;
+  }
+
+  bool operator!=(const ImageEntityInfo &rhs) const {
+    return !(rhs == *this);
+  }
+
+ private:
+  std::string dcid_;
+  std::string code_;
+  std::string name_;
+};
+
 class ImageEntity {
   friend std::ostream &operator<<(std::ostream &out, const ImageEntity &gobo) {
     out << "<ImageEntity " << gobo.dcid_ << ": " << gobo.code_ << ", " << gobo.name_ << ", (" << gobo.image_.size()
@@ -0,0 +1,153 @@
+/**
+ * @file ImageDataIndex.h
+ *
+ * @author dankeenan
+ * @date 5/9/21
+ * @copyright (c) 2021 Dan Keenan
+ */
+
+#ifndef CS_PROFILE_EDITOR_INCLUDE_CSLIBS_IMAGEDATAINDEX_H_
+#define CS_PROFILE_EDITOR_INCLUDE_CSLIBS_IMAGEDATAINDEX_H_
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "MappedFile.h"
+
+namespace cslibs {
+
+/**
+ * Location of every image in the image data file (CSEDIT_IMAGES.idx)
+ *
+ * The text index is converted to a compact binary form sorted by type and dcid, which can be saved to a cache file
+ * and memory-mapped the next time instead of parsing the text again.
+ */
+class ImageDataIndex {
+ public:
+  /**
+   * Location of an image in the data file
+   */
+  struct Position {
+    unsigned int offset = 0;
+    /** -1 == until EOF */
+    int size = -1;
+  };
+
+  /**
+   * Get the index for the file at @p data_index_path.
+   *
+   * The index is shared by everything that uses the same file, so it is only parsed once.  It is parsed again if the
+   * file changes.
+   *
+   * @param data_index_path
+   * @param cache_path Where to keep the binary index; empty to not use one.  Cache files that are out of date or
+   * unreadable are replaced.
+   * @return
+   * @throws except::DefsError When the file cannot be read or is malformed.
+   */
+  [[nodiscard]] static std::shared_ptr<const ImageDataIndex> Load(const std::string &data_index_path,
+                                                                  const std::string &cache_path = {});
+
+  /**
+   * Find the image with the given @p type and @p dcid.
+   *
+   * @param type
+   * @param dcid
+   * @return The position, or none if there is no such image.
+   */
+  [[nodiscard]] std::optional<Position> Find(std::string_view type, std::string_view dcid) const;
+
+  /**
+   * Was this index read from the cache file?
+   * @return
+   */
+  [[nodiscard]] bool IsFromCache() const {
+    return mapped_.has_value();
+  }
+
+ private:
+  /** Identifies the source file */
+  struct Source {
+    std::uint64_t size;
+    std::int64_t modified;
+
+    bool operator==(const Source &rhs) const {
+      return size == rhs.size && modified == rhs.modified;
+    }
+  };
+
+  /**
+   * Start of the binary index.  Followed by the entries, then the strings they refer to.
+   */
+  struct Header {
+    char magic[8];
+    std::uint32_t format_version;
+    std::uint32_t entry_count;
+    /** Size of the strings after the entries */
+    std::uint32_t strings_size;
+    std::uint32_t reserved;
+    Source source;
+  };
+
+  struct Entry {
+    /** Offset of the type in the strings */
+    std::uint32_t type_offset;
+    /** Offset of the dcid in the strings */
+    std::uint32_t dcid_offset;
+    std::uint16_t type_size;
+    std::uint16_t dcid_size;
+    std::uint32_t offset;
+    std::int32_t size;
+  };
+  // The layout is written to disk as-is.
+  static_assert(sizeof(Header) == 40);
+  static_assert(sizeof(Entry) == 20);
+
+  static inline const char kMagic[8] = {'C', 'S', 'I', 'M', 'G', 'I', 'D', 'X'};
+  static inline const std::uint32_t kFormatVersion = 2;
+
+  /** Set when the data is in the cache file */
+  std::optional<MappedFile> mapped_;
+  /** Set when the data was built from the text index */
+  std::vector<char> buffer_;
+  std::string_view data_;
+  std::uint32_t entry_count_ = 0;
+  std::string_view strings_;
+
+  ImageDataIndex() = default;
+
+  /**
+   * Build the binary index from the text index at @p data_index_path.
+   *
+   * @param data_index_path
+   * @param source
+   * @return
+   * @throws except::DefsError When the file cannot be read or is malformed.
+   */
+  static std::vector<char> Build(const std::string &data_index_path, const Source &source);
+
+  /**
+   * Use @p data as the binary index.
+   *
+   * @param data
+   * @param source Expected source
+   * @return FALSE if @p data is not a valid index for @p source.
+   */
+  bool SetData(std::string_view data, const Source &source);
+
+  [[nodiscard]] Entry GetEntry(std::uint32_t index) const;
+  [[nodiscard]] std::string_view GetString(std::uint32_t offset, std::uint16_t size) const {
+    // A damaged cache file must not cause reads past the end.
+    if (offset > strings_.size()) {
+      return {};
+    }
+    return strings_.substr(offset, size);
+  }
+};
+
+} // cslibs
+
+#endif //CS_PROFILE_EDITOR_INCLUDE_CSLIBS_IMAGEDATAINDEX_H_
@@ -0,0 +1,194 @@
+/**
+ * @file ImageLibraryDb.h
+ *
+ * @author dankeenan
+ * @date 5/9/21
+ * @copyright (c) 2021 Dan Keenan
+ */
+
+#ifndef CS_PROFILE_EDITOR_INCLUDE_CSLIBS_IMAGELIBRARYDB_H_
+#define CS_PROFILE_EDITOR_INCLUDE_CSLIBS_IMAGELIBRARYDB_H_
+
+#include "Db.h"
+#include "DefsFile.h"
+#include "ImportPipeline.h"
+#include "except.h"
+#include <SQLiteCpp/Statement.h>
+#include <fmt/format.h>
+
+namespace cslibs {
+
+/**
+ * Image database loaded from an image library (gobos, discs, effects).
+ *
+ * The libraries only differ in where their records are found, which is described by @p Traits:
+ * @code
+ * struct Traits {
+ *   // Table name
+ *   static constexpr const char *kBaseTable = "gobo";
+ *   // Record name in the defs file (e.g. $GOBO)
+ *   static constexpr const char *kRecordName = "GOBO";
+ *   // Prefix for the MANUFACTURER and INFO fields (e.g. $$GOBOINFO)
+ *   static constexpr const char *kFieldPrefix = "GOBO";
+ *   // Type in the image data index
+ *   static constexpr const char *kDataType = "gobo";
+ * };
+ * @endcode
+ *
+ * @tparam Traits
+ */
+template<typename Traits>
+class ImageLibraryDb : public ImageDb {
+ public:
+  using ImageDb::ImageDb;
+
+ protected:
+  [[nodiscard]] const char *GetBaseTable() const final {
+    return Traits::kBaseTable;
+  }
+
+  void LoadFromDefsFile(const ProgressCallback &progress_callback) final {
+    ImageDefsFile defs_file(defs_file_path_, data_index_path_, data_path_, data_index_cache_path_);
+    const ImageStorage image_storage = GetImportImageStorage();
+
+    // Cache stored ids
+    ManufacturerIdCache manufacturer_ids;
+    SeriesIdCache series_ids;
+    // Duplicate dcids keep the first record.
+    SQLite::Statement insert_stmt(*db_, fmt::format(R"EOF(
+      INSERT OR IGNORE INTO {base_table}(dcid, series_id, code, name, image, image_offset, image_size)
+      VALUES (:dcid, :series_id, :code, :name, :image, :image_offset, :image_size);
+    )EOF", fmt::arg("base_table", GetBaseTable())));
+    SQLite::Statement thumbnail_insert_stmt(*db_, fmt::format(R"EOF(
+      INSERT INTO {base_table}_thumbnail(image_id, size, thumbnail)
+      VALUES (:image_id, :size, :thumbnail);
+    )EOF", fmt::arg("base_table", GetBaseTable())));
+
+    ImportPipeline<Row> pipeline(
+        Traits::kRecordName,
+        [&defs_file, this](const DefsFile::DefView &record) {
+          auto row = Parse(record, defs_file);
+          // Rendering is slow, so do it here on the worker threads.
+          if (row.has_value() && thumbnail_renderer_) {
+            for (const auto size : kThumbnailSizes) {
+              auto thumbnail = thumbnail_renderer_(row->image, size);
+              if (thumbnail.has_value()) {
+                row->thumbnails.emplace_back(size, std::move(*thumbnail));
+              }
+            }
+          }
+          return row;
+        },
+        [&](const Row &row) {
+          // Get foreign keys
+          const unsigned int manufacturer_id = GetManufacturerIdForName(row.manufacturer_name, manufacturer_ids);
+          const unsigned int series_id = GetSeriesIdForName(row.series_name, manufacturer_id, series_ids);
+
+          // Add image
+          try {
+            insert_stmt.reset();
+            insert_stmt.bind(":dcid", row.dcid);
+            insert_stmt.bind(":series_id", series_id);
+            insert_stmt.bind(":code", row.code);
+            insert_stmt.bind(":name", row.name);
+            if (image_storage == ImageStorage::kReference) {
+              insert_stmt.bind(":image");
+              insert_stmt.bind(":image_offset", static_cast<int64_t>(defs_file.GetDataOffset(row.image)));
+              insert_stmt.bind(":image_size", static_cast<int64_t>(row.image.size()));
+            } else {
+              // The image is in the mapped data file, which outlives the statement.
+              insert_stmt.bindNoCopy(":image", row.image.data(), static_cast<int>(row.image.size()));
+              insert_stmt.bind(":image_offset");
+              insert_stmt.bind(":image_size");
+            }
+            if (insert_stmt.exec() == 0) {
+              // Duplicate
+              return;
+            }
+            const auto image_id = db_->getLastInsertRowid();
+            for (const auto &[size, thumbnail] : row.thumbnails) {
+              thumbnail_insert_stmt.reset();
+              thumbnail_insert_stmt.bind(":image_id", image_id);
+              thumbnail_insert_stmt.bind(":size", size);
+              thumbnail_insert_stmt.bindNoCopy(":thumbnail", thumbnail.data(), static_cast<int>(thumbnail.size()));
+              thumbnail_insert_stmt.exec();
+            }
+          } catch (const SQLite::Exception &e) {
+            throw except::DbError(fmt::format("{} Error adding {}: {}", row.dcid, Traits::kBaseTable, e.what()));
+          }
+        });
+    pipeline.Run(defs_file, progress_callback);
+
+    SaveImageSource(image_storage);
+    SetUserVersion(defs_file.GetVersion());
+  }
+
+ private:
+  /**
+   * Record, ready to insert
+   */
+  struct Row {
+    std::string dcid;
+    std::string manufacturer_name;
+    std::string series_name;
+    std::string code;
+    std::string name;
+    /** View into the data file */
+    std::string_view image;
+    /** Size => thumbnail */
+    std::vector<std::pair<unsigned int, std::vector<char>>> thumbnails;
+  };
+
+  static inline const std::string kManufacturerField = fmt::format("{}MANUFACTURER", Traits::kFieldPrefix);
+  static inline const std::string kInfoField = fmt::format("{}INFO", Traits::kFieldPrefix);
+
+  /**
+   * Parse a record.
+   *
+   * @param record
+   * @param defs_file
+   * @return The row, or none if the record should not be added.
+   * @throws except::DefsError When the record is malformed.
+   */
+  static std::optional<Row> Parse(const DefsFile::DefView &record, const ImageDefsFile &defs_file) {
+    const auto dcid = record.Get("IMAGE");
+    if (!dcid.has_value()) {
+      // Records without images are not helpful.
+      return {};
+    }
+    const auto image_data = defs_file.GetDataForDcid(Traits::kDataType, *dcid);
+    if (!image_data.has_value()) {
+      // Records without images are not helpful.
+      return {};
+    }
+    const auto manufacturer_info = record.Get(kManufacturerField);
+    if (!manufacturer_info.has_value()) {
+      throw except::DefsError(fmt::format("{} Missing {}", *dcid, kManufacturerField));
+    }
+    const auto series_info = DefsFile::SplitValue(*manufacturer_info);
+    if (series_info.size() != 2) {
+      throw except::DefsError(fmt::format("{} {} is malformed: \"{}\"", *dcid, kManufacturerField, *manufacturer_info));
+    }
+    const auto info = record.Get(kInfoField);
+    if (!info.has_value()) {
+      throw except::DefsError(fmt::format("{} Missing {}", *dcid, kInfoField));
+    }
+    const auto image_info = DefsFile::SplitValue(*info);
+    if (image_info.size() < 2) {
+      throw except::DefsError(fmt::format("{} {} is malformed: \"{}\"", *dcid, kInfoField, *info));
+    }
+
+    Row row;
+    row.dcid = *dcid;
+    row.manufacturer_name = series_info.at(0);
+    row.series_name = series_info.at(1);
+    row.code = image_info.at(0);
+    row.name = fmt::format("{}", fmt::join(image_info.cbegin() + 1, image_info.cend(), ","));
+    row.image = *image_data;
+    return row;
+  }
+};
+
+} // cslibs
+
+#endif //CS_PROFILE_EDITOR_INCLUDE_CSLIBS_IMAGELIBRARYDB_H_
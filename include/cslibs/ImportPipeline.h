@@ -0,0 +1,149 @@
+/**
+ * @file ImportPipeline.h
+ *
+ * @author dankeenan
+ * @date 5/9/21
+ * @copyright (c) 2021 Dan Keenan
+ */
+
+#ifndef CS_PROFILE_EDITOR_INCLUDE_CSLIBS_IMPORTPIPELINE_H_
+#define CS_PROFILE_EDITOR_INCLUDE_CSLIBS_IMPORTPIPELINE_H_
+
+#include <deque>
+#include <functional>
+#include <future>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Db.h"
+#include "DefsFile.h"
+#include "WorkerPool.h"
+
+namespace cslibs {
+
+/**
+ * Import records from a defs file, parsing them in parallel and inserting them in file order.
+ *
+ * The calling thread reads records and hands them to a worker pool in batches.  Parsed batches wait in a bounded
+ * queue and are inserted on the calling thread (the only one that touches the database) in the order they were read.
+ *
+ * @tparam Row Parsed record, ready to insert.
+ */
+template<typename Row>
+class ImportPipeline {
+ public:
+  /**
+   * Parse a record.  Runs on a worker thread.
+   *
+   * Return none to skip the record.  Exceptions are rethrown from Run().
+   */
+  using ParseFunction = std::function<std::optional<Row>(const DefsFile::DefView &record)>;
+  /**
+   * Insert a parsed record.  Runs on the thread that called Run().
+   */
+  using InsertFunction = std::function<void(Row &row)>;
+
+  /**
+   * @param record_name Only records with this name are imported.
+   * @param parse
+   * @param insert
+   * @param thread_count Worker threads; 0 == one per hardware thread
+   */
+  explicit ImportPipeline(std::string record_name,
+                          ParseFunction parse,
+                          InsertFunction insert,
+                          unsigned int thread_count = 0) :
+      record_name_(std::move(record_name)),
+      parse_(std::move(parse)),
+      insert_(std::move(insert)),
+      thread_count_(thread_count) {}
+
+  /**
+   * Import all matching records from @p defs_file.
+   *
+   * @param defs_file
+   * @param progress_callback Called after each inserted record.
+   * @throws except::DefsError From the parse function.
+   * @throws except::DbError From the insert function.
+   */
+  void Run(DefsFile &defs_file, const Db::ProgressCallback &progress_callback) {
+    WorkerPool pool(thread_count_);
+    // Enough to keep every worker busy while the writer catches up.
+    const std::size_t max_in_flight = pool.GetThreadCount() * 2;
+    std::deque<std::future<ParsedBatch>> in_flight;
+    const unsigned long total = defs_file.GetSize();
+
+    const auto insert_next = [this, &in_flight, &progress_callback, total]() {
+      auto future = std::move(in_flight.front());
+      in_flight.pop_front();
+      ParsedBatch parsed = future.get();
+      for (auto &[row, position] : parsed) {
+        insert_(row);
+        if (progress_callback) {
+          progress_callback(position, total);
+        }
+      }
+    };
+    const auto submit = [this, &pool, &in_flight, max_in_flight, &insert_next](Batch &&batch) {
+      if (in_flight.size() >= max_in_flight) {
+        insert_next();
+      }
+      in_flight.push_back(pool.Submit([this, batch = std::move(batch)]() { return Parse(batch); }));
+    };
+
+    try {
+      Batch batch;
+      while (auto record = defs_file.GetNextRecordView()) {
+        if (record->record_name != record_name_) {
+          continue;
+        }
+        // Record views point into the mapped file, so they are safe to use from the workers.
+        batch.emplace_back(std::move(*record), defs_file.GetPosition());
+        if (batch.size() >= kBatchSize) {
+          submit(std::move(batch));
+          batch = {};
+        }
+      }
+      if (!batch.empty()) {
+        submit(std::move(batch));
+      }
+      while (!in_flight.empty()) {
+        insert_next();
+      }
+    } catch (...) {
+      // The workers refer to the defs file; let them finish before it goes away.
+      for (const auto &future : in_flight) {
+        future.wait();
+      }
+      throw;
+    }
+  }
+
+ private:
+  /** Records and the file position after each one */
+  using Batch = std::vector<std::pair<DefsFile::DefView, unsigned long>>;
+  using ParsedBatch = std::vector<std::pair<Row, unsigned long>>;
+  static inline const std::size_t kBatchSize = 64;
+
+  std::string record_name_;
+  ParseFunction parse_;
+  InsertFunction insert_;
+  unsigned int thread_count_;
+
+  ParsedBatch Parse(const Batch &batch) const {
+    ParsedBatch parsed;
+    parsed.reserve(batch.size());
+    for (const auto &[record, position] : batch) {
+      auto row = parse_(record);
+      if (row.has_value()) {
+        parsed.emplace_back(std::move(*row), position);
+      }
+    }
+    return parsed;
+  }
+};
+
+} // cslibs
+
+#endif //CS_PROFILE_EDITOR_INCLUDE_CSLIBS_IMPORTPIPELINE_H_
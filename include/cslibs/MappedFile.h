@@ -0,0 +1,54 @@
+/**
+ * @file MappedFile.h
+ *
+ * @author dankeenan
+ * @date 5/8/21
+ * @copyright (c) 2021 Dan Keenan
+ */
+
+#ifndef CS_PROFILE_EDITOR_INCLUDE_CSLIBS_MAPPEDFILE_H_
+#define CS_PROFILE_EDITOR_INCLUDE_CSLIBS_MAPPEDFILE_H_
+
+#include <string>
+#include <string_view>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+namespace cslibs {
+
+/**
+ * Read-only file mapped into memory
+ */
+class MappedFile {
+ public:
+  /**
+   * Map the file at @p file_path.
+   *
+   * @param file_path
+   * @param sequential Hint that the file will be read front to back.
+   * @throws except::DefsError When the file cannot be mapped.
+   */
+  explicit MappedFile(const std::string &file_path, bool sequential = false);
+
+  /**
+   * Get the file contents.
+   *
+   * The data is valid for the lifetime of this object.
+   * @return
+   */
+  [[nodiscard]] std::string_view GetData() const {
+    return {static_cast<const char *>(region_.get_address()), region_.get_size()};
+  }
+
+  [[nodiscard]] std::size_t GetSize() const {
+    return region_.get_size();
+  }
+
+ private:
+  boost::interprocess::file_mapping file_mapping_;
+  boost::interprocess::mapped_region region_;
+};
+
+} // cslibs
+
+#endif //CS_PROFILE_EDITOR_INCLUDE_CSLIBS_MAPPEDFILE_H_
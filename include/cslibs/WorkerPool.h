@@ -0,0 +1,79 @@
+/**
+ * @file WorkerPool.h
+ *
+ * @author dankeenan
+ * @date 5/9/21
+ * @copyright (c) 2021 Dan Keenan
+ */
+
+#ifndef CS_PROFILE_EDITOR_INCLUDE_CSLIBS_WORKERPOOL_H_
+#define CS_PROFILE_EDITOR_INCLUDE_CSLIBS_WORKERPOOL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace cslibs {
+
+/**
+ * Fixed set of threads that run submitted tasks in submission order.
+ */
+class WorkerPool {
+ public:
+  /**
+   * Start @p thread_count threads.
+   *
+   * @param thread_count 0 == one per hardware thread
+   */
+  explicit WorkerPool(unsigned int thread_count = 0);
+
+  /**
+   * Finishes all queued tasks, then stops the threads.
+   */
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool &) = delete;
+  WorkerPool &operator=(const WorkerPool &) = delete;
+
+  /**
+   * Queue @p task to run on a worker thread.
+   *
+   * @param task
+   * @return Future holding the task's result or exception.
+   */
+  template<typename Task>
+  std::future<std::invoke_result_t<Task>> Submit(Task &&task) {
+    // std::function needs to be copyable, so the task is shared.
+    auto packaged_task = std::make_shared<std::packaged_task<std::invoke_result_t<Task>()>>(std::forward<Task>(task));
+    auto future = packaged_task->get_future();
+    {
+      std::lock_guard lock(mutex_);
+      tasks_.emplace_back([packaged_task]() { (*packaged_task)(); });
+    }
+    task_available_.notify_one();
+    return future;
+  }
+
+  [[nodiscard]] unsigned int GetThreadCount() const {
+    return threads_.size();
+  }
+
+ private:
+  std::vector<std::thread> threads_;
+  std::deque<std::function<void()>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable task_available_;
+  bool stopping_ = false;
+
+  void Work();
+};
+
+} // cslibs
+
+#endif //CS_PROFILE_EDITOR_INCLUDE_CSLIBS_WORKERPOOL_H_
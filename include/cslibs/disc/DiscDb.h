@@ -9,25 +9,36 @@
 #ifndef CS_PROFILE_EDITOR_INCLUDE_CSLIBS_DISC_DISCDB_H_
 #define CS_PROFILE_EDITOR_INCLUDE_CSLIBS_DISC_DISCDB_H_
 
-#include "../Db.h"
+#include "../ImageLibraryDb.h"
 #include <SQLiteCpp/Column.h>
 #include <cslibs/Entity.h>
 
 namespace cslibs::disc {
 
 /**
- * Disc database
+ * Where discs are found in the defs files
  */
-class DiscDb final : public ImageDb {
- public:
-  using ImageDb::ImageDb;
+struct DiscTraits {
+  static constexpr const char *kBaseTable = "disc";
+  static constexpr const char *kRecordName = "FXDISC";
+  static constexpr const char *kFieldPrefix = "FXDISC";
+  static constexpr const char *kDataType = "animation";
+};
 
- protected:
-  [[nodiscard]] const char *GetBaseTable() const final {
-    return "disc";
-  }
+} // cslibs::disc
+
+namespace cslibs {
+extern template class ImageLibraryDb<disc::DiscTraits>;
+} // cslibs
 
-  void LoadFromDefsFile(const ProgressCallback &progress_callback) final;
+namespace cslibs::disc {
+
+/**
+ * Disc database
+ */
+class DiscDb final : public ImageLibraryDb<DiscTraits> {
+ public:
+  using ImageLibraryDb::ImageLibraryDb;
 };
 
 } // cslibs::disc
@@ -9,27 +9,38 @@
 #ifndef CS_PROFILE_EDITOR_INCLUDE_CSLIBS_EFFECT_EFFECTDB_H_
 #define CS_PROFILE_EDITOR_INCLUDE_CSLIBS_EFFECT_EFFECTDB_H_
 
-#include "../Db.h"
+#include "../ImageLibraryDb.h"
 #include <SQLiteCpp/Column.h>
 #include <cslibs/Entity.h>
 
 namespace cslibs::effect {
 
 /**
- * Effect database
+ * Where effects are found in the defs files
  */
-class EffectDb final : public ImageDb {
- public:
-  using ImageDb::ImageDb;
+struct EffectTraits {
+  static constexpr const char *kBaseTable = "effect";
+  static constexpr const char *kRecordName = "FXGLASS";
+  static constexpr const char *kFieldPrefix = "FXGLASS";
+  static constexpr const char *kDataType = "effect";
+};
+
+} // cslibs::effect
+
+namespace cslibs {
+extern template class ImageLibraryDb<effect::EffectTraits>;
+} // cslibs
 
- protected:
-  [[nodiscard]] const char *GetBaseTable() const override {
-    return "effect";
-  }
+namespace cslibs::effect {
 
-  void LoadFromDefsFile(const ProgressCallback &progress_callback) final;
+/**
+ * Effect database
+ */
+class EffectDb final : public ImageLibraryDb<EffectTraits> {
+ public:
+  using ImageLibraryDb::ImageLibraryDb;
 };
 
-}
+} // cslibs::effect
 
 #endif //CS_PROFILE_EDITOR_INCLUDE_CSLIBS_EFFECT_EFFECTDB_H_
@@ -29,6 +29,14 @@ class ReadOnlyDbError : public DbError {
   explicit ReadOnlyDbError() : DbError("Cannot perform a write operation on a read-only database") {}
 };
 
+/**
+ * Thrown by queries that were cancelled before they finished.
+ */
+class QueryCancelled : public DbError {
+ public:
+  explicit QueryCancelled() : DbError("Query was cancelled") {}
+};
+
 /**
  * Thrown on errors reading defs files.
  */
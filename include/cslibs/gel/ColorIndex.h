@@ -0,0 +1,96 @@
+/**
+ * @file ColorIndex.h
+ *
+ * @author dankeenan
+ * @date 5/16/21
+ * @copyright (c) 2021 Dan Keenan
+ */
+
+#ifndef CS_PROFILE_EDITOR_INCLUDE_CSLIBS_GEL_COLORINDEX_H_
+#define CS_PROFILE_EDITOR_INCLUDE_CSLIBS_GEL_COLORINDEX_H_
+
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace cslibs::gel {
+
+/**
+ * k-d tree for finding the colors nearest to a given color.
+ *
+ * Distance is Euclidean, so build the index in the color space the distance should be measured in (e.g. CIELAB for
+ * CIE76 ΔE).
+ */
+class ColorIndex {
+ public:
+  using Point = std::array<float, 3>;
+
+  /**
+   * A point found by FindNearest()
+   */
+  struct Match {
+    /** Index into the points passed to the constructor */
+    std::size_t index;
+    float distance;
+  };
+
+  /**
+   * @param points
+   */
+  explicit ColorIndex(const std::vector<Point> &points);
+
+  /**
+   * Find the @p count points nearest to @p point.
+   *
+   * @param point
+   * @param count
+   * @return Nearest first.
+   */
+  [[nodiscard]] std::vector<Match> FindNearest(const Point &point, std::size_t count) const;
+
+  /**
+   * Make a point in RGB space.
+   *
+   * @param red
+   * @param green
+   * @param blue
+   * @return
+   */
+  [[nodiscard]] static Point RgbToPoint(std::uint8_t red, std::uint8_t green, std::uint8_t blue) {
+    return {static_cast<float>(red), static_cast<float>(green), static_cast<float>(blue)};
+  }
+
+  /**
+   * Convert an sRGB color to CIELAB (D65 white point).
+   *
+   * @param red
+   * @param green
+   * @param blue
+   * @return
+   */
+  [[nodiscard]] static Point RgbToLab(std::uint8_t red, std::uint8_t green, std::uint8_t blue);
+
+ private:
+  struct Node {
+    Point point;
+    std::size_t index;
+  };
+  /**
+   * Implicit tree: the root of a range is its middle element, split on axis (depth % 3).  Left children are in the
+   * lower half of the range, right children in the upper half.
+   */
+  std::vector<Node> nodes_;
+
+  void Build(std::size_t begin, std::size_t end, unsigned int depth);
+  void Search(std::size_t begin,
+              std::size_t end,
+              unsigned int depth,
+              const Point &point,
+              std::size_t count,
+              std::vector<std::pair<float, std::size_t>> &heap) const;
+};
+
+} // cslibs::gel
+
+#endif //CS_PROFILE_EDITOR_INCLUDE_CSLIBS_GEL_COLORINDEX_H_
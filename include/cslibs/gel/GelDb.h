@@ -10,6 +10,7 @@
 #define CS_PROFILE_EDITOR_INCLUDE_CSLIBS_GEL_GELDB_H_
 
 #include "../Db.h"
+#include "ColorIndex.h"
 #include "Gel.h"
 #include <SQLiteCpp/Column.h>
 
@@ -27,10 +28,65 @@ class GelDb final : public Db {
 
   [[nodiscard]] std::vector<Gel> GetGelForSeries(const Series &series, Sort sort_by = Sort::kCode);
 
+  /**
+   * How FindNearest() measures the difference between colors
+   */
+  enum class Metric {
+    /** Euclidean distance between RGB values; fast to explain, but not perceptually uniform */
+    kRgb,
+    /** CIE76 ΔE (Euclidean distance in CIELAB) */
+    kDeltaE,
+  };
+
+  /**
+   * A gel found by FindNearest()
+   */
+  struct Match {
+    Gel gel;
+    /** In units of @p metric */
+    float distance;
+  };
+
+  /**
+   * Find the gels closest in color to @p rgb across all manufacturers.
+   *
+   * The first call loads every gel into memory; later calls don't query the database.
+   *
+   * @param rgb 0xRRGGBB; any alpha is ignored.
+   * @param count Maximum number of gels to return
+   * @param metric
+   * @return Nearest first.
+   */
+  [[nodiscard]] std::vector<Match> FindNearest(std::uint32_t rgb, std::size_t count, Metric metric = Metric::kDeltaE);
+
+  /**
+   * Get the gel in the row with the given @p id (e.g. from Search()).
+   * @param id
+   * @return
+   */
+  [[nodiscard]] std::optional<Gel> GetGelForId(std::int64_t id);
+
  protected:
+  [[nodiscard]] const char *GetBaseTable() const final {
+    return "gel";
+  }
   void CreateTables() final;
   void LoadFromDefsFile(const ProgressCallback &progress_callback) final;
   void ClearRecords() final;
+  [[nodiscard]] std::vector<Migration> GetMigrations() final;
+
+ private:
+  void CreateSortIndexes();
+
+  /** Every gel, in the same order as the points in the color indexes; empty until FindNearest() loads it. */
+  std::vector<Gel> all_gels_;
+  std::optional<ColorIndex> rgb_index_;
+  std::optional<ColorIndex> lab_index_;
+  /** PRAGMA data_version when the color indexes were loaded; changes when another connection commits. */
+  std::int64_t color_index_data_version_ = 0;
+
+  void LoadColorIndexes();
+  [[nodiscard]] static Gel ReadGel(const SQLite::Statement &q);
 };
 
 } // cslibs::gel
@@ -9,27 +9,38 @@
 #ifndef CS_PROFILE_EDITOR_INCLUDE_CSLIBS_GOBO_GOBODB_H_
 #define CS_PROFILE_EDITOR_INCLUDE_CSLIBS_GOBO_GOBODB_H_
 
-#include "../Db.h"
+#include "../ImageLibraryDb.h"
 #include <SQLiteCpp/Column.h>
 #include <cslibs/Entity.h>
 
 namespace cslibs::gobo {
 
 /**
- * Gobo database
+ * Where gobos are found in the defs files
  */
-class GoboDb final : public ImageDb {
- public:
-  using ImageDb::ImageDb;
+struct GoboTraits {
+  static constexpr const char *kBaseTable = "gobo";
+  static constexpr const char *kRecordName = "GOBO";
+  static constexpr const char *kFieldPrefix = "GOBO";
+  static constexpr const char *kDataType = "gobo";
+};
+
+} // cslibs::gobo
+
+namespace cslibs {
+extern template class ImageLibraryDb<gobo::GoboTraits>;
+} // cslibs
 
- protected:
-  [[nodiscard]] const char *GetBaseTable() const override {
-    return "gobo";
-  }
+namespace cslibs::gobo {
 
-  void LoadFromDefsFile(const ProgressCallback &progress_callback) final;
+/**
+ * Gobo database
+ */
+class GoboDb final : public ImageLibraryDb<GoboTraits> {
+ public:
+  using ImageLibraryDb::ImageLibraryDb;
 };
 
-} // cslibs::gel
+} // cslibs::gobo
 
 #endif //CS_PROFILE_EDITOR_INCLUDE_CSLIBS_GOBO_GOBODB_H_
@@ -0,0 +1,90 @@
+/**
+ * @file Journal.h
+ *
+ * @author dankeenan
+ * @date 5/16/21
+ * @copyright (c) 2021 Dan Keenan
+ */
+
+#ifndef CS_PROFILE_EDITOR_INCLUDE_CSPROFILE_JOURNAL_H_
+#define CS_PROFILE_EDITOR_INCLUDE_CSPROFILE_JOURNAL_H_
+
+#include <cstdio>
+#include <string>
+#include <nlohmann/json.hpp>
+#include "Library.h"
+#include "Personality.h"
+
+namespace csprofile {
+
+/**
+ * Append-only log of changes made to a library's personalities.
+ *
+ * Replaying the journal onto the library it was started from repeats the changes, so only the changed personalities
+ * need to be written between full saves.  Each change is one line of JSON.
+ */
+class Journal final {
+ public:
+  /**
+   * Open a journal for appending, creating it if needed.
+   *
+   * @param file_path
+   * @throws std::runtime_error when the file cannot be opened.
+   */
+  explicit Journal(const std::string &file_path);
+  ~Journal();
+
+  Journal(const Journal &) = delete;
+  Journal &operator=(const Journal &) = delete;
+
+  /**
+   * The personality at @p row was replaced by @p personality.
+   *
+   * @throws std::runtime_error when the journal cannot be written.
+   */
+  void RecordUpdate(unsigned int row, const Personality &personality);
+
+  /**
+   * @p personality was inserted before @p row.
+   *
+   * @throws std::runtime_error when the journal cannot be written.
+   */
+  void RecordInsert(unsigned int row, const Personality &personality);
+
+  /**
+   * @p count personalities were removed, starting at @p row.
+   *
+   * @throws std::runtime_error when the journal cannot be written.
+   */
+  void RecordRemove(unsigned int row, unsigned int count);
+
+  /**
+   * Get the number of bytes in the journal.
+   */
+  [[nodiscard]] long GetSize() const {
+    return size_;
+  }
+
+  /**
+   * Apply the changes in a journal to @p library.
+   *
+   * A partially-written last change, e.g. from a crash, is ignored.
+   *
+   * @param file_path
+   * @param library
+   * @return The number of changes applied.
+   * @throws std::runtime_error when the file cannot be read.
+   * @throws except::ParseError when a change is not valid or doesn't fit @p library.
+   */
+  static unsigned int Replay(const std::string &file_path, Library &library);
+
+ private:
+  std::FILE *file_;
+  long size_;
+
+  void Append(const nlohmann::json &change);
+};
+
+} // csprofile
+
+#endif //CS_PROFILE_EDITOR_INCLUDE_CSPROFILE_JOURNAL_H_
@@ -9,6 +9,7 @@
 #ifndef CS_PROFILE_EDITOR_INCLUDE_CSPROFILE_LIBRARY_H_
 #define CS_PROFILE_EDITOR_INCLUDE_CSPROFILE_LIBRARY_H_
 
+#include <functional>
 #include <vector>
 #include <stdexcept>
 #include "boost/date_time/posix_time/posix_time.hpp"
@@ -16,6 +17,8 @@
 
 namespace csprofile {
 
+class LibraryWriter;
+
 /**
  * A collection of personalities
  */
@@ -24,6 +27,25 @@ class Library final {
   friend std::ostream &operator<<(std::ostream &out, const Library &library);
 
  public:
+  /**
+   * Layout of saved files
+   */
+  enum class Format {
+    /** Indented, like the official editor */
+    kPretty,
+    /** No whitespace, for smaller files */
+    kCompact,
+  };
+
+  /**
+   * Called after each personality is read with:
+   * - bytes read so far
+   * - total bytes
+   *
+   * Return FALSE to stop loading.
+   */
+  using ProgressCallback = std::function<bool(unsigned long, unsigned long)>;
+
   /**
    * Create a new library
    */
@@ -32,17 +54,33 @@ class Library final {
   /**
    * Load a library file.
    *
+   * @param file_path
+   * @param progress_callback
    * @throws std::runtime_error when the file cannot be read.
    * @throws except::ParseError when the library file is not valid.
+   * @throws except::LoadCancelled when @p progress_callback stops loading.
    */
-  explicit Library(const std::string &file_path);
+  explicit Library(const std::string &file_path, const ProgressCallback &progress_callback = {});
 
   /**
    * Save a library path.
    *
+   * The file is written in full to a temporary file beside it, then moved into place, so the existing file is left
+   * alone if anything goes wrong.
+   *
+   * @param file_path
+   * @param format
    * @throws std::runtime_error when the file cannot be written.
    */
-  void Save(const std::string &file_path) const;
+  void Save(const std::string &file_path, Format format = Format::kPretty) const;
+
+  /**
+   * Write the library file to @p out.
+   *
+   * @param out
+   * @param format
+   */
+  void Write(std::ostream &out, Format format = Format::kPretty) const;
 
   /**
    * @internal
@@ -63,6 +101,8 @@ class Library final {
 
  private:
   std::optional<boost::posix_time::ptime> updated_;
+
+  void Write(LibraryWriter &writer) const;
 };
 
 } // csprofile
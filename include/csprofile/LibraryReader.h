@@ -0,0 +1,153 @@
+/**
+ * @file LibraryReader.h
+ *
+ * @author dankeenan
+ * @date 5/16/21
+ * @copyright (c) 2021 Dan Keenan
+ */
+
+#ifndef CS_PROFILE_EDITOR_INCLUDE_CSPROFILE_LIBRARYREADER_H_
+#define CS_PROFILE_EDITOR_INCLUDE_CSPROFILE_LIBRARYREADER_H_
+
+#include <istream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <variant>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "Library.h"
+#include "Personality.h"
+#include "parameter/Parameter.h"
+#include "parameter/Range.h"
+#include "parameter/Media.h"
+
+namespace csprofile {
+
+/**
+ * Builds personalities from a library file as it is parsed.
+ *
+ * Unlike parsing into a json document first, only the object currently being read is held in memory apart from the
+ * personalities themselves.  Accepts and rejects the same files as the from_json() functions, with one exception:
+ * lists written as json objects are rejected instead of reading the object's values.
+ */
+class LibraryReader final : public nlohmann::json_sax<nlohmann::json> {
+ public:
+  /**
+   * Read all personalities from @p in.
+   *
+   * @param in
+   * @param progress_callback Passed the position in @p in after each personality.
+   * @param total Size of @p in, passed to @p progress_callback.
+   * @return
+   * @throws except::ParseError when the library file is not valid.
+   * @throws except::LoadCancelled when @p progress_callback stops loading.
+   */
+  [[nodiscard]] static std::vector<Personality> Read(std::istream &in,
+                                                     const Library::ProgressCallback &progress_callback = {},
+                                                     unsigned long total = 0);
+
+  bool null() override;
+  bool boolean(bool val) override;
+  bool number_integer(number_integer_t val) override;
+  bool number_unsigned(number_unsigned_t val) override;
+  bool number_float(number_float_t val, const string_t &s) override;
+  bool string(string_t &val) override;
+  bool binary(binary_t &val) override;
+  bool start_object(std::size_t elements) override;
+  bool key(string_t &val) override;
+  bool end_object() override;
+  bool start_array(std::size_t elements) override;
+  bool end_array() override;
+  bool parse_error(std::size_t position, const std::string &last_token, const nlohmann::detail::exception &ex) override;
+
+ private:
+  /** What the value being read belongs to */
+  enum class Context {
+    kRoot,
+    kLibrary,
+    kPersonalities,
+    kPersonality,
+    kParameters,
+    kParameter,
+    kRanges,
+    kRange,
+    kMedia,
+    /** Inside a value nobody uses */
+    kSkip,
+  };
+
+  using Scalar = std::variant<std::nullptr_t, bool, number_integer_t, number_unsigned_t, number_float_t, string_t>;
+
+  /** Parameter fields that can't be applied until the type and size are known. */
+  struct ParameterFields {
+    std::optional<int> type;
+    std::optional<unsigned int> coarse;
+    std::optional<Scalar> fine;
+    std::optional<Scalar> size;
+    std::optional<unsigned int> home;
+    std::optional<bool> fade_with_intensity;
+    std::optional<bool> invert;
+    std::optional<bool> snap;
+    std::optional<std::string> name;
+    std::vector<parameter::Range> ranges;
+  };
+
+  struct RangeFields {
+    std::optional<unsigned int> begin;
+    std::optional<unsigned int> default_value;
+    std::optional<unsigned int> end;
+    std::optional<std::string> label;
+    std::optional<parameter::Media> media;
+  };
+
+  struct MediaFields {
+    std::optional<Scalar> r;
+    std::optional<Scalar> g;
+    std::optional<Scalar> b;
+    std::optional<std::string> dcid;
+    std::optional<std::string> name;
+  };
+
+  struct PersonalityFields {
+    Personality personality;
+    bool has_manufacturer_name = false;
+    bool has_mode_name = false;
+    bool has_model_name = false;
+    bool has_parameters = false;
+    std::vector<std::unique_ptr<parameter::Parameter>> parameters;
+  };
+
+  std::istream *in_ = nullptr;
+  const Library::ProgressCallback *progress_callback_ = nullptr;
+  unsigned long total_ = 0;
+  std::vector<Context> contexts_{Context::kRoot};
+  /** Key of the value being read; empty in arrays */
+  std::string key_;
+  /** Nesting depth inside skipped values */
+  unsigned int skip_depth_ = 0;
+  bool has_personalities_ = false;
+  std::vector<Personality> personalities_;
+  std::optional<PersonalityFields> personality_;
+  std::optional<ParameterFields> parameter_;
+  std::optional<RangeFields> range_;
+  std::optional<MediaFields> media_;
+
+  bool Value(Scalar &&value);
+  bool StartContainer(bool is_object);
+  bool EndContainer();
+  void EndPersonality();
+  void ReportProgress();
+  void EndParameter();
+  void EndRange();
+  void EndMedia();
+
+  [[noreturn]] static void PersonalityError(const std::string &what);
+  [[noreturn]] static void ParameterError(const std::string &what);
+  [[noreturn]] static void RangeError(const std::string &what);
+  [[noreturn]] static void MediaError(const std::string &what);
+};
+
+} // csprofile
+
+#endif //CS_PROFILE_EDITOR_INCLUDE_CSPROFILE_LIBRARYREADER_H_
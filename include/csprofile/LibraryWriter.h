@@ -0,0 +1,95 @@
+/**
+ * @file LibraryWriter.h
+ *
+ * @author dankeenan
+ * @date 5/16/21
+ * @copyright (c) 2021 Dan Keenan
+ */
+
+#ifndef CS_PROFILE_EDITOR_INCLUDE_CSPROFILE_LIBRARYWRITER_H_
+#define CS_PROFILE_EDITOR_INCLUDE_CSPROFILE_LIBRARYWRITER_H_
+
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Library.h"
+#include "Personality.h"
+
+namespace csprofile {
+
+/**
+ * Writes a library file without building a json document first.
+ *
+ * Output is byte-for-byte the same as dumping the to_json() representation, with 4-space indents when pretty.
+ */
+class LibraryWriter final {
+ public:
+  /**
+   * @param out Written to in large chunks; call Flush() when done.
+   * @param format
+   */
+  explicit LibraryWriter(std::ostream &out, Library::Format format);
+
+  /**
+   * Keep everything in memory; get it with TakeBuffer().
+   *
+   * @param format
+   */
+  explicit LibraryWriter(Library::Format format);
+
+  /**
+   * Write a complete library file.
+   *
+   * @param date
+   * @param editor_version
+   * @param personalities
+   * @throws nlohmann::json::type_error when a string is not valid UTF-8.
+   */
+  void Write(const std::string &date, const std::string &editor_version, const std::vector<Personality> &personalities);
+
+  /**
+   * Write everything buffered so far to the stream.
+   */
+  void Flush();
+
+  /**
+   * Take everything written so far, when there is no stream.
+   *
+   * @return
+   */
+  [[nodiscard]] std::string TakeBuffer() {
+    return std::move(buffer_);
+  }
+
+ private:
+  /** Buffered bytes are written out once there are this many. */
+  static const std::size_t kFlushSize = 64 * 1024;
+
+  /** Where to flush to; nullptr when writing to memory */
+  std::ostream *out_;
+  const bool pretty_;
+  std::string buffer_;
+  /** For each open object/array, whether anything has been written in it yet */
+  std::vector<bool> has_members_;
+
+  void WritePersonality(const Personality &personality);
+  void WriteParameter(const parameter::Parameter &parameter);
+  void WriteRange(const parameter::Range &range);
+  void WriteMedia(const parameter::Media &media);
+
+  void StartObject();
+  void StartArray();
+  void End(char close);
+  void Key(std::string_view key);
+  void Element();
+  void Value(std::string_view value);
+  void Value(bool value);
+  void Value(unsigned int value);
+  void Value(int value);
+  void NewLine();
+};
+
+} // csprofile
+
+#endif //CS_PROFILE_EDITOR_INCLUDE_CSPROFILE_LIBRARYWRITER_H_
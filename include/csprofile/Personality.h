@@ -42,6 +42,8 @@ class Personality final {
   explicit Personality(const std::string &dcid);
   Personality(const Personality &other);
   Personality &operator=(const Personality &other);
+  Personality(Personality &&other) = default;
+  Personality &operator=(Personality &&other) = default;
 
   [[nodiscard]] InvalidReason IsInvalid() const;
 
@@ -19,6 +19,14 @@ class ParseError : public std::runtime_error {
   using std::runtime_error::runtime_error;
 };
 
+/**
+ * Thrown when loading a library is stopped before it finishes
+ */
+class LoadCancelled : public std::runtime_error {
+ public:
+  using std::runtime_error::runtime_error;
+};
+
 } // csprofile::except
 
 #endif //CS_PROFILE_EDITOR_INCLUDE_CSPROFILE_EXCEPT_H_
@@ -0,0 +1,64 @@
+/**
+ * @file AsyncDb.cpp
+ *
+ * @author dankeenan
+ * @date 5/16/21
+ * @copyright (c) 2021 Dan Keenan
+ */
+
+#include "cslibs/AsyncDb.h"
+#include <atomic>
+#include <map>
+#include <mutex>
+
+namespace cslibs {
+
+struct CancelToken::State {
+  std::atomic_bool cancelled = false;
+  /** Guards interrupts, so none is called after its registration is destroyed. */
+  std::mutex mutex;
+  std::uint64_t next_id = 0;
+  /** Interrupts for the running queries, by registration */
+  std::map<std::uint64_t, std::function<void()>> interrupts;
+};
+
+CancelToken::InterruptRegistration::InterruptRegistration(std::shared_ptr<State> state, std::uint64_t id)
+    : state_(std::move(state)), id_(id) {}
+
+CancelToken::InterruptRegistration::InterruptRegistration(InterruptRegistration &&other) noexcept
+    : state_(std::move(other.state_)), id_(other.id_) {}
+
+CancelToken::InterruptRegistration::~InterruptRegistration() {
+  if (!state_) {
+    // Moved from
+    return;
+  }
+  std::lock_guard lock(state_->mutex);
+  state_->interrupts.erase(id_);
+}
+
+CancelToken::CancelToken() : state_(std::make_shared<State>()) {}
+
+void CancelToken::Cancel() {
+  std::lock_guard lock(state_->mutex);
+  state_->cancelled = true;
+  for (const auto &[id, interrupt] : state_->interrupts) {
+    interrupt();
+  }
+}
+
+bool CancelToken::IsCancelled() const {
+  return state_->cancelled;
+}
+
+std::optional<CancelToken::InterruptRegistration> CancelToken::AddInterrupt(std::function<void()> interrupt) {
+  std::lock_guard lock(state_->mutex);
+  if (state_->cancelled) {
+    return {};
+  }
+  const std::uint64_t id = state_->next_id++;
+  state_->interrupts.emplace(id, std::move(interrupt));
+  return InterruptRegistration(state_, id);
+}
+
+} // cslibs
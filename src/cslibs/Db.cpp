@@ -9,22 +9,55 @@
 #include "cslibs/Db.h"
 #include "cslibs/except.h"
 #include <utility>
+#include <SQLiteCpp/Transaction.h>
 #include <fmt/format.h>
 #include <csprofileeditor_config.h>
 #include <sqlite3.h>
 #include <filesystem>
+#include <map>
+#include <mutex>
+#include <tuple>
 #include <boost/algorithm/string/predicate.hpp>
+#include <cctype>
 
 using boost::algorithm::ilexicographical_compare;
 
 namespace cslibs {
 
+/**
+ * Map the file at @p path, sharing the mapping with other users of the same file.
+ *
+ * @param path
+ * @param size
+ * @param modified
+ * @return The mapping, or nullptr if the file could not be mapped.
+ */
+static std::shared_ptr<const MappedFile> ShareMappedFile(const std::string &path,
+                                                         std::int64_t size,
+                                                         std::int64_t modified) {
+  static std::mutex mapped_files_mutex;
+  static std::map<std::tuple<std::string, std::int64_t, std::int64_t>, std::weak_ptr<const MappedFile>> mapped_files;
+
+  std::lock_guard lock(mapped_files_mutex);
+  auto &shared = mapped_files[{path, size, modified}];
+  auto mapped_file = shared.lock();
+  if (!mapped_file) {
+    try {
+      mapped_file = std::make_shared<const MappedFile>(path);
+    } catch (const except::DefsError &) {
+      return {};
+    }
+    shared = mapped_file;
+  }
+  return mapped_file;
+}
+
 Db::Db(std::string defs_path, const std::string &db_path, bool allow_writing)
     : defs_file_path_(std::move(defs_path)) {
   // Open the database
   // Lots of error handling because failure can stop the application completely.
   try {
-    db_.emplace(db_path, allow_writing ? (SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE) : SQLite::OPEN_READONLY);
+    Open(db_path, allow_writing);
   } catch (const SQLite::Exception &e) {
     // Try opening/closing in read only to fix the WAL log.
     try {
@@ -42,6 +75,9 @@ Db::Db(std::string defs_path, const std::string &db_path, bool allow_writing)
       UseFreshDatabase(db_path, allow_writing);
     }
   }
+  // Indexes use this, so it must exist before any other queries.
+  RegisterCollation();
+
   // Use WAL mode
   db_->exec("PRAGMA journal_mode=WAL;");
 
@@ -56,8 +92,11 @@ Db::Db(std::string defs_path, const std::string &db_path, bool allow_writing)
 
 bool Db::UpToDate() {
   const unsigned int user_version = db_->execAndGet("PRAGMA user_version;").getUInt();
-  const DefsFile defs_file(defs_file_path_);
-  const DefsFile::Version defs_version = defs_file.GetVersion();
+  const DefsFile::Header defs_header = DefsFile::ProbeHeader(defs_file_path_);
+  if (!defs_header.IsValid()) {
+    throw except::DefsError("File is not valid");
+  }
+  const DefsFile::Version &defs_version = defs_header.version;
   return defs_version.major == ((user_version & (0xFF << 16)) >> 16)
       && defs_version.minor == ((user_version & (0xFF << 8)) >> 8)
       && defs_version.patch == ((user_version & (0xFF << 0)) >> 0);
@@ -75,13 +114,78 @@ void Db::Update(const ProgressCallback &progress_callback) {
   if (DatabaseIsReadOnly()) {
     throw except::ReadOnlyDbError();
   }
-  CreateManufacturerSeriesTables();
-  this->CreateTables();
-  Reset();
-  this->LoadFromDefsFile(progress_callback);
+  Migrate();
+
+  // Pragmas can't be changed inside the transaction, so apply them first.
+  const ImportPragmas previous_pragmas = GetPragmas();
+  ApplyPragmas(import_pragmas_);
+  try {
+    // The transaction rolls back when destroyed without being committed.
+    SQLite::Transaction transaction(*db_);
+    CreateManufacturerSeriesTables();
+    this->CreateTables();
+    Reset();
+    this->LoadFromDefsFile(progress_callback);
+    CreateSearchIndex();
+    transaction.commit();
+  } catch (...) {
+    import_statements_.reset();
+    try {
+      ApplyPragmas(previous_pragmas);
+    } catch (const std::exception &) {
+      // Keep the import error; the connection is only left with the faster import pragmas.
+    }
+    throw;
+  }
+  import_statements_.reset();
+  ApplyPragmas(previous_pragmas);
   Optimize();
 }
 
+void Db::Migrate() {
+  if (DatabaseIsReadOnly()) {
+    return;
+  }
+  const auto migrations = GetMigrations();
+  try {
+    db_->exec(R"EOF(
+      CREATE TABLE IF NOT EXISTS schema_version
+      (
+          id      INTEGER
+              PRIMARY KEY
+              CHECK (id = 1),
+          version INTEGER NOT NULL
+      );
+    )EOF");
+    const unsigned int schema_version = GetSchemaVersion();
+    if (schema_version >= migrations.size()) {
+      return;
+    }
+
+    SQLite::Transaction transaction(*db_);
+    // Databases that have never been loaded have no tables to migrate.
+    if (db_->tableExists("manufacturer")) {
+      for (auto migration = migrations.cbegin() + schema_version; migration != migrations.cend(); ++migration) {
+        (*migration)();
+      }
+    }
+    SQLite::Statement version_q(*db_, "INSERT OR REPLACE INTO schema_version(id, version) VALUES (1, :version);");
+    version_q.bind(":version", static_cast<unsigned int>(migrations.size()));
+    version_q.exec();
+    transaction.commit();
+  } catch (const SQLite::Exception &e) {
+    throw except::DbError(fmt::format("Error upgrading database: {}", e.what()));
+  }
+}
+
+unsigned int Db::GetSchemaVersion() {
+  SQLite::Statement q(*db_, "SELECT version FROM schema_version WHERE id = 1;");
+  if (!q.executeStep()) {
+    return 0;
+  }
+  return q.getColumn(0).getUInt();
+}
+
 void Db::Reset() {
   this->ClearRecords();
   db_->exec(R"EOF(
@@ -90,6 +194,14 @@ void Db::Reset() {
   )EOF");
 }
 
+std::int64_t Db::GetDataVersion() {
+  return db_->execAndGet("PRAGMA data_version;").getInt64();
+}
+
+void Db::Interrupt() {
+  sqlite3_interrupt(db_->getHandle());
+}
+
 std::vector<Manufacturer> Db::GetManufacturers() {
   SQLite::Statement q(*db_, R"EOF(
     SELECT id, name
@@ -160,11 +272,32 @@ void Db::Optimize() {
   db_->exec("PRAGMA OPTIMIZE; VACUUM;");
 }
 
-void Db::ReOpen(const std::string &db_path, bool allow_writing) {
-  db_.reset();
-  db_.emplace(db_path, SQLite::OPEN_READONLY);
+Db::ImportPragmas Db::GetPragmas() {
+  ImportPragmas pragmas;
+  pragmas.synchronous = db_->execAndGet("PRAGMA synchronous;").getInt();
+  pragmas.cache_size = db_->execAndGet("PRAGMA cache_size;").getInt();
+  pragmas.temp_store = db_->execAndGet("PRAGMA temp_store;").getInt();
+  return pragmas;
+}
+
+void Db::ApplyPragmas(const ImportPragmas &pragmas) {
+  db_->exec(fmt::format("PRAGMA synchronous = {}; PRAGMA cache_size = {}; PRAGMA temp_store = {};",
+                        pragmas.synchronous, pragmas.cache_size, pragmas.temp_store));
+}
+
+void Db::Open(const std::string &db_path, bool allow_writing) {
   db_.reset();
-  db_.emplace(db_path, allow_writing ? (SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE) : SQLite::OPEN_READONLY);
+  if (allow_writing) {
+    // The writer may be shared between threads (e.g. the GUI and a library update), so keep SQLite's locking.
+    db_.emplace(db_path, SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE | SQLite::OPEN_FULLMUTEX, kBusyTimeout);
+  } else {
+    db_.emplace(db_path, SQLite::OPEN_READONLY | SQLite::OPEN_NOMUTEX, kBusyTimeout);
+  }
+}
+
+void Db::ReOpen(const std::string &db_path, bool allow_writing) {
+  Open(db_path, false);
+  Open(db_path, allow_writing);
 }
 
 void Db::UseFreshDatabase(const std::string &db_path, bool allow_writing) {
@@ -172,85 +305,292 @@ void Db::UseFreshDatabase(const std::string &db_path, bool allow_writing) {
   for (const auto &suffix : {"-journal", "-wal", "-shm", ""}) {
     std::filesystem::remove(fmt::format("{}{}", db_path, suffix));
   }
-  db_.emplace(db_path, allow_writing ? (SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE) : SQLite::OPEN_READONLY);
+  Open(db_path, allow_writing);
+}
+
+void Db::CreateSearchIndex() {
+  try {
+    db_->exec(R"EOF(
+      DROP TABLE IF EXISTS search;
+
+      CREATE VIRTUAL TABLE search USING fts5
+      (
+          code,
+          name,
+          manufacturer,
+          series,
+          tokenize = 'unicode61 remove_diacritics 2',
+          prefix = '1 2 3'
+      );
+    )EOF");
+  } catch (const SQLite::Exception &e) {
+    // No FTS5; Search() falls back to LIKE.
+    return;
+  }
+  // The search rowid is the record id.
+  db_->exec(fmt::format(R"EOF(
+    INSERT INTO search(rowid, code, name, manufacturer, series)
+    SELECT {base_table}.id,
+           {base_table}.code,
+           {base_table}.name,
+           manufacturer.name,
+           series.name
+    FROM {base_table}
+             INNER JOIN series ON {base_table}.series_id = series.id
+             INNER JOIN manufacturer ON series.manufacturer_id = manufacturer.id;
+  )EOF", fmt::arg("base_table", GetBaseTable())));
+}
+
+std::vector<std::string> Db::GetSearchTerms(const std::string &query) {
+  std::vector<std::string> terms;
+  std::string term;
+  for (const char c : query) {
+    if (std::isspace(static_cast<unsigned char>(c))) {
+      if (!term.empty()) {
+        terms.push_back(std::move(term));
+        term.clear();
+      }
+    } else if (c != '"') {
+      // Quotes would end the FTS5 string.
+      term.push_back(c);
+    }
+  }
+  if (!term.empty()) {
+    terms.push_back(std::move(term));
+  }
+  return terms;
+}
+
+std::vector<Db::SearchResult> Db::Search(const std::string &query, std::size_t limit) {
+  const auto terms = GetSearchTerms(query);
+  if (terms.empty() || limit == 0 || !db_->tableExists(GetBaseTable())) {
+    return {};
+  }
+
+  std::optional<SQLite::Statement> q;
+  const bool has_search_index = db_->tableExists("search");
+  if (has_search_index) {
+    // Every term must match the start of a word.
+    std::vector<std::string> match_terms;
+    for (const auto &term : terms) {
+      match_terms.push_back(fmt::format("\"{}\"*", term));
+    }
+    // Code and name matches are worth more than manufacturer and series matches.
+    q.emplace(*db_, fmt::format(R"EOF(
+      SELECT {base_table}.id,
+             {base_table}.dcid,
+             {base_table}.code,
+             {base_table}.name,
+             search.manufacturer,
+             search.series,
+             bm25(search, 10.0, 5.0, 1.0, 1.0) AS rank
+      FROM search
+               INNER JOIN {base_table} ON search.rowid = {base_table}.id
+      WHERE search MATCH ?2
+      ORDER BY rank
+      LIMIT ?1;
+    )EOF", fmt::arg("base_table", GetBaseTable())));
+    q->bind(2, fmt::format("{}", fmt::join(match_terms, " ")));
+  } else {
+    // Every term must be somewhere in one of the columns.
+    std::vector<std::string> conditions;
+    for (std::size_t ix = 0; ix < terms.size(); ++ix) {
+      conditions.push_back(fmt::format(
+          R"EOF(({base_table}.code LIKE ?{param} ESCAPE '\'
+               OR {base_table}.name LIKE ?{param} ESCAPE '\'
+               OR manufacturer.name LIKE ?{param} ESCAPE '\'
+               OR series.name LIKE ?{param} ESCAPE '\'))EOF",
+          fmt::arg("base_table", GetBaseTable()), fmt::arg("param", ix + 2)));
+    }
+    q.emplace(*db_, fmt::format(R"EOF(
+      SELECT {base_table}.id,
+             {base_table}.dcid,
+             {base_table}.code,
+             {base_table}.name,
+             manufacturer.name,
+             series.name
+      FROM {base_table}
+               INNER JOIN series ON {base_table}.series_id = series.id
+               INNER JOIN manufacturer ON series.manufacturer_id = manufacturer.id
+      WHERE {conditions}
+      ORDER BY {base_table}.name COLLATE {collation}
+      LIMIT ?1;
+    )EOF",
+                                fmt::arg("base_table", GetBaseTable()),
+                                fmt::arg("conditions", fmt::join(conditions, " AND ")),
+                                fmt::arg("collation", kCollation)));
+    for (std::size_t ix = 0; ix < terms.size(); ++ix) {
+      std::string pattern;
+      for (const char c : terms[ix]) {
+        if (c == '%' || c == '_' || c == '\\') {
+          pattern.push_back('\\');
+        }
+        pattern.push_back(c);
+      }
+      q->bind(static_cast<int>(ix + 2), fmt::format("%{}%", pattern));
+    }
+  }
+  q->bind(1, static_cast<std::int64_t>(limit));
+
+  std::vector<SearchResult> results;
+  while (q->executeStep()) {
+    results.push_back({
+                          q->getColumn(0).getInt64(),
+                          q->getColumn(1).getString(),
+                          q->getColumn(2).getString(),
+                          q->getColumn(3).getString(),
+                          q->getColumn(4).getString(),
+                          q->getColumn(5).getString(),
+                          // Without a relevance score, rank by position, after any full-text match.
+                          has_search_index ? q->getColumn(6).getDouble() : static_cast<double>(results.size() + 1),
+                      });
+  }
+  return results;
+}
+
+std::vector<std::pair<std::size_t, Db::SearchResult>> Db::SearchAll(const std::vector<std::shared_ptr<Db>> &dbs,
+                                                                    const std::string &query,
+                                                                    std::size_t limit) {
+  std::vector<std::vector<SearchResult>> db_results(dbs.size());
+  for (std::size_t db = 0; db < dbs.size(); ++db) {
+    if (dbs[db]) {
+      db_results[db] = dbs[db]->Search(query, limit);
+    }
+  }
+  return MergeSearchResults(std::move(db_results), limit);
+}
+
+std::vector<std::pair<std::size_t, Db::SearchResult>> Db::MergeSearchResults(std::vector<std::vector<SearchResult>> db_results,
+                                                                             std::size_t limit) {
+  std::vector<std::pair<std::size_t, SearchResult>> results;
+  for (std::size_t db = 0; db < db_results.size(); ++db) {
+    // Full-text ranks depend on each database's contents, so scale them to the database's best match.
+    const double best_rank = db_results[db].empty() ? 0.0 : db_results[db].front().rank;
+    for (auto &result : db_results[db]) {
+      if (best_rank < 0.0 && result.rank < 0.0) {
+        result.rank /= -best_rank;
+      }
+      results.emplace_back(db, std::move(result));
+    }
+  }
+  std::stable_sort(results.begin(), results.end(), [](const auto &a, const auto &b) {
+    return a.second.rank < b.second.rank;
+  });
+  if (results.size() > limit) {
+    results.resize(limit);
+  }
+  return results;
+}
+
+void Db::RegisterCollation() {
+  const int result = sqlite3_create_collation_v2(
+      db_->getHandle(), kCollation, SQLITE_UTF8, nullptr,
+      [](void *, int lhs_size, const void *lhs_data, int rhs_size, const void *rhs_data) {
+        const std::string_view lhs(static_cast<const char *>(lhs_data), lhs_size);
+        const std::string_view rhs(static_cast<const char *>(rhs_data), rhs_size);
+        if (ilexicographical_compare(lhs, rhs)) {
+          return -1;
+        } else if (ilexicographical_compare(rhs, lhs)) {
+          return 1;
+        }
+        return 0;
+      },
+      nullptr);
+  if (result != SQLITE_OK) {
+    throw except::DbError(fmt::format("Could not register collation: {}", sqlite3_errstr(result)));
+  }
 }
 
 bool Db::DatabaseIsReadOnly() {
   return sqlite3_db_readonly(db_->getHandle(), "main") != 0;
 }
 
+Db::ImportStatements::ImportStatements(SQLite::Database &db)
+    : manufacturer_get(db, "SELECT id FROM manufacturer WHERE name = :name;"),
+      manufacturer_insert(db, "INSERT INTO manufacturer(name) VALUES (:name);"),
+      series_get(db, "SELECT id FROM series WHERE manufacturer_id = :manufacturer_id AND name = :name;"),
+      series_insert(db, "INSERT INTO series(manufacturer_id, name) VALUES (:manufacturer_id, :name);") {}
+
+Db::ImportStatements &Db::GetImportStatements() {
+  if (!import_statements_.has_value()) {
+    import_statements_.emplace(*db_);
+  }
+  return *import_statements_;
+}
+
 unsigned int Db::GetManufacturerIdForName(const std::string &name, ManufacturerIdCache &cache) {
-  SQLite::Statement manufacturer_get_q(*db_, "SELECT id FROM manufacturer WHERE name = :name;");
-  SQLite::Statement manufacturer_insert_q(*db_, "INSERT INTO manufacturer(name) VALUES (:name);");
+  const auto cached = cache.find(name);
+  if (cached != cache.end()) {
+    return cached->second;
+  }
 
+  // Fetch from the database
+  auto &statements = GetImportStatements();
+  auto &manufacturer_get_q = statements.manufacturer_get;
   unsigned int manufacturer_id;
   try {
-    manufacturer_id = cache.at(name);
-  } catch (const std::out_of_range &) {
-    // Fetch from the database
+    manufacturer_get_q.reset();
+    manufacturer_get_q.bind(":name", name);
+    manufacturer_get_q.executeStep();
+  } catch (const SQLite::Exception &e) {
+    throw except::DbError(fmt::format("Error fetching manufacturer id: {}", e.what()));
+  }
+  if (manufacturer_get_q.hasRow()) {
+    // Db has manufacturer
+    manufacturer_id = manufacturer_get_q.getColumn("id").getUInt();
+  } else {
+    // Db doesn't have manufacturer
+    auto &manufacturer_insert_q = statements.manufacturer_insert;
     try {
-      manufacturer_get_q.reset();
-      manufacturer_get_q.bind(":name", name);
-      manufacturer_get_q.executeStep();
+      manufacturer_insert_q.reset();
+      manufacturer_insert_q.bind(":name", name);
+      manufacturer_insert_q.exec();
     } catch (const SQLite::Exception &e) {
-      throw except::DbError(fmt::format("Error fetching manufacturer id: {}", e.what()));
+      throw except::DbError(fmt::format("Error adding manufacturer id: {}", e.what()));
     }
-    if (manufacturer_get_q.hasRow()) {
-      // Db has manufacturer
-      manufacturer_id = manufacturer_get_q.getColumn("id").getUInt();
-    } else {
-      // Db doesn't have manufacturer
-      try {
-        manufacturer_insert_q.reset();
-        manufacturer_insert_q.bind(":name", name);
-        manufacturer_insert_q.exec();
-      } catch (const SQLite::Exception &e) {
-        throw except::DbError(fmt::format("Error adding manufacturer id: {}", e.what()));
-      }
-      manufacturer_id = db_->getLastInsertRowid();
-    }
-    cache.insert({name, manufacturer_id});
+    manufacturer_id = db_->getLastInsertRowid();
   }
+  cache.insert({name, manufacturer_id});
 
   return manufacturer_id;
 }
 
 unsigned int Db::GetSeriesIdForName(const std::string &name, unsigned int manufacturer_id, SeriesIdCache &cache) {
-  SQLite::Statement series_get_q
-      (*db_, "SELECT id FROM series WHERE manufacturer_id = :manufacturer_id AND name = :name;");
-  SQLite::Statement series_insert_q
-      (*db_, "INSERT INTO series(manufacturer_id, name) VALUES (:manufacturer_id, :name);");
+  auto &manufacturer_cache = cache[manufacturer_id];
+  const auto cached = manufacturer_cache.find(name);
+  if (cached != manufacturer_cache.end()) {
+    return cached->second;
+  }
 
+  // Fetch from the database
+  auto &statements = GetImportStatements();
+  auto &series_get_q = statements.series_get;
   unsigned int series_id;
   try {
-    series_id = cache.at(manufacturer_id).at(name);
-  } catch (const std::out_of_range &) {
-    // Fetch from the database
+    series_get_q.reset();
+    series_get_q.bind(":manufacturer_id", manufacturer_id);
+    series_get_q.bind(":name", name);
+    series_get_q.executeStep();
+  } catch (const SQLite::Exception &e) {
+    throw except::DbError(fmt::format("Error fetching series id: {}", e.what()));
+  }
+  if (series_get_q.hasRow()) {
+    // Db has series
+    series_id = series_get_q.getColumn("id").getUInt();
+  } else {
+    // Db doesn't have series
+    auto &series_insert_q = statements.series_insert;
     try {
-      series_get_q.reset();
-      series_get_q.bind(":manufacturer_id", manufacturer_id);
-      series_get_q.bind(":name", name);
-      series_get_q.executeStep();
+      series_insert_q.reset();
+      series_insert_q.bind(":manufacturer_id", manufacturer_id);
+      series_insert_q.bind(":name", name);
+      series_insert_q.exec();
     } catch (const SQLite::Exception &e) {
-      throw except::DbError(fmt::format("Error fetching series id: {}", e.what()));
-    }
-    if (series_get_q.hasRow()) {
-      // Db has series
-      series_id = series_get_q.getColumn("id").getUInt();
-    } else {
-      // Db doesn't have series
-      try {
-        series_insert_q.reset();
-        series_insert_q.bind(":manufacturer_id", manufacturer_id);
-        series_insert_q.bind(":name", name);
-        series_insert_q.exec();
-      } catch (const SQLite::Exception &e) {
-        throw except::DbError(fmt::format("Error adding series id: {}", e.what()));
-      }
-      series_id = db_->getLastInsertRowid();
+      throw except::DbError(fmt::format("Error adding series id: {}", e.what()));
     }
-    cache[manufacturer_id].insert({name, series_id});
+    series_id = db_->getLastInsertRowid();
   }
+  manufacturer_cache.insert({name, series_id});
 
   return series_id;
 }
@@ -262,6 +602,9 @@ ImageDb::ImageDb(std::string defs_path,
                  bool allow_writing) : Db(std::move(defs_path), db_path, allow_writing),
                                        data_index_path_(std::move(data_index_path)),
                                        data_path_(std::move(data_path)) {
+  const std::filesystem::path data_index_file_name = std::filesystem::path(data_index_path_).filename();
+  data_index_cache_path_ = (std::filesystem::path(db_path).parent_path()
+      / data_index_file_name.string().append(".bin")).string();
 }
 
 void ImageDb::CreateTables() {
@@ -269,48 +612,271 @@ void ImageDb::CreateTables() {
 }
 
 void ImageDb::CreateImageTable() {
+  // Tables from before image references were supported require an image; they're about to be reloaded anyway, so
+  // replace them.
+  SQLite::Statement image_required_q(*db_, fmt::format(
+      "SELECT \"notnull\" FROM pragma_table_info('{base_table}') WHERE name = 'image';",
+      fmt::arg("base_table", GetBaseTable())));
+  if (image_required_q.executeStep() && image_required_q.getColumn(0).getInt() != 0) {
+    image_required_q.reset();
+    db_->exec(fmt::format("DROP TABLE {base_table};", fmt::arg("base_table", GetBaseTable())));
+  }
+
+  // Images are either stored in "image" or referenced with "image_offset" and "image_size".
   db_->exec(fmt::format(R"EOF(
     CREATE TABLE IF NOT EXISTS {base_table}
     (
-        id        INTEGER
+        id           INTEGER
             PRIMARY KEY,
-        dcid      TEXT    NOT NULL,
-        series_id INTEGER NOT NULL
+        dcid         TEXT    NOT NULL,
+        series_id    INTEGER NOT NULL
             REFERENCES series
                 ON DELETE CASCADE,
-        code      TEXT    NOT NULL,
-        name      TEXT    NOT NULL,
-        image     BLOB    NOT NULL
+        code         TEXT    NOT NULL,
+        name         TEXT    NOT NULL,
+        image        BLOB,
+        image_offset INTEGER,
+        image_size   INTEGER
+    );
+
+    CREATE TABLE IF NOT EXISTS image_source
+    (
+        id       INTEGER
+            PRIMARY KEY
+            CHECK (id = 1),
+        size       INTEGER NOT NULL,
+        modified   INTEGER NOT NULL,
+        path       TEXT    NOT NULL DEFAULT '',
+        referenced INTEGER NOT NULL DEFAULT 1
     );
 
+    CREATE UNIQUE INDEX IF NOT EXISTS {base_table}_dcid_index
+        ON {base_table} (dcid);
+
     CREATE INDEX IF NOT EXISTS {base_table}_name_index
         ON {base_table} (name);
 
-    CREATE INDEX IF NOT EXISTS {base_table}_series_id_code_index
-        ON {base_table} (series_id, code);
-
     CREATE INDEX IF NOT EXISTS {base_table}_series_id_index
         ON {base_table} (series_id);
   )EOF", fmt::arg("base_table", GetBaseTable())));
+  CreateThumbnailTable();
+  CreateSortIndexes();
+}
+
+void ImageDb::CreateSortIndexes() {
+  // Allow GetForSeries() to read rows in order
+  db_->exec(fmt::format(R"EOF(
+    CREATE INDEX IF NOT EXISTS {base_table}_series_id_code_index
+        ON {base_table} (series_id, code COLLATE {collation});
+
+    CREATE INDEX IF NOT EXISTS {base_table}_series_id_name_index
+        ON {base_table} (series_id, name COLLATE {collation});
+  )EOF", fmt::arg("base_table", GetBaseTable()), fmt::arg("collation", kCollation)));
+}
+
+void ImageDb::CreateThumbnailTable() {
+  db_->exec(fmt::format(R"EOF(
+    CREATE TABLE IF NOT EXISTS {base_table}_thumbnail
+    (
+        image_id  INTEGER NOT NULL
+            REFERENCES {base_table}
+                ON DELETE CASCADE,
+        size      INTEGER NOT NULL,
+        thumbnail BLOB    NOT NULL,
+        PRIMARY KEY (image_id, size)
+    );
+  )EOF", fmt::arg("base_table", GetBaseTable())));
 }
 
 void ImageDb::ClearRecords() {
-  db_->exec(fmt::format("DELETE FROM {base_table};", fmt::arg("base_table", GetBaseTable())));
+  // image_source is kept until the import replaces it, so GetImportImageStorage() can see where the last import was
+  // from.
+  db_->exec(fmt::format("DELETE FROM {base_table}_thumbnail; DELETE FROM {base_table};",
+                        fmt::arg("base_table", GetBaseTable())));
+}
+
+std::vector<Db::Migration> ImageDb::GetMigrations() {
+  return {
+      // 1: Image references
+      [this]() {
+        bool has_image_offset = false;
+        SQLite::Statement columns_q(*db_, fmt::format("SELECT name FROM pragma_table_info('{base_table}');",
+                                                      fmt::arg("base_table", GetBaseTable())));
+        while (columns_q.executeStep()) {
+          has_image_offset = has_image_offset || columns_q.getColumn(0).getString() == "image_offset";
+        }
+        if (!has_image_offset) {
+          db_->exec(fmt::format(R"EOF(
+            ALTER TABLE {base_table} ADD COLUMN image_offset INTEGER;
+            ALTER TABLE {base_table} ADD COLUMN image_size INTEGER;
+          )EOF", fmt::arg("base_table", GetBaseTable())));
+        }
+        db_->exec(R"EOF(
+          CREATE TABLE IF NOT EXISTS image_source
+          (
+              id       INTEGER
+                  PRIMARY KEY
+                  CHECK (id = 1),
+              size     INTEGER NOT NULL,
+              modified INTEGER NOT NULL
+          );
+        )EOF");
+      },
+      // 2: Unique dcid
+      [this]() {
+        // Keep the first of any duplicates, which is the one lookups returned before.
+        db_->exec(fmt::format(R"EOF(
+          DELETE FROM {base_table}
+          WHERE id NOT IN (SELECT MIN(id) FROM {base_table} GROUP BY dcid);
+
+          CREATE UNIQUE INDEX IF NOT EXISTS {base_table}_dcid_index
+              ON {base_table} (dcid);
+        )EOF", fmt::arg("base_table", GetBaseTable())));
+      },
+      // 3: Thumbnails; existing rows don't have any until the next Update().
+      [this]() {
+        CreateThumbnailTable();
+      },
+      // 4: Case-insensitive sort indexes
+      [this]() {
+        db_->exec(fmt::format("DROP INDEX IF EXISTS {base_table}_series_id_code_index;",
+                              fmt::arg("base_table", GetBaseTable())));
+        CreateSortIndexes();
+      },
+      // 5: Data file path, for falling back to blobs when it moves
+      [this]() {
+        bool has_path = false;
+        SQLite::Statement columns_q(*db_, "SELECT name FROM pragma_table_info('image_source');");
+        while (columns_q.executeStep()) {
+          has_path = has_path || columns_q.getColumn(0).getString() == "path";
+        }
+        if (!has_path) {
+          // Existing references have an unknown path, which doesn't count as moved.
+          db_->exec(R"EOF(
+            ALTER TABLE image_source ADD COLUMN path TEXT NOT NULL DEFAULT '';
+            ALTER TABLE image_source ADD COLUMN referenced INTEGER NOT NULL DEFAULT 1;
+          )EOF");
+        }
+      },
+  };
+}
+
+bool ImageDb::UpToDate() {
+  if (!Db::UpToDate()) {
+    return false;
+  }
+  // References into a data file that has since changed are useless.
+  return !HasImageReferences() || GetReferencedDataFile();
+}
+
+ImageDb::ImageStorage ImageDb::GetImportImageStorage() {
+  if (image_storage_ != ImageStorage::kReference) {
+    return ImageStorage::kBlob;
+  }
+  SQLite::Statement q(*db_, "SELECT path, referenced FROM image_source WHERE id = 1;");
+  if (q.executeStep()) {
+    const std::string path = q.getColumn(0).getString();
+    // A data file that has moved once may move again, which would leave references pointing nowhere.
+    if (q.getColumn(1).getInt() == 0 || (!path.empty() && path != GetDataPathForSource())) {
+      return ImageStorage::kBlob;
+    }
+  }
+  return ImageStorage::kReference;
+}
+
+void ImageDb::SaveImageSource(ImageStorage image_storage) {
+  {
+    std::lock_guard lock(*data_file_mutex_);
+    data_file_.reset();
+  }
+  db_->exec("DELETE FROM image_source;");
+  if (image_storage_ != ImageStorage::kReference) {
+    return;
+  }
+  // A fallback to blobs is remembered too, so later imports keep using blobs.
+  const auto image_source = GetCurrentImageSource();
+  if (!image_source.has_value()) {
+    throw except::DefsError("Could not open data file");
+  }
+  SQLite::Statement q(*db_, R"EOF(
+    INSERT INTO image_source(id, size, modified, path, referenced)
+    VALUES (1, :size, :modified, :path, :referenced);
+  )EOF");
+  q.bind(":size", image_source->size);
+  q.bind(":modified", image_source->modified);
+  q.bind(":path", GetDataPathForSource());
+  q.bind(":referenced", image_storage == ImageStorage::kReference ? 1 : 0);
+  q.exec();
+}
+
+std::optional<std::string_view> ImageDb::GetReferencedImage(unsigned long offset, unsigned long size) {
+  const auto data_file = GetReferencedDataFile();
+  if (!data_file) {
+    return {};
+  }
+  const std::string_view data = data_file->GetData();
+  if (offset > data.size()) {
+    return {};
+  }
+  return data.substr(offset, size);
+}
+
+std::optional<ImageDb::ImageSource> ImageDb::GetCurrentImageSource() const {
+  std::error_code ec;
+  const auto size = std::filesystem::file_size(data_path_, ec);
+  if (ec) {
+    return {};
+  }
+  const auto modified = std::filesystem::last_write_time(data_path_, ec);
+  if (ec) {
+    return {};
+  }
+  return ImageSource{static_cast<std::int64_t>(size), modified.time_since_epoch().count()};
+}
+
+std::string ImageDb::GetDataPathForSource() const {
+  return std::filesystem::absolute(data_path_).lexically_normal().string();
+}
+
+std::shared_ptr<const MappedFile> ImageDb::GetReferencedDataFile() {
+  // The file can be rewritten by the official editor at any time; an old mapping would return the wrong images.
+  const auto image_source = GetCurrentImageSource();
+  // The GUI thread and the updater share this object.
+  std::lock_guard lock(*data_file_mutex_);
+  if (!image_source.has_value()) {
+    data_file_.reset();
+    return nullptr;
+  }
+  if (data_file_.has_value() && data_file_->source == *image_source) {
+    return data_file_->file;
+  }
+  data_file_.reset();
+
+  // Only trust the data file if it's the same one that was imported.
+  SQLite::Statement q(*db_, "SELECT size, modified FROM image_source WHERE id = 1 AND referenced = 1;");
+  if (!q.executeStep() || !(ImageSource{q.getColumn(0).getInt64(), q.getColumn(1).getInt64()} == *image_source)) {
+    return nullptr;
+  }
+  auto data_file = ShareMappedFile(data_path_, image_source->size, image_source->modified);
+  if (data_file) {
+    data_file_ = DataFile{*image_source, data_file};
+  }
+  return data_file;
+}
+
+bool ImageDb::HasImageReferences() {
+  if (!db_->tableExists("image_source")) {
+    return false;
+  }
+  return db_->execAndGet("SELECT COUNT(*) FROM image_source WHERE referenced = 1;").getInt() > 0;
 }
 
 std::vector<ImageEntity> ImageDb::GetForSeries(const Series &series, ImageDb::Sort sort_by) {
   std::string order_by;
-  std::function<bool(const ImageEntity &, const ImageEntity &)> comp;
   switch (sort_by) {
-    case Sort::kName:order_by = "name ASC";
-      comp = [](const ImageEntity &a, const ImageEntity &b) {
-        return ilexicographical_compare(a.GetName(), b.GetName());
-      };
+    case Sort::kName:order_by = fmt::format("name COLLATE {} ASC", kCollation);
       break;
-    case Sort::kCode:order_by = "code ASC";
-      comp = [](const ImageEntity &a, const ImageEntity &b) {
-        return ilexicographical_compare(a.GetCode(), b.GetCode());
-      };
+    case Sort::kCode:order_by = fmt::format("code COLLATE {} ASC", kCollation);
       break;
   }
 
@@ -318,40 +884,193 @@ std::vector<ImageEntity> ImageDb::GetForSeries(const Series &series, ImageDb::So
     SELECT dcid,
            code,
            name,
-           image
+           image,
+           image_offset,
+           image_size
     FROM {base_table}
     WHERE {base_table}.series_id = :series_id
     ORDER BY {order_by};
   )EOF", fmt::arg("base_table", GetBaseTable()), fmt::arg("order_by", order_by)));
   q.bind(":series_id", series.GetId());
   std::vector<ImageEntity> results;
+  while (q.executeStep()) {
+    if (q.getColumn("image").isNull()) {
+      const auto image = GetReferencedImage(q.getColumn("image_offset").getInt64(),
+                                            q.getColumn("image_size").getInt64());
+      results.emplace_back(
+          q.getColumn("dcid").getString(),
+          q.getColumn("code").getString(),
+          q.getColumn("name").getString(),
+          image.has_value() ? image->data() : nullptr,
+          image.has_value() ? image->size() : 0
+      );
+    } else {
+      results.emplace_back(
+          q.getColumn("dcid").getString(),
+          q.getColumn("code").getString(),
+          q.getColumn("name").getString(),
+          q.getColumn("image").getBlob(),
+          q.getColumn("image").size()
+      );
+    }
+  }
+  return results;
+}
+
+std::vector<ImageEntityInfo> ImageDb::GetInfoForSeries(const Series &series, ImageDb::Sort sort_by) {
+  std::string order_by;
+  switch (sort_by) {
+    case Sort::kName:order_by = fmt::format("name COLLATE {} ASC", kCollation);
+      break;
+    case Sort::kCode:order_by = fmt::format("code COLLATE {} ASC", kCollation);
+      break;
+  }
+
+  SQLite::Statement q(*db_, fmt::format(R"EOF(
+    SELECT dcid,
+           code,
+           name
+    FROM {base_table}
+    WHERE {base_table}.series_id = :series_id
+    ORDER BY {order_by};
+  )EOF", fmt::arg("base_table", GetBaseTable()), fmt::arg("order_by", order_by)));
+  q.bind(":series_id", series.GetId());
+  std::vector<ImageEntityInfo> results;
   while (q.executeStep()) {
     results.emplace_back(
         q.getColumn("dcid").getString(),
         q.getColumn("code").getString(),
-        q.getColumn("name").getString(),
-        q.getColumn("image").getBlob(),
-        q.getColumn("image").size()
+        q.getColumn("name").getString()
     );
   }
-  if (comp) {
-    std::sort(results.begin(), results.end(), comp);
+  return results;
+}
+
+std::unordered_map<std::string, std::vector<char>> ImageDb::GetImagesForDcids(const std::vector<std::string> &dcids) {
+  std::unordered_map<std::string, std::vector<char>> results;
+  for (std::size_t batch_start = 0; batch_start < dcids.size(); batch_start += kMaxDcidsPerQuery) {
+    const auto batch_size = std::min(kMaxDcidsPerQuery, dcids.size() - batch_start);
+    SQLite::Statement q(*db_, fmt::format(R"EOF(
+      SELECT dcid,
+             image,
+             image_offset,
+             image_size
+      FROM {base_table}
+      WHERE dcid IN ({placeholders});
+    )EOF", fmt::arg("base_table", GetBaseTable()), fmt::arg("placeholders", MakePlaceholders(batch_size))));
+    for (std::size_t ix = 0; ix < batch_size; ++ix) {
+      q.bind(static_cast<int>(ix + 1), dcids[batch_start + ix]);
+    }
+    while (q.executeStep()) {
+      std::vector<char> image;
+      if (q.getColumn(1).isNull()) {
+        const auto referenced_image = GetReferencedImage(q.getColumn(2).getInt64(), q.getColumn(3).getInt64());
+        if (!referenced_image.has_value()) {
+          continue;
+        }
+        image.assign(referenced_image->cbegin(), referenced_image->cend());
+      } else {
+        const auto *blob = static_cast<const char *>(q.getColumn(1).getBlob());
+        image.assign(blob, blob + q.getColumn(1).size());
+      }
+      results.emplace(q.getColumn(0).getString(), std::move(image));
+    }
+  }
+  return results;
+}
+
+std::unordered_map<std::string, std::vector<char>> ImageDb::GetThumbnailsForDcids(const std::vector<std::string> &dcids,
+                                                                                  unsigned int size) {
+  std::unordered_map<std::string, std::vector<char>> results;
+  for (std::size_t batch_start = 0; batch_start < dcids.size(); batch_start += kMaxDcidsPerQuery) {
+    const auto batch_size = std::min(kMaxDcidsPerQuery, dcids.size() - batch_start);
+    SQLite::Statement q(*db_, fmt::format(R"EOF(
+      SELECT {base_table}.dcid,
+             {base_table}_thumbnail.thumbnail
+      FROM {base_table}
+               INNER JOIN {base_table}_thumbnail
+                          ON {base_table}.id = {base_table}_thumbnail.image_id
+      WHERE {base_table}_thumbnail.size = ?
+        AND {base_table}.dcid IN ({placeholders});
+    )EOF", fmt::arg("base_table", GetBaseTable()), fmt::arg("placeholders", MakePlaceholders(batch_size))));
+    q.bind(1, size);
+    for (std::size_t ix = 0; ix < batch_size; ++ix) {
+      q.bind(static_cast<int>(ix + 2), dcids[batch_start + ix]);
+    }
+    while (q.executeStep()) {
+      const auto *blob = static_cast<const char *>(q.getColumn(1).getBlob());
+      results.emplace(q.getColumn(0).getString(), std::vector<char>(blob, blob + q.getColumn(1).size()));
+    }
   }
   return results;
 }
 
+std::optional<std::vector<char>> ImageDb::GetThumbnailForId(std::int64_t id, unsigned int size) {
+  SQLite::Statement q(*db_, fmt::format(R"EOF(
+    SELECT thumbnail
+    FROM {base_table}_thumbnail
+    WHERE image_id = :image_id
+      AND size = :size;
+  )EOF", fmt::arg("base_table", GetBaseTable())));
+  q.bind(":image_id", id);
+  q.bind(":size", size);
+  if (!q.executeStep()) {
+    return {};
+  }
+  const auto *blob = static_cast<const char *>(q.getColumn(0).getBlob());
+  return std::vector<char>(blob, blob + q.getColumn(0).size());
+}
+
 std::optional<std::vector<char>> ImageDb::GetImageForDcid(const std::string &dcid) {
   SQLite::Statement q(*db_, fmt::format(R"EOF(
-    SELECT image
+    SELECT image,
+           image_offset,
+           image_size
     FROM {base_table}
     WHERE dcid = :dcid
     LIMIT 1;
   )EOF", fmt::arg("base_table", GetBaseTable())));
   q.bind(":dcid", dcid);
+  return ReadImage(q);
+}
+
+std::optional<std::vector<char>> ImageDb::GetImageForId(std::int64_t id) {
+  SQLite::Statement q(*db_, fmt::format(R"EOF(
+    SELECT image,
+           image_offset,
+           image_size
+    FROM {base_table}
+    WHERE id = :id;
+  )EOF", fmt::arg("base_table", GetBaseTable())));
+  q.bind(":id", id);
+  return ReadImage(q);
+}
+
+std::vector<std::pair<std::string, std::int64_t>> ImageDb::GetDcidIds() {
+  SQLite::Statement q(*db_, fmt::format(R"EOF(
+    SELECT dcid,
+           id
+    FROM {base_table};
+  )EOF", fmt::arg("base_table", GetBaseTable())));
+  std::vector<std::pair<std::string, std::int64_t>> results;
+  while (q.executeStep()) {
+    results.emplace_back(q.getColumn(0).getString(), q.getColumn(1).getInt64());
+  }
+  return results;
+}
+
+std::optional<std::vector<char>> ImageDb::ReadImage(SQLite::Statement &q) {
   q.executeStep();
   if (!q.hasRow()) {
     return {};
   }
+  if (q.getColumn(0).isNull()) {
+    const auto image = GetReferencedImage(q.getColumn(1).getInt64(), q.getColumn(2).getInt64());
+    if (!image.has_value()) {
+      return {};
+    }
+    return std::vector<char>(image->cbegin(), image->cend());
+  }
   const auto image_size = q.getColumn(0).size();
   std::vector<char> result(image_size, 0);
   memcpy(result.data(), q.getColumn(0).getBlob(), result.size());
@@ -359,4 +1078,13 @@ std::optional<std::vector<char>> ImageDb::GetImageForDcid(const std::string &dci
   return result;
 }
 
+std::string ImageDb::MakePlaceholders(std::size_t count) {
+  std::string placeholders;
+  placeholders.reserve(count * 3);
+  for (std::size_t ix = 0; ix < count; ++ix) {
+    placeholders.append(ix == 0 ? "?" : ", ?");
+  }
+  return placeholders;
+}
+
 } // cslibs
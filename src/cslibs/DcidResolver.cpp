@@ -0,0 +1,61 @@
+/**
+ * @file DcidResolver.cpp
+ *
+ * @author dankeenan
+ * @date 5/16/21
+ * @copyright (c) 2021 Dan Keenan
+ */
+
+#include "cslibs/DcidResolver.h"
+#include <limits>
+#include "cslibs/except.h"
+
+namespace cslibs {
+
+DcidResolver::DcidResolver(std::vector<std::shared_ptr<ImageDb>> libraries) : libraries_(std::move(libraries)) {
+  if (libraries_.size() > std::numeric_limits<decltype(Location::library)>::max()) {
+    throw except::DbError("Too many image libraries");
+  }
+  Reload();
+}
+
+void DcidResolver::Reload() {
+  index_.clear();
+  for (std::size_t library = 0; library < libraries_.size(); ++library) {
+    if (!libraries_[library]) {
+      continue;
+    }
+    const auto dcid_ids = libraries_[library]->GetDcidIds();
+    index_.reserve(index_.size() + dcid_ids.size());
+    for (const auto &[dcid, id] : dcid_ids) {
+      // Doesn't replace existing entries, so earlier libraries win.
+      index_.emplace(dcid, Location{static_cast<std::uint8_t>(library), id});
+    }
+  }
+}
+
+std::optional<DcidResolver::Location> DcidResolver::Resolve(const std::string &dcid) const {
+  const auto it = index_.find(dcid);
+  if (it == index_.cend()) {
+    return {};
+  }
+  return it->second;
+}
+
+std::optional<std::vector<char>> DcidResolver::GetImageForDcid(const std::string &dcid) const {
+  const auto location = Resolve(dcid);
+  if (!location.has_value()) {
+    return {};
+  }
+  return libraries_.at(location->library)->GetImageForId(location->id);
+}
+
+std::optional<std::vector<char>> DcidResolver::GetThumbnailForDcid(const std::string &dcid, unsigned int size) const {
+  const auto location = Resolve(dcid);
+  if (!location.has_value()) {
+    return {};
+  }
+  return libraries_.at(location->library)->GetThumbnailForId(location->id, size);
+}
+
+} // cslibs
@@ -8,17 +8,80 @@
 
 #include "cslibs/DefsFile.h"
 #include "cslibs/except.h"
+#include <algorithm>
 #include <regex>
-#include <boost/algorithm/string/split.hpp>
-#include <boost/algorithm/string/classification.hpp>
-#include <boost/algorithm/string/trim.hpp>
-
-using boost::algorithm::split;
-using boost::algorithm::is_any_of;
-using boost::algorithm::trim_right;
 
 namespace cslibs {
 
+namespace {
+
+/**
+ * Equivalent to the regex class `\w` in the "C" locale.
+ */
+bool IsWordChar(char c) {
+  return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+/**
+ * Equivalent to the regex class `\s` in the "C" locale.
+ */
+bool IsSpaceChar(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+/**
+ * Match a record start line (e.g. `$GEL`).
+ *
+ * Equivalent to `^\$(\w+)\s?$`.
+ *
+ * @param line
+ * @return The record name, or none if the line does not start a record.
+ */
+std::optional<std::string_view> MatchRecordName(std::string_view line) {
+  if (line.size() < 2 || line.front() != '$') {
+    return {};
+  }
+  line.remove_prefix(1);
+  if (IsSpaceChar(line.back())) {
+    line.remove_suffix(1);
+  }
+  if (line.empty() || !std::all_of(line.cbegin(), line.cend(), IsWordChar)) {
+    return {};
+  }
+  return line;
+}
+
+/**
+ * Match a record content line (e.g. `$$DCID 6356B5B5-0127-2D47-AC1C-5AD540D7D7D9`).
+ *
+ * Equivalent to `^\$\$(\w+) (.+)\s?$`.
+ *
+ * @param line
+ * @return The key and value, or none if the line is not record content.
+ */
+std::optional<std::pair<std::string_view, std::string_view>> MatchRecordContent(std::string_view line) {
+  if (line.size() < 2 || line[0] != '$' || line[1] != '$') {
+    return {};
+  }
+  line.remove_prefix(2);
+  const auto key_size = static_cast<std::string_view::size_type>(
+      std::find_if_not(line.cbegin(), line.cend(), IsWordChar) - line.cbegin());
+  if (key_size == 0 || key_size == line.size() || line[key_size] != ' ') {
+    return {};
+  }
+  std::string_view value = line.substr(key_size + 1);
+  // The value can't contain line terminators, except for a single trailing one that isn't part of the value.
+  if (!value.empty() && value.back() == '\r') {
+    value.remove_suffix(1);
+  }
+  if (value.empty() || value.find('\r') != std::string_view::npos) {
+    return {};
+  }
+  return std::make_pair(line.substr(0, key_size), value);
+}
+
+} // namespace
+
 bool DefsFile::Version::operator==(const DefsFile::Version &rhs) const {
   return major == rhs.major &&
       minor == rhs.minor &&
@@ -53,77 +116,124 @@ bool DefsFile::Version::operator>=(const DefsFile::Version &rhs) const {
   return !(*this < rhs);
 }
 
-DefsFile::DefsFile(const std::string &file_path) : file_stream_(file_path, std::ifstream::in | std::ifstream::binary) {
-  // Validate
-  if (!file_stream_.is_open() || file_stream_.fail()) {
+DefsFile::DefsFile(const std::string &file_path) : file_(file_path, true) {
+  const Header header = ScanHeader(file_.GetData());
+  if (!header.IsValid()) {
+    throw except::DefsError("File is not valid");
+  }
+  version_ = header.version;
+}
+
+DefsFile::Header DefsFile::ProbeHeader(const std::string &file_path) {
+  std::ifstream file(file_path, std::ifstream::in | std::ifstream::binary);
+  if (!file.is_open() || file.fail()) {
     throw except::DefsError("Could not open file");
   }
-  // Never skip whitespace
-  file_stream_.unsetf(std::ifstream::skipws);
-  std::string line;
-  bool valid = false;
-  while (std::getline(file_stream_, line)) {
-    if (line.substr(0, 6) != "IDENT ") {
-      continue;
+  std::string data(kHeaderProbeSize, '\0');
+  file.read(data.data(), static_cast<std::streamsize>(data.size()));
+  data.resize(file.gcount());
+  if (data.size() == kHeaderProbeSize) {
+    // Don't match against a line that was cut off.
+    const auto last_line_end = data.rfind('\n');
+    data.resize(last_line_end == std::string::npos ? 0 : last_line_end + 1);
+  }
+  return ScanHeader(data);
+}
+
+DefsFile::Header DefsFile::ScanHeader(std::string_view data) {
+  static const std::regex version_re(R"(^\$CARALLONVERSION (\d+).(\d+).(\d+)\s?$)", std::regex::ECMAScript);
+
+  Header header;
+  bool found_ident = false;
+  bool found_version = false;
+  std::string_view::size_type position = 0;
+  while (position < data.size() && !(found_ident && found_version)) {
+    auto line_end = data.find('\n', position);
+    if (line_end == std::string_view::npos) {
+      line_end = data.size();
+    }
+    const std::string_view line = data.substr(position, line_end - position);
+    position = line_end + 1;
+
+    if (!found_ident && line.substr(0, 6) == "IDENT ") {
+      header.ident = line.substr(6, 3);
+      found_ident = true;
+    } else if (!found_version && line.substr(0, 17) == "$CARALLONVERSION ") {
+      std::cmatch version_match;
+      if (!std::regex_match(line.data(), line.data() + line.size(), version_match, version_re)) {
+        throw except::DefsError("Version is malformed");
+      }
+      header.version.major = std::stoul(version_match[1]);
+      header.version.minor = std::stoul(version_match[2]);
+      header.version.patch = std::stoul(version_match[3]);
+      found_version = true;
     }
-    valid = line.substr(6, 3) == kIdent;
-    break;
   }
-  if (!valid) {
-    throw except::DefsError("File is not valid");
+
+  return header;
+}
+
+DefsFile::Def::Def(const DefsFile::DefView &view) : record_name(view.record_name) {
+  for (const auto &[key, value] : view.contents) {
+    contents.emplace(key, value);
   }
-  file_stream_.seekg(0);
+}
 
-  // Load version
-  while (std::getline(file_stream_, line)) {
-    if (line.substr(0, 17) != "$CARALLONVERSION ") {
-      continue;
-    }
-    const std::regex version_re(R"(^\$CARALLONVERSION (\d+).(\d+).(\d+)\s?$)", std::regex::ECMAScript);
-    std::smatch version_match;
-    if (!std::regex_match(line, version_match, version_re)) {
-      throw except::DefsError("Version is malformed");
+std::optional<std::string_view> DefsFile::DefView::Get(std::string_view key) const {
+  // Records are small enough that a linear search beats hashing.
+  for (const auto &[content_key, content_value] : contents) {
+    if (content_key == key) {
+      return content_value;
     }
-    version_.major = std::stoul(version_match[1]);
-    version_.minor = std::stoul(version_match[2]);
-    version_.patch = std::stoul(version_match[3]);
-    break;
   }
+  return {};
 }
 
 std::optional<DefsFile::Def> DefsFile::GetNextRecord() {
-  std::optional<Def> record;
-  if (!file_stream_) {
-    // Already at EOF, do nothing
+  const auto record_view = GetNextRecordView();
+  if (!record_view.has_value()) {
     return {};
   }
+  return Def(*record_view);
+}
+
+std::optional<DefsFile::DefView> DefsFile::GetNextRecordView() {
+  std::optional<DefView> record;
 
   // Find record start
-  std::string line;
-  static const std::regex record_name_re(R"(^\$(\w+)\s?$)", std::regex::ECMAScript);
-  while (std::getline(file_stream_, line)) {
-    std::smatch record_name_match;
-    if (!std::regex_match(line, record_name_match, record_name_re)) {
-      continue;
+  if (next_record_name_.has_value()) {
+    // The last call stopped at this record's start
+    record.emplace();
+    record->record_name = *next_record_name_;
+    next_record_name_.reset();
+  } else {
+    while (const auto line = GetNextLine()) {
+      if (const auto record_name = MatchRecordName(*line)) {
+        record.emplace();
+        record->record_name = *record_name;
+        break;
+      }
+    }
+    if (!record.has_value()) {
+      // Advanced to EOF without finding a new record
+      return record;
     }
-    record.emplace(record_name_match[1]);
-    break;
-  }
-  if (!record.has_value()) {
-    // Advanced to EOF without finding a new record
-    return record;
   }
 
   // Load contents
-  static const std::regex record_content_re(R"(^\$\$(\w+) (.+)\s?$)", std::regex::ECMAScript);
-  while (std::getline(file_stream_, line)) {
-    std::smatch record_content_match;
-    if (std::regex_match(line, record_content_match, record_content_re)) {
-      record->contents.insert({record_content_match[1], record_content_match[2]});
-    } else if (std::regex_match(line, record_name_re)) {
+  while (const auto line = GetNextLine()) {
+    // Everything interesting starts with "$"; skip comments and blank lines without further inspection.
+    if (line->empty() || line->front() != '$') {
+      continue;
+    }
+    if (line->size() > 1 && (*line)[1] == '$') {
+      if (const auto record_content = MatchRecordContent(*line)) {
+        record->contents.push_back(*record_content);
+      }
+    } else if (const auto record_name = MatchRecordName(*line)) {
       // At next record
-      // Seek stream to beginning of the next record
-      file_stream_.seekg(line.size() * -1 - 1, std::ifstream::cur);
+      // Remember the name so the next call can begin there.
+      next_record_name_ = record_name;
       break;
     }
   }
@@ -131,109 +241,77 @@ std::optional<DefsFile::Def> DefsFile::GetNextRecord() {
   return record;
 }
 
+DefsFile::ValueList DefsFile::SplitValue(std::string_view value) {
+  ValueList parts;
+  std::string_view::size_type start = 0;
+  while (true) {
+    const auto end = value.find(',', start);
+    if (end == std::string_view::npos) {
+      parts.push_back(value.substr(start));
+      break;
+    }
+    parts.push_back(value.substr(start, end - start));
+    start = end + 1;
+  }
+  return parts;
+}
+
+std::optional<std::string_view> DefsFile::GetNextLine() {
+  const std::string_view data = file_.GetData();
+  if (position_ >= data.size()) {
+    return {};
+  }
+  const auto line_end = data.find('\n', position_);
+  std::string_view line;
+  if (line_end == std::string_view::npos) {
+    line = data.substr(position_);
+    position_ = data.size();
+  } else {
+    line = data.substr(position_, line_end - position_);
+    position_ = line_end + 1;
+  }
+  return line;
+}
+
 ImageDefsFile::ImageDefsFile(const std::string &file_path,
                              const std::string &data_index_path,
-                             const std::string &data_path)
+                             const std::string &data_path,
+                             const std::string &data_index_cache_path)
     : DefsFile(file_path),
-      data_index_stream_(data_index_path, std::ifstream::in | std::ifstream::binary),
-      data_stream_(data_path, std::ifstream::in | std::ifstream::binary) {
-  // Validate
-  if (!data_index_stream_.is_open() || data_index_stream_.fail()) {
-    throw except::DefsError("Could not open data index");
-  } else if (!data_stream_.is_open() || data_stream_.fail()) {
+      data_index_(ImageDataIndex::Load(data_index_path, data_index_cache_path)),
+      data_file_(OpenDataFile(data_path)) {
+}
+
+MappedFile ImageDefsFile::OpenDataFile(const std::string &data_path) {
+  try {
+    return MappedFile(data_path);
+  } catch (const except::DefsError &) {
     throw except::DefsError("Could not open data file");
   }
-  // Never skip whitespace
-  data_index_stream_.unsetf(std::ifstream::skipws);
 }
 
-std::optional<std::vector<char>> ImageDefsFile::GetDataForDcid(const std::string &type, const std::string &dcid) {
-  if (type_dcid_offsets_.find(type) == type_dcid_offsets_.end()) {
-    LoadOffsetsForType(type);
-  }
-  DataPosition data_position;
-  try {
-    data_position = type_dcid_offsets_.at(type).at(dcid);
-  } catch (const std::out_of_range &) {
+std::optional<std::string_view> ImageDefsFile::GetDataForDcid(std::string_view type, std::string_view dcid) const {
+  const auto data_position = data_index_->Find(type, dcid);
+  if (!data_position.has_value()) {
     return {};
   }
 
   // Each data chunk has an 80 byte header
-  data_stream_.seekg(data_position.offset + 80);
-  int size = data_position.size - 80;
-  if (size < 0) {
-    // Size is current position until EOF.  Need to get an actual value so buffer can be created correctly.
-    const auto old_pos = data_stream_.tellg();
-    data_stream_.seekg(0, std::ifstream::end);
-    size = static_cast<int>(data_stream_.tellg() - old_pos);
-    data_stream_.seekg(old_pos);
-  }
-  std::vector<char> data(size, 0);
-  data_stream_.read(data.data(), static_cast<long>(data.size()));
-  data.resize(data_stream_.gcount());
-  return data;
-}
-
-void ImageDefsFile::LoadOffsetsForType(const std::string &type) {
-  data_index_stream_.seekg(0);
-  std::string line;
-  auto &dcid_offsets = type_dcid_offsets_[type];
-  dcid_offsets.clear();
-
-  // The size is not set in the line, so need to use the next line.  This complicates things a bit.
-  bool started = false;
-  std::string line_type;
-  std::string dcid;
-  unsigned int offset = 0;
-  std::vector<std::string> parts;
-  while (std::getline(data_index_stream_, line)) {
-    trim_right(line);
-    if (line.empty()) {
-      continue;
-    }
-    split(parts, line, is_any_of(","));
-    if (parts.size() != 4) {
-      throw except::DefsError("Data index is malformed");
-    }
-    if (!started) {
-      // First pass
-      dcid = parts.at(0);
-      offset = std::stoul(parts.at(1));
-      line_type = parts.at(2);
-      started = true;
-    } else {
-      const unsigned int next_offset = std::stoul(parts.at(1));
-      if (line_type == type) {
-        dcid_offsets.insert({dcid, {offset, static_cast<int>(next_offset - offset)}});
-      }
-      line_type = parts.at(2);
-      dcid = parts.at(0);
-      offset = next_offset;
-    }
-  }
-  // Insert the last line, using -1 to mean "until EOF"
-  if (line_type == type) {
-    dcid_offsets.insert({dcid, {offset, -1}});
+  const std::string_view data = data_file_.GetData();
+  const auto start = std::min<std::string_view::size_type>(data_position->offset + 80, data.size());
+  if (data_position->size < 0) {
+    // Until EOF
+    return data.substr(start);
   }
+  return data.substr(start, std::max(data_position->size - 80, 0));
 }
 
-unsigned long DefsFile::GetSize() {
-  if (!size_.has_value()) {
-    const auto old_pos = file_stream_.tellg();
-    file_stream_.seekg(0, std::ifstream::end);
-    size_ = static_cast<unsigned long>(file_stream_.tellg());
-    file_stream_.seekg(old_pos);
-  }
-  return *size_;
+unsigned long DefsFile::GetSize() const {
+  return file_.GetSize();
 }
 
-unsigned long DefsFile::GetPosition() {
-  // End of file means the stream has failed, so position indicators stop working.
-  if (file_stream_.eof()) {
-    return GetSize();
-  } else {
-    return file_stream_.tellg();
-  }
+unsigned long DefsFile::GetPosition() const {
+  return position_;
 }
 
 } // cslibs
@@ -0,0 +1,253 @@
+/**
+ * @file ImageDataIndex.cpp
+ *
+ * @author dankeenan
+ * @date 5/9/21
+ * @copyright (c) 2021 Dan Keenan
+ */
+
+#include "cslibs/ImageDataIndex.h"
+#include "cslibs/DefsFile.h"
+#include "cslibs/except.h"
+#include <fmt/format.h>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <random>
+#include <tuple>
+#include <unordered_map>
+
+namespace cslibs {
+
+namespace {
+
+/**
+ * Create a new file next to @p target that no other writer is using.
+ *
+ * @param temp Set to the path of the created file
+ * @return The file open for writing, or nullptr on failure
+ */
+std::FILE *CreateTempFile(const std::filesystem::path &target, std::filesystem::path &temp) {
+  std::random_device random;
+  for (unsigned int attempt = 0; attempt < 16; ++attempt) {
+    temp = target;
+    temp += fmt::format(".{:08x}.tmp", random());
+    // "x" fails instead of opening a file that already exists
+    std::FILE *file = std::fopen(temp.string().c_str(), "wbx");
+    if (file != nullptr || errno != EEXIST) {
+      return file;
+    }
+  }
+  return nullptr;
+}
+
+/**
+ * Replace the file at @p path with @p contents, so readers see either the old file or the new one.
+ *
+ * @return FALSE on failure; the old file is left in place.
+ */
+bool ReplaceFile(const std::filesystem::path &path, const std::vector<char> &contents) {
+  std::filesystem::path temp;
+  std::FILE *file = CreateTempFile(path, temp);
+  if (file == nullptr) {
+    return false;
+  }
+  bool ok = std::fwrite(contents.data(), 1, contents.size(), file) == contents.size();
+  ok = std::fclose(file) == 0 && ok;
+  std::error_code ec;
+  if (ok) {
+    std::filesystem::rename(temp, path, ec);
+    ok = !ec;
+  }
+  if (!ok) {
+    std::filesystem::remove(temp, ec);
+  }
+  return ok;
+}
+
+} // namespace
+
+std::shared_ptr<const ImageDataIndex> ImageDataIndex::Load(const std::string &data_index_path,
+                                                           const std::string &cache_path) {
+  struct CacheEntry {
+    Source source;
+    std::shared_ptr<const ImageDataIndex> index;
+  };
+  static std::mutex cache_mutex;
+  static std::unordered_map<std::string, CacheEntry> cache;
+
+  Source source{};
+  try {
+    source.size = std::filesystem::file_size(data_index_path);
+    source.modified = std::filesystem::last_write_time(data_index_path).time_since_epoch().count();
+  } catch (const std::filesystem::filesystem_error &) {
+    throw except::DefsError("Could not open data index");
+  }
+
+  std::lock_guard lock(cache_mutex);
+  const auto cached = cache.find(data_index_path);
+  if (cached != cache.end() && cached->second.source == source) {
+    return cached->second.index;
+  }
+
+  std::shared_ptr<ImageDataIndex> index(new ImageDataIndex);
+  bool loaded = false;
+  if (!cache_path.empty() && std::filesystem::exists(cache_path)) {
+    try {
+      index->mapped_.emplace(cache_path);
+      loaded = index->SetData(index->mapped_->GetData(), source);
+    } catch (const except::DefsError &) {
+      // Rebuild below
+    }
+    if (!loaded) {
+      index->mapped_.reset();
+    }
+  }
+  if (!loaded) {
+    index->buffer_ = Build(data_index_path, source);
+    index->SetData({index->buffer_.data(), index->buffer_.size()}, source);
+    if (!cache_path.empty()) {
+      // Failing to write the cache only means it will be built again next time.
+      ReplaceFile(cache_path, index->buffer_);
+    }
+  }
+
+  cache[data_index_path] = {source, index};
+  return index;
+}
+
+std::optional<ImageDataIndex::Position> ImageDataIndex::Find(std::string_view type, std::string_view dcid) const {
+  // Binary search for the first entry not less than (type, dcid)
+  std::uint32_t first = 0;
+  std::uint32_t count = entry_count_;
+  while (count > 0) {
+    const std::uint32_t step = count / 2;
+    const Entry entry = GetEntry(first + step);
+    const auto entry_key = std::make_pair(GetString(entry.type_offset, entry.type_size),
+                                          GetString(entry.dcid_offset, entry.dcid_size));
+    if (entry_key < std::make_pair(type, dcid)) {
+      first += step + 1;
+      count -= step + 1;
+    } else {
+      count = step;
+    }
+  }
+  if (first == entry_count_) {
+    return {};
+  }
+  const Entry entry = GetEntry(first);
+  if (GetString(entry.type_offset, entry.type_size) != type || GetString(entry.dcid_offset, entry.dcid_size) != dcid) {
+    return {};
+  }
+  return Position{entry.offset, entry.size};
+}
+
+std::vector<char> ImageDataIndex::Build(const std::string &data_index_path, const Source &source) {
+  std::optional<MappedFile> file;
+  try {
+    file.emplace(data_index_path, true);
+  } catch (const except::DefsError &) {
+    throw except::DefsError("Could not open data index");
+  }
+  const std::string_view data = file->GetData();
+
+  // type, dcid, offset, size
+  std::vector<std::tuple<std::string_view, std::string_view, std::uint32_t, std::int32_t>> items;
+  // The size is not set in the line, so need to use the next line.  This complicates things a bit.
+  std::string_view::size_type line_start = 0;
+  while (line_start < data.size()) {
+    auto line_end = data.find('\n', line_start);
+    if (line_end == std::string_view::npos) {
+      line_end = data.size();
+    }
+    std::string_view line = data.substr(line_start, line_end - line_start);
+    line_start = line_end + 1;
+    while (!line.empty() && std::isspace(static_cast<unsigned char>(line.back()))) {
+      line.remove_suffix(1);
+    }
+    if (line.empty()) {
+      continue;
+    }
+    const auto parts = DefsFile::SplitValue(line);
+    if (parts.size() != 4 || parts.at(0).size() > UINT16_MAX || parts.at(2).size() > UINT16_MAX) {
+      throw except::DefsError("Data index is malformed");
+    }
+    const std::uint32_t offset = std::stoul(std::string(parts.at(1)));
+    if (!items.empty()) {
+      auto &previous = items.back();
+      std::get<3>(previous) = static_cast<std::int32_t>(offset - std::get<2>(previous));
+    }
+    // Using -1 to mean "until EOF" until the next line is read
+    items.emplace_back(parts.at(2), parts.at(0), offset, -1);
+  }
+  // Stable so that the first of any duplicate dcids is found, as before.
+  std::stable_sort(items.begin(), items.end(), [](const auto &a, const auto &b) {
+    return std::tie(std::get<0>(a), std::get<1>(a)) < std::tie(std::get<0>(b), std::get<1>(b));
+  });
+
+  // Lay out the strings, storing each type once
+  std::string strings;
+  std::vector<Entry> entries;
+  entries.reserve(items.size());
+  std::string_view last_type;
+  std::uint32_t last_type_offset = 0;
+  for (const auto &[type, dcid, offset, size] : items) {
+    if (entries.empty() || type != last_type) {
+      last_type = type;
+      last_type_offset = strings.size();
+      strings.append(type);
+    }
+    Entry entry{};
+    entry.type_offset = last_type_offset;
+    entry.type_size = type.size();
+    entry.dcid_offset = strings.size();
+    entry.dcid_size = dcid.size();
+    entry.offset = offset;
+    entry.size = size;
+    strings.append(dcid);
+    entries.push_back(entry);
+  }
+
+  Header header{};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.format_version = kFormatVersion;
+  header.entry_count = entries.size();
+  header.strings_size = strings.size();
+  header.source = source;
+  std::vector<char> buffer(sizeof(Header) + sizeof(Entry) * entries.size() + strings.size());
+  std::memcpy(buffer.data(), &header, sizeof(Header));
+  std::memcpy(buffer.data() + sizeof(Header), entries.data(), sizeof(Entry) * entries.size());
+  std::memcpy(buffer.data() + sizeof(Header) + sizeof(Entry) * entries.size(), strings.data(), strings.size());
+  return buffer;
+}
+
+bool ImageDataIndex::SetData(std::string_view data, const Source &source) {
+  if (data.size() < sizeof(Header)) {
+    return false;
+  }
+  Header header{};
+  std::memcpy(&header, data.data(), sizeof(Header));
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0
+      || header.format_version != kFormatVersion
+      || !(header.source == source)
+      // A cache file that was cut short still has a valid header.
+      || data.size() != sizeof(Header) + sizeof(Entry) * std::uint64_t{header.entry_count} + header.strings_size) {
+    return false;
+  }
+  data_ = data;
+  entry_count_ = header.entry_count;
+  strings_ = data.substr(sizeof(Header) + sizeof(Entry) * entry_count_);
+  return true;
+}
+
+ImageDataIndex::Entry ImageDataIndex::GetEntry(std::uint32_t index) const {
+  Entry entry{};
+  std::memcpy(&entry, data_.data() + sizeof(Header) + sizeof(Entry) * index, sizeof(Entry));
+  return entry;
+}
+
+} // cslibs
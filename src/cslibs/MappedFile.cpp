@@ -0,0 +1,38 @@
+/**
+ * @file MappedFile.cpp
+ *
+ * @author dankeenan
+ * @date 5/8/21
+ * @copyright (c) 2021 Dan Keenan
+ */
+
+#include "cslibs/MappedFile.h"
+#include "cslibs/except.h"
+#include <boost/interprocess/exceptions.hpp>
+#include <filesystem>
+
+using boost::interprocess::file_mapping;
+using boost::interprocess::mapped_region;
+using boost::interprocess::read_only;
+using boost::interprocess::interprocess_exception;
+
+namespace cslibs {
+
+MappedFile::MappedFile(const std::string &file_path, bool sequential) {
+  try {
+    file_mapping_ = file_mapping(file_path.c_str(), read_only);
+    // Zero-length regions can't be mapped; leave the region empty instead.
+    if (std::filesystem::file_size(file_path) > 0) {
+      region_ = mapped_region(file_mapping_, read_only);
+      if (sequential) {
+        region_.advise(mapped_region::advice_sequential);
+      }
+    }
+  } catch (const interprocess_exception &) {
+    throw except::DefsError("Could not open file");
+  } catch (const std::filesystem::filesystem_error &) {
+    throw except::DefsError("Could not open file");
+  }
+}
+
+} // cslibs
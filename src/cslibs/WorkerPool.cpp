@@ -0,0 +1,53 @@
+/**
+ * @file WorkerPool.cpp
+ *
+ * @author dankeenan
+ * @date 5/9/21
+ * @copyright (c) 2021 Dan Keenan
+ */
+
+#include "cslibs/WorkerPool.h"
+#include <algorithm>
+
+namespace cslibs {
+
+WorkerPool::WorkerPool(unsigned int thread_count) {
+  if (thread_count == 0) {
+    // hardware_concurrency() may return 0 when it can't tell.
+    thread_count = std::max(1u, std::thread::hardware_concurrency());
+  }
+  threads_.reserve(thread_count);
+  for (unsigned int i = 0; i < thread_count; ++i) {
+    threads_.emplace_back(&WorkerPool::Work, this);
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard lock(mutex_);
+    stopping_ = true;
+  }
+  task_available_.notify_all();
+  for (auto &thread : threads_) {
+    thread.join();
+  }
+}
+
+void WorkerPool::Work() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock lock(mutex_);
+      task_available_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+      if (tasks_.empty()) {
+        // Stopping and nothing left to do
+        return;
+      }
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    task();
+  }
+}
+
+} // cslibs
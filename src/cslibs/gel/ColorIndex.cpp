@@ -0,0 +1,136 @@
+/**
+ * @file ColorIndex.cpp
+ *
+ * @author dankeenan
+ * @date 5/16/21
+ * @copyright (c) 2021 Dan Keenan
+ */
+
+#include "cslibs/gel/ColorIndex.h"
+#include <algorithm>
+#include <cmath>
+
+namespace cslibs::gel {
+
+namespace {
+
+float DistanceSquared(const ColorIndex::Point &a, const ColorIndex::Point &b) {
+  float distance = 0;
+  for (std::size_t axis = 0; axis < a.size(); ++axis) {
+    const float delta = a[axis] - b[axis];
+    distance += delta * delta;
+  }
+  return distance;
+}
+
+} // namespace
+
+ColorIndex::ColorIndex(const std::vector<Point> &points) {
+  nodes_.reserve(points.size());
+  for (std::size_t index = 0; index < points.size(); ++index) {
+    nodes_.push_back({points[index], index});
+  }
+  Build(0, nodes_.size(), 0);
+}
+
+void ColorIndex::Build(std::size_t begin, std::size_t end, unsigned int depth) {
+  if (end - begin <= 1) {
+    return;
+  }
+  const std::size_t middle = begin + (end - begin) / 2;
+  const unsigned int axis = depth % 3;
+  std::nth_element(nodes_.begin() + begin, nodes_.begin() + middle, nodes_.begin() + end,
+                   [axis](const Node &a, const Node &b) { return a.point[axis] < b.point[axis]; });
+  Build(begin, middle, depth + 1);
+  Build(middle + 1, end, depth + 1);
+}
+
+std::vector<ColorIndex::Match> ColorIndex::FindNearest(const Point &point, std::size_t count) const {
+  // Max-heap of (squared distance, node) holding the best matches found so far
+  std::vector<std::pair<float, std::size_t>> heap;
+  if (count > 0) {
+    heap.reserve(count + 1);
+    Search(0, nodes_.size(), 0, point, count, heap);
+  }
+  std::sort_heap(heap.begin(), heap.end());
+
+  std::vector<Match> results;
+  results.reserve(heap.size());
+  for (const auto &[distance_squared, node] : heap) {
+    results.push_back({nodes_[node].index, std::sqrt(distance_squared)});
+  }
+  return results;
+}
+
+void ColorIndex::Search(std::size_t begin,
+                        std::size_t end,
+                        unsigned int depth,
+                        const Point &point,
+                        std::size_t count,
+                        std::vector<std::pair<float, std::size_t>> &heap) const {
+  if (begin >= end) {
+    return;
+  }
+  const std::size_t middle = begin + (end - begin) / 2;
+  const Node &node = nodes_[middle];
+
+  const float distance_squared = DistanceSquared(point, node.point);
+  if (heap.size() < count || distance_squared < heap.front().first) {
+    heap.emplace_back(distance_squared, middle);
+    std::push_heap(heap.begin(), heap.end());
+    if (heap.size() > count) {
+      std::pop_heap(heap.begin(), heap.end());
+      heap.pop_back();
+    }
+  }
+
+  // Search the side of the split containing the point first, then the other side only if it could be closer.
+  const unsigned int axis = depth % 3;
+  const float split_distance = point[axis] - node.point[axis];
+  const bool point_is_lower = split_distance < 0;
+  if (point_is_lower) {
+    Search(begin, middle, depth + 1, point, count, heap);
+  } else {
+    Search(middle + 1, end, depth + 1, point, count, heap);
+  }
+  if (heap.size() < count || split_distance * split_distance < heap.front().first) {
+    if (point_is_lower) {
+      Search(middle + 1, end, depth + 1, point, count, heap);
+    } else {
+      Search(begin, middle, depth + 1, point, count, heap);
+    }
+  }
+}
+
+ColorIndex::Point ColorIndex::RgbToLab(std::uint8_t red, std::uint8_t green, std::uint8_t blue) {
+  // sRGB companding
+  const auto linearize = [](std::uint8_t value) {
+    const double v = value / 255.0;
+    return v <= 0.04045 ? v / 12.92 : std::pow((v + 0.055) / 1.055, 2.4);
+  };
+  const double r = linearize(red);
+  const double g = linearize(green);
+  const double b = linearize(blue);
+
+  // Linear sRGB -> XYZ, normalized to the D65 white point
+  const double x = (0.4124564 * r + 0.3575761 * g + 0.1804375 * b) / 0.95047;
+  const double y = (0.2126729 * r + 0.7151522 * g + 0.0721750 * b) / 1.00000;
+  const double z = (0.0193339 * r + 0.1191920 * g + 0.9503041 * b) / 1.08883;
+
+  // XYZ -> Lab
+  const auto f = [](double t) {
+    constexpr double kEpsilon = 216.0 / 24389.0;
+    constexpr double kKappa = 24389.0 / 27.0;
+    return t > kEpsilon ? std::cbrt(t) : (kKappa * t + 16.0) / 116.0;
+  };
+  const double fx = f(x);
+  const double fy = f(y);
+  const double fz = f(z);
+  return {
+      static_cast<float>(116.0 * fy - 16.0),
+      static_cast<float>(500.0 * (fx - fy)),
+      static_cast<float>(200.0 * (fy - fz)),
+  };
+}
+
+} // cslibs::gel
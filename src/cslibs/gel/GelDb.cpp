@@ -7,18 +7,12 @@
  */
 
 #include "cslibs/DefsFile.h"
+#include "cslibs/ImportPipeline.h"
 #include "cslibs/gel/GelDb.h"
 #include <SQLiteCpp/Statement.h>
-#include <boost/algorithm/string/split.hpp>
-#include <boost/algorithm/string/classification.hpp>
-#include <boost/algorithm/string/predicate.hpp>
 #include <fmt/format.h>
 #include "cslibs/except.h"
 
-using boost::algorithm::split;
-using boost::algorithm::is_any_of;
-using boost::algorithm::ilexicographical_compare;
-
 namespace cslibs::gel {
 
 void GelDb::CreateTables() {
@@ -48,18 +42,106 @@ void GelDb::CreateTables() {
     CREATE INDEX IF NOT EXISTS gel_red_green_blue_index
         ON gel (red, green, blue);
 
-    CREATE INDEX IF NOT EXISTS gel_series_id_code_index
-        ON gel (series_id, code);
-
     CREATE INDEX IF NOT EXISTS gel_series_id_index
         ON gel (series_id);
   )EOF");
+  CreateSortIndexes();
+}
+
+void GelDb::CreateSortIndexes() {
+  // Allow GetGelForSeries() to read rows in order
+  db_->exec(fmt::format(R"EOF(
+    CREATE INDEX IF NOT EXISTS gel_series_id_code_index
+        ON gel (series_id, code COLLATE {collation});
+
+    CREATE INDEX IF NOT EXISTS gel_series_id_name_index
+        ON gel (series_id, name COLLATE {collation});
+
+    CREATE INDEX IF NOT EXISTS gel_series_id_red_green_blue_index
+        ON gel (series_id, red, green, blue);
+  )EOF", fmt::arg("collation", kCollation)));
+}
+
+std::vector<Db::Migration> GelDb::GetMigrations() {
+  return {
+      // 1: Case-insensitive sort indexes
+      [this]() {
+        db_->exec("DROP INDEX IF EXISTS gel_series_id_code_index;");
+        CreateSortIndexes();
+      },
+  };
 }
 
 void GelDb::ClearRecords() {
   db_->exec("DELETE FROM gel;");
+  all_gels_.clear();
+  rgb_index_.reset();
+  lab_index_.reset();
 }
 
+namespace {
+
+/**
+ * Gel record, ready to insert
+ */
+struct GelRow {
+  std::string dcid;
+  std::string manufacturer_name;
+  std::string series_name;
+  std::string code;
+  std::string name;
+  uint8_t red;
+  uint8_t green;
+  uint8_t blue;
+};
+
+/**
+ * Parse a gel record.
+ *
+ * @param record
+ * @return The gel, or none if the gel should not be added.
+ * @throws except::DefsError When the record is malformed.
+ */
+std::optional<GelRow> ParseGel(const DefsFile::DefView &record) {
+  const auto dcid = record.Get("DCID");
+  if (!dcid.has_value()) {
+    throw except::DefsError("Missing DCID");
+  }
+  const auto manufacturer_info = record.Get("GELMANUFACTURER");
+  if (!manufacturer_info.has_value()) {
+    throw except::DefsError(fmt::format("{} Missing GELMANUFACTURER", *dcid));
+  }
+  const auto series_info = DefsFile::SplitValue(*manufacturer_info);
+  if (series_info.size() != 2) {
+    throw except::DefsError(fmt::format("{} GELMANUFACTURER is malformed: \"{}\"", *dcid, *manufacturer_info));
+  }
+  const auto info = record.Get("GELINFO");
+  if (!info.has_value()) {
+    throw except::DefsError(fmt::format("{} Missing GELINFO", *dcid));
+  }
+  const auto gel_info = DefsFile::SplitValue(*info);
+  if (gel_info.size() == 2) {
+    // No swatch, not worth adding
+    return {};
+  } else if (gel_info.size() < 5) {
+    throw except::DefsError(fmt::format("{} GELINFO is malformed: \"{}\"", *dcid, *info));
+  }
+
+  GelRow row;
+  row.dcid = *dcid;
+  row.manufacturer_name = series_info.at(0);
+  row.series_name = series_info.at(1);
+  row.code = gel_info.at(0);
+  // Accommodate commas in the name: The color values are always the last three values in the info string.
+  row.name = fmt::format("{}", fmt::join(gel_info.cbegin() + 1, gel_info.cbegin() + (gel_info.size() - 3), ","));
+  row.red = std::stoul(std::string(gel_info.at(gel_info.size() - 3)));
+  row.green = std::stoul(std::string(gel_info.at(gel_info.size() - 2)));
+  row.blue = std::stoul(std::string(gel_info.at(gel_info.size() - 1)));
+  return row;
+}
+
+} // namespace
+
 void GelDb::LoadFromDefsFile(const ProgressCallback &progress_callback) {
   DefsFile defs_file(defs_file_path_);
 
@@ -71,92 +153,37 @@ void GelDb::LoadFromDefsFile(const ProgressCallback &progress_callback) {
     VALUES (:dcid, :series_id, :code, :name, :red, :green, :blue);
   )EOF");
 
-  while (auto record = defs_file.GetNextRecord()) {
-    if (record->record_name != "GEL") {
-      continue;
-    }
-
-    // Extract data from record
-    std::string dcid;
-    try {
-      dcid = record->contents.at("DCID");
-    } catch (const std::out_of_range &) {
-      throw except::DefsError("Missing DCID");
-    }
-    std::vector<std::string> series_info;
-    try {
-      split(series_info, record->contents.at("GELMANUFACTURER"), is_any_of(","));
-    } catch (const std::out_of_range &) {
-      throw except::DefsError(fmt::format("{} Missing GELMANUFACTURER", dcid));
-    }
-    if (series_info.size() != 2) {
-      throw except::DefsError(fmt::format("{} GELMANUFACTURER is malformed: \"{}\"",
-                                          dcid,
-                                          record->contents.at("GELMANUFACTURER")));
-    }
-    const std::string manufacturer_name = series_info.at(0);
-    const std::string series_name = series_info.at(1);
-    std::vector<std::string> gel_info;
-    try {
-      split(gel_info, record->contents.at("GELINFO"), is_any_of(","));
-    } catch (const std::out_of_range &) {
-      throw except::DefsError(fmt::format("{} Missing GELINFO", dcid));
-    }
-    if (gel_info.size() == 2) {
-      // No swatch, not worth adding
-      continue;
-    } else if (gel_info.size() < 5) {
-      throw except::DefsError(fmt::format("{} GELINFO is malformed: \"{}\"",
-                                          dcid,
-                                          record->contents.at("GELINFO")));
-    }
-    const std::string code = gel_info.at(0);
-    // Accommodate commas in the name: The color values are always the last three values in the info string.
-    const std::string name =
-        fmt::format("{}", fmt::join(gel_info.cbegin() + 1, gel_info.cbegin() + (gel_info.size() - 3), ","));
-    const uint8_t red = std::stoul(gel_info.at(gel_info.size() - 3));
-    const uint8_t green = std::stoul(gel_info.at(gel_info.size() - 2));
-    const uint8_t blue = std::stoul(gel_info.at(gel_info.size() - 1));
-
+  ImportPipeline<GelRow> pipeline("GEL", &ParseGel, [&](GelRow &row) {
     // Get foreign keys
-    const unsigned int manufacturer_id = GetManufacturerIdForName(manufacturer_name, manufacturer_ids);
-    const unsigned int series_id = GetSeriesIdForName(series_name, manufacturer_id, series_ids);
+    const unsigned int manufacturer_id = GetManufacturerIdForName(row.manufacturer_name, manufacturer_ids);
+    const unsigned int series_id = GetSeriesIdForName(row.series_name, manufacturer_id, series_ids);
 
     // Add gel
     try {
       gel_insert_q.reset();
-      gel_insert_q.bind(":dcid", dcid);
+      gel_insert_q.bind(":dcid", row.dcid);
       gel_insert_q.bind(":series_id", series_id);
-      gel_insert_q.bind(":code", code);
-      gel_insert_q.bind(":name", name);
-      gel_insert_q.bind(":red", red);
-      gel_insert_q.bind(":green", green);
-      gel_insert_q.bind(":blue", blue);
+      gel_insert_q.bind(":code", row.code);
+      gel_insert_q.bind(":name", row.name);
+      gel_insert_q.bind(":red", row.red);
+      gel_insert_q.bind(":green", row.green);
+      gel_insert_q.bind(":blue", row.blue);
       gel_insert_q.exec();
     } catch (const SQLite::Exception &e) {
-      throw except::DbError(fmt::format("{} Error adding gel: {}", dcid, e.what()));
+      throw except::DbError(fmt::format("{} Error adding gel: {}", row.dcid, e.what()));
     }
-    if (progress_callback) {
-      progress_callback(defs_file.GetPosition(), defs_file.GetSize());
-    }
-  }
+  });
+  pipeline.Run(defs_file, progress_callback);
 
   SetUserVersion(defs_file.GetVersion());
 }
 
 std::vector<Gel> GelDb::GetGelForSeries(const Series &series, Sort sort_by) {
   std::string order_by;
-  std::function<bool(const Gel &, const Gel &)> comp;
   switch (sort_by) {
-    case Sort::kName:order_by = "name ASC";
-      comp = [](const Gel &a, const Gel &b) {
-        return ilexicographical_compare(a.GetName(), b.GetName());
-      };
+    case Sort::kName:order_by = fmt::format("name COLLATE {} ASC", kCollation);
       break;
-    case Sort::kCode:order_by = "code ASC";
-      comp = [](const Gel &a, const Gel &b) {
-        return ilexicographical_compare(a.GetCode(), b.GetCode());
-      };
+    case Sort::kCode:order_by = fmt::format("code COLLATE {} ASC", kCollation);
       break;
     case Sort::kColor:order_by = "red ASC, green ASC, blue ASC";
       break;
@@ -176,25 +203,97 @@ std::vector<Gel> GelDb::GetGelForSeries(const Series &series, Sort sort_by) {
   q.bind(":series_id", series.GetId());
   std::vector<Gel> results;
   while (q.executeStep()) {
-    const uint8_t red = q.getColumn("red").getUInt();
-    const uint8_t green = q.getColumn("green").getUInt();
-    const uint8_t blue = q.getColumn("blue").getUInt();
-    const uint32_t argb =
-        (0xFF << 24) // Alpha
-            | (red << 16)
-            | (green << 8)
-            | (blue << 0);
-    results.emplace_back(
-        q.getColumn("dcid").getString(),
-        q.getColumn("code").getString(),
-        q.getColumn("name").getString(),
-        argb
-    );
+    results.push_back(ReadGel(q));
+  }
+  return results;
+}
+
+std::vector<GelDb::Match> GelDb::FindNearest(std::uint32_t rgb, std::size_t count, Metric metric) {
+  // Another connection may have imported the gels again since the indexes were loaded.
+  if (!rgb_index_ || !lab_index_ || GetDataVersion() != color_index_data_version_) {
+    LoadColorIndexes();
   }
-  if (comp) {
-    std::sort(results.begin(), results.end(), comp);
+
+  const std::uint8_t red = (rgb >> 16) & 0xFF;
+  const std::uint8_t green = (rgb >> 8) & 0xFF;
+  const std::uint8_t blue = (rgb >> 0) & 0xFF;
+  std::vector<ColorIndex::Match> matches;
+  switch (metric) {
+    case Metric::kRgb:matches = rgb_index_->FindNearest(ColorIndex::RgbToPoint(red, green, blue), count);
+      break;
+    case Metric::kDeltaE:matches = lab_index_->FindNearest(ColorIndex::RgbToLab(red, green, blue), count);
+      break;
+  }
+
+  std::vector<Match> results;
+  results.reserve(matches.size());
+  for (const auto &match : matches) {
+    results.push_back({all_gels_.at(match.index), match.distance});
   }
   return results;
 }
 
+std::optional<Gel> GelDb::GetGelForId(std::int64_t id) {
+  SQLite::Statement q(*db_, R"EOF(
+    SELECT dcid,
+           code,
+           name,
+           red,
+           green,
+           blue
+    FROM gel
+    WHERE id = :id;
+  )EOF");
+  q.bind(":id", id);
+  if (!q.executeStep()) {
+    return {};
+  }
+  return ReadGel(q);
+}
+
+void GelDb::LoadColorIndexes() {
+  // Read first; a commit made while loading is picked up next time.
+  color_index_data_version_ = GetDataVersion();
+  SQLite::Statement q(*db_, R"EOF(
+    SELECT dcid,
+           code,
+           name,
+           red,
+           green,
+           blue
+    FROM gel
+    ORDER BY id;
+  )EOF");
+  all_gels_.clear();
+  std::vector<ColorIndex::Point> rgb_points;
+  std::vector<ColorIndex::Point> lab_points;
+  while (q.executeStep()) {
+    const std::uint8_t red = q.getColumn("red").getUInt();
+    const std::uint8_t green = q.getColumn("green").getUInt();
+    const std::uint8_t blue = q.getColumn("blue").getUInt();
+    all_gels_.push_back(ReadGel(q));
+    rgb_points.push_back(ColorIndex::RgbToPoint(red, green, blue));
+    lab_points.push_back(ColorIndex::RgbToLab(red, green, blue));
+  }
+  rgb_index_.emplace(rgb_points);
+  lab_index_.emplace(lab_points);
+}
+
+Gel GelDb::ReadGel(const SQLite::Statement &q) {
+  const uint8_t red = q.getColumn("red").getUInt();
+  const uint8_t green = q.getColumn("green").getUInt();
+  const uint8_t blue = q.getColumn("blue").getUInt();
+  const uint32_t argb =
+      (0xFF << 24) // Alpha
+          | (red << 16)
+          | (green << 8)
+          | (blue << 0);
+  return Gel(
+      q.getColumn("dcid").getString(),
+      q.getColumn("code").getString(),
+      q.getColumn("name").getString(),
+      argb
+  );
+}
+
 } // cslibs::gel
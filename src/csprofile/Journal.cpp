@@ -0,0 +1,111 @@
+/**
+ * @file Journal.cpp
+ *
+ * @author dankeenan
+ * @date 5/16/21
+ * @copyright (c) 2021 Dan Keenan
+ */
+
+#include "csprofile/Journal.h"
+#include <fstream>
+#include "csprofile/except.h"
+#include "csprofile/logging.h"
+
+namespace csprofile {
+
+namespace {
+
+Personality PersonalityFromJson(const nlohmann::json &json) {
+  // Keep the DCID, unlike when loading a library file.
+  Personality personality(json.at("dcid").get<std::string>());
+  from_json(json, personality);
+  return personality;
+}
+
+void ApplyChange(const nlohmann::json &change, Library &library) {
+  auto &personalities = library.personalities;
+  const auto op = change.at("op").get<std::string>();
+  const auto row = change.at("row").get<std::size_t>();
+  if (op == "update" && row < personalities.size()) {
+    personalities[row] = PersonalityFromJson(change.at("personality"));
+  } else if (op == "insert" && row <= personalities.size()) {
+    personalities.insert(personalities.cbegin() + row, PersonalityFromJson(change.at("personality")));
+  } else if (op == "remove" && row + change.at("count").get<std::size_t>() <= personalities.size()) {
+    const auto count = change.at("count").get<std::size_t>();
+    personalities.erase(personalities.cbegin() + row, personalities.cbegin() + row + count);
+  } else {
+    logging::error(fmt::format("Journal change doesn't fit the library: {}", change.dump()));
+    throw except::ParseError("Journal change doesn't fit the library");
+  }
+}
+
+} // namespace
+
+Journal::Journal(const std::string &file_path) : file_(std::fopen(file_path.c_str(), "ab")) {
+  if (file_ == nullptr) {
+    throw std::runtime_error("Failed to open journal");
+  }
+  std::fseek(file_, 0, SEEK_END);
+  size_ = std::ftell(file_);
+}
+
+Journal::~Journal() {
+  std::fclose(file_);
+}
+
+void Journal::RecordUpdate(unsigned int row, const Personality &personality) {
+  Append({{"op", "update"}, {"row", row}, {"personality", personality}});
+}
+
+void Journal::RecordInsert(unsigned int row, const Personality &personality) {
+  Append({{"op", "insert"}, {"row", row}, {"personality", personality}});
+}
+
+void Journal::RecordRemove(unsigned int row, unsigned int count) {
+  Append({{"op", "remove"}, {"row", row}, {"count", count}});
+}
+
+void Journal::Append(const nlohmann::json &change) {
+  const std::string line = change.dump() + '\n';
+  // Flush each change so it survives the program crashing.
+  if (std::fwrite(line.data(), 1, line.size(), file_) != line.size() || std::fflush(file_) != 0) {
+    throw std::runtime_error("Failed to write journal");
+  }
+  size_ += static_cast<long>(line.size());
+}
+
+unsigned int Journal::Replay(const std::string &file_path, Library &library) {
+  std::ifstream file(file_path, std::ios::binary);
+  if (!file.is_open() || file.fail()) {
+    throw std::runtime_error("Failed to open journal");
+  }
+
+  unsigned int applied = 0;
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty()) {
+      continue;
+    }
+    const auto change = nlohmann::json::parse(line, nullptr, false);
+    if (change.is_discarded()) {
+      // Every complete change ends with a newline.
+      if (file.eof()) {
+        logging::warn("Ignoring incomplete change at the end of the journal");
+        break;
+      }
+      logging::error("Error parsing journal (invalid JSON)");
+      throw except::ParseError("Error parsing journal");
+    }
+    try {
+      ApplyChange(change, library);
+    } catch (const nlohmann::json::exception &e) {
+      logging::error(fmt::format("Error parsing journal: {}", e.what()));
+      throw except::ParseError("Error parsing journal");
+    }
+    ++applied;
+  }
+
+  return applied;
+}
+
+} // csprofile
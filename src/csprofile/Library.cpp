@@ -7,9 +7,20 @@
  */
 
 #include "csprofile/Library.h"
-#include <nlohmann/json.hpp>
+#include <cerrno>
+#include <cstdio>
+#include <filesystem>
 #include <fstream>
+#include <random>
+#ifdef PLATFORM_WINDOWS
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 #include <fmt/chrono.h>
+#include "csprofile/LibraryReader.h"
+#include "csprofile/LibraryWriter.h"
 #include "csprofile/logging.h"
 #include "csprofile/Personality.h"
 #include "csprofile/except.h"
@@ -17,62 +28,149 @@
 
 namespace csprofile {
 
-Library::Library(const std::string &file_path) {
+Library::Library(const std::string &file_path, const ProgressCallback &progress_callback) {
   logging::info("Opening from {}", file_path);
   std::ifstream file(file_path);
   if (!file.is_open() || file.fail()) {
     throw std::runtime_error("Failed to open file for reading");
   }
-  file >> *this;
+  if (progress_callback) {
+    std::error_code ec;
+    const auto size = std::filesystem::file_size(file_path, ec);
+    personalities = LibraryReader::Read(file, progress_callback, ec ? 0 : size);
+  } else {
+    file >> *this;
+  }
   file.close();
 }
 
-void Library::Save(const std::string &file_path) const {
-  logging::info("Saving to {}", file_path);
-  std::ofstream file(file_path);
-  if (!file.is_open() || file.fail()) {
-    throw std::runtime_error("Failed to open file for writing");
+namespace {
+
+/**
+ * Create a new file next to @p target that no other writer is using.
+ *
+ * @param temp Set to the path of the created file
+ * @return The file open for writing, or nullptr on failure
+ */
+std::FILE *CreateTempFile(const std::filesystem::path &target, std::filesystem::path &temp) {
+  std::random_device random;
+  for (unsigned int attempt = 0; attempt < 16; ++attempt) {
+    temp = target;
+    temp += fmt::format(".{:08x}.tmp", random());
+    // "x" fails instead of opening a file that already exists
+    std::FILE *file = std::fopen(temp.string().c_str(), "wbx");
+    if (file != nullptr || errno != EEXIST) {
+      return file;
+    }
   }
-  file << *this;
-  file.close();
+  return nullptr;
 }
 
-std::istream &operator>>(std::istream &in, csprofile::Library &library) {
-  nlohmann::json json;
-  try {
-    in >> json;
-  } catch (const nlohmann::json::parse_error &e) {
-    csprofile::logging::error(fmt::format("Error parsing file (invalid JSON): {}", e.what()));
-    throw csprofile::except::ParseError("Error parsing file");
-  }
+/**
+ * Write @p contents to @p file and make sure it has reached the disk.  The file is always closed.
+ *
+ * @return FALSE on failure
+ */
+bool WriteAndSync(std::FILE *file, const std::string &contents) {
+  // One large write instead of many small ones
+  bool ok = std::fwrite(contents.data(), 1, contents.size(), file) == contents.size();
+  ok = ok && std::fflush(file) == 0;
+#ifdef PLATFORM_WINDOWS
+  ok = ok && _commit(_fileno(file)) == 0;
+#else
+  ok = ok && fsync(fileno(file)) == 0;
+#endif
+  // Always close, even after a failure
+  ok = std::fclose(file) == 0 && ok;
+  return ok;
+}
 
-  if (!json.contains("personalities")) {
-    csprofile::logging::error("Error parsing file: Missing personalities key");
-    throw csprofile::except::ParseError("Missing personalities key");
+/**
+ * Make sure a rename into @p dir has reached the disk.
+ *
+ * @return FALSE on failure
+ */
+bool SyncDirectory([[maybe_unused]] const std::filesystem::path &dir) {
+#ifdef PLATFORM_WINDOWS
+  // Windows has no way to sync a directory; the rename is journaled by NTFS.
+  return true;
+#else
+  const int fd = open(dir.empty() ? "." : dir.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
   }
+  // Some filesystems can't sync directories; there is nothing more to do on those.
+  const bool ok = fsync(fd) == 0 || errno == EINVAL;
+  close(fd);
+  return ok;
+#endif
+}
 
-  decltype(csprofile::Library::personalities) new_personalities;
-  for (const auto &personality_json : json.at("personalities")) {
-    new_personalities.push_back(personality_json.get<csprofile::Personality>());
+} // namespace
+
+void Library::Save(const std::string &file_path, Format format) const {
+  logging::info("Saving to {}", file_path);
+  LibraryWriter writer(format);
+  Write(writer);
+  const std::string contents = writer.TakeBuffer();
+
+  const std::filesystem::path target(file_path);
+  std::filesystem::path temp;
+  std::FILE *temp_file = CreateTempFile(target, temp);
+  if (temp_file == nullptr) {
+    throw std::runtime_error("Failed to write file");
+  }
+  if (!WriteAndSync(temp_file, contents)) {
+    std::error_code error;
+    std::filesystem::remove(temp, error);
+    throw std::runtime_error("Failed to write file");
   }
-  // This won't happen if inner parse function throw exceptions
-  library.personalities = std::move(new_personalities);
 
-  return in;
+  std::error_code error;
+  // Keep the permissions of the file being replaced
+  const auto target_status = std::filesystem::status(target, error);
+  if (!error && std::filesystem::exists(target_status)) {
+    std::filesystem::permissions(temp, target_status.permissions(), error);
+  }
+  // Replaces the existing file in one step
+  std::filesystem::rename(temp, target, error);
+  if (error) {
+    std::filesystem::remove(temp, error);
+    throw std::runtime_error("Failed to replace file");
+  }
+  // The new contents are on disk, but the directory entry pointing to them may not be yet.  The file has already been
+  // replaced at this point, so this isn't a failure to save.
+  if (!SyncDirectory(target.parent_path())) {
+    logging::warn("Could not sync the directory containing {}", file_path);
+  }
 }
 
-std::ostream &operator<<(std::ostream &out, const Library &library) {
-  nlohmann::json json;
+void Library::Write(std::ostream &out, Library::Format format) const {
+  LibraryWriter writer(out, format);
+  Write(writer);
+  writer.Flush();
+}
 
+void Library::Write(LibraryWriter &writer) const {
   // Always uses UTC time
   // Allow an override here to permit consistent testing
-  json["date"] = fmt::format("{}Z", boost::posix_time::to_iso_extended_string(library.updated_.has_value()
-                                                                              ? library.updated_.value()
-                                                                              : boost::posix_time::second_clock::universal_time()));
-  json["editorVersion"] = csprofileeditor::config::kEtcEditorCompat;
-  json["personalities"] = library.personalities;
+  const std::string date = fmt::format("{}Z", boost::posix_time::to_iso_extended_string(
+      updated_.has_value() ? updated_.value() : boost::posix_time::second_clock::universal_time()));
+  writer.Write(date, csprofileeditor::config::kEtcEditorCompat, personalities);
+}
+
+std::istream &operator>>(std::istream &in, csprofile::Library &library) {
+  // Build personalities while parsing instead of holding the whole document in memory.
+  // This won't replace the existing personalities if the reader throws an exception.
+  library.personalities = LibraryReader::Read(in);
 
-  out << std::setw(4) << json;
+  return in;
+}
+
+std::ostream &operator<<(std::ostream &out, const Library &library) {
+  // Like json, consume the stream's width.
+  out.width(0);
+  library.Write(out);
 
   return out;
 }
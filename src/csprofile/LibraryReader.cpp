@@ -0,0 +1,486 @@
+/**
+ * @file LibraryReader.cpp
+ *
+ * @author dankeenan
+ * @date 5/16/21
+ * @copyright (c) 2021 Dan Keenan
+ */
+
+#include "csprofile/LibraryReader.h"
+#include <algorithm>
+#include <type_traits>
+#include "csprofile/except.h"
+#include "csprofile/logging.h"
+
+namespace csprofile {
+
+namespace {
+
+/**
+ * Convert a value the same way nlohmann::json::get() would.
+ *
+ * @return The converted value, or nothing if the value has the wrong type.
+ */
+template<class T, class Scalar>
+std::optional<T> As(Scalar &&value) {
+  if constexpr (std::is_same_v<T, bool>) {
+    if (const auto *val = std::get_if<bool>(&value)) {
+      return *val;
+    }
+    return {};
+  } else if constexpr (std::is_arithmetic_v<T>) {
+    return std::visit([](const auto &val) -> std::optional<T> {
+      if constexpr (std::is_arithmetic_v<std::decay_t<decltype(val)>>) {
+        return static_cast<T>(val);
+      } else {
+        return {};
+      }
+    }, value);
+  } else {
+    if (auto *val = std::get_if<std::string>(&value)) {
+      return std::move(*val);
+    }
+    return {};
+  }
+}
+
+template<class T, class Scalar>
+void SetField(std::optional<T> &field, Scalar &&value, const std::string &key, void (*fail)(const std::string &)) {
+  field = As<T>(std::forward<Scalar>(value));
+  if (!field.has_value()) {
+    fail(fmt::format("{} has the wrong type", key));
+  }
+}
+
+[[noreturn]] void MissingParameterType() {
+  logging::error("Missing parameter type id");
+  throw except::ParseError("Missing parameter type id");
+}
+
+[[noreturn]] void MissingMediaData() {
+  logging::error("Media has neither gel nor gobo data");
+  throw except::ParseError("Media missing data");
+}
+
+} // namespace
+
+std::vector<Personality> LibraryReader::Read(std::istream &in,
+                                            const Library::ProgressCallback &progress_callback,
+                                            unsigned long total) {
+  LibraryReader reader;
+  if (progress_callback) {
+    reader.in_ = &in;
+    reader.progress_callback_ = &progress_callback;
+    reader.total_ = total;
+  }
+  // Errors are thrown by the reader
+  nlohmann::json::sax_parse(in, &reader);
+  if (!reader.has_personalities_) {
+    logging::error("Error parsing file: Missing personalities key");
+    throw except::ParseError("Missing personalities key");
+  }
+  return std::move(reader.personalities_);
+}
+
+bool LibraryReader::null() {
+  return Value(nullptr);
+}
+
+bool LibraryReader::boolean(bool val) {
+  return Value(val);
+}
+
+bool LibraryReader::number_integer(number_integer_t val) {
+  return Value(val);
+}
+
+bool LibraryReader::number_unsigned(number_unsigned_t val) {
+  return Value(val);
+}
+
+bool LibraryReader::number_float(number_float_t val, const string_t &) {
+  return Value(val);
+}
+
+bool LibraryReader::string(string_t &val) {
+  return Value(std::move(val));
+}
+
+bool LibraryReader::binary(binary_t &) {
+  // Only produced by binary formats
+  return Value(nullptr);
+}
+
+bool LibraryReader::start_object(std::size_t) {
+  return StartContainer(true);
+}
+
+bool LibraryReader::key(string_t &val) {
+  if (contexts_.back() != Context::kSkip) {
+    key_ = std::move(val);
+  }
+  return true;
+}
+
+bool LibraryReader::end_object() {
+  return EndContainer();
+}
+
+bool LibraryReader::start_array(std::size_t) {
+  return StartContainer(false);
+}
+
+bool LibraryReader::end_array() {
+  return EndContainer();
+}
+
+bool LibraryReader::parse_error(std::size_t, const std::string &, const nlohmann::detail::exception &ex) {
+  logging::error(fmt::format("Error parsing file (invalid JSON): {}", ex.what()));
+  throw except::ParseError("Error parsing file");
+}
+
+bool LibraryReader::Value(Scalar &&value) {
+  switch (contexts_.back()) {
+    case Context::kRoot:
+    case Context::kSkip:
+      break;
+    case Context::kLibrary:
+      if (key_ == "personalities") {
+        // Iterating a null json value visits nothing, so it counts as an empty list.
+        if (!std::holds_alternative<std::nullptr_t>(value)) {
+          PersonalityError("Personalities is not a list");
+        }
+        has_personalities_ = true;
+      }
+      break;
+    case Context::kPersonalities:
+      PersonalityError("Personality is not an object");
+    case Context::kPersonality:
+      if (key_ == "manufacturerName" || key_ == "modeName" || key_ == "modelName") {
+        std::optional<std::string> val;
+        SetField(val, std::move(value), key_, &PersonalityError);
+        if (key_ == "manufacturerName") {
+          personality_->personality.SetManufacturerName(val.value());
+          personality_->has_manufacturer_name = true;
+        } else if (key_ == "modeName") {
+          personality_->personality.SetModeName(val.value());
+          personality_->has_mode_name = true;
+        } else {
+          personality_->personality.SetModelName(val.value());
+          personality_->has_model_name = true;
+        }
+      } else if (key_ == "parameters") {
+        if (!std::holds_alternative<std::nullptr_t>(value)) {
+          PersonalityError("Parameters is not a list");
+        }
+        personality_->has_parameters = true;
+      }
+      break;
+    case Context::kParameters:
+      MissingParameterType();
+    case Context::kParameter:
+      if (key_ == "type") {
+        parameter_->type = As<int>(std::move(value));
+        if (!parameter_->type.has_value()) {
+          MissingParameterType();
+        }
+      } else if (key_ == "coarse") {
+        SetField(parameter_->coarse, std::move(value), key_, &ParameterError);
+      } else if (key_ == "fine") {
+        // Only used for 16-bit parameters
+        parameter_->fine = std::move(value);
+      } else if (key_ == "size") {
+        parameter_->size = std::move(value);
+      } else if (key_ == "home") {
+        SetField(parameter_->home, std::move(value), key_, &ParameterError);
+      } else if (key_ == "fadeWithIntensity") {
+        SetField(parameter_->fade_with_intensity, std::move(value), key_, &ParameterError);
+      } else if (key_ == "invert") {
+        SetField(parameter_->invert, std::move(value), key_, &ParameterError);
+      } else if (key_ == "name") {
+        SetField(parameter_->name, std::move(value), key_, &ParameterError);
+      } else if (key_ == "snap") {
+        SetField(parameter_->snap, std::move(value), key_, &ParameterError);
+      } else if (key_ == "ranges" && !std::holds_alternative<std::nullptr_t>(value)) {
+        ParameterError("Ranges is not a list");
+      }
+      break;
+    case Context::kRanges:
+      RangeError("Range is not an object");
+    case Context::kRange:
+      if (key_ == "begin") {
+        SetField(range_->begin, std::move(value), key_, &RangeError);
+      } else if (key_ == "default") {
+        SetField(range_->default_value, std::move(value), key_, &RangeError);
+      } else if (key_ == "end") {
+        SetField(range_->end, std::move(value), key_, &RangeError);
+      } else if (key_ == "label") {
+        SetField(range_->label, std::move(value), key_, &RangeError);
+      } else if (key_ == "media") {
+        MissingMediaData();
+      }
+      break;
+    case Context::kMedia:
+      if (key_ == "r") {
+        media_->r = std::move(value);
+      } else if (key_ == "g") {
+        media_->g = std::move(value);
+      } else if (key_ == "b") {
+        media_->b = std::move(value);
+      } else if (key_ == "dcid") {
+        SetField(media_->dcid, std::move(value), key_, &MediaError);
+      } else if (key_ == "name") {
+        SetField(media_->name, std::move(value), key_, &MediaError);
+      }
+      break;
+  }
+  return true;
+}
+
+bool LibraryReader::StartContainer(bool is_object) {
+  std::optional<Context> next;
+  switch (contexts_.back()) {
+    case Context::kSkip:
+      ++skip_depth_;
+      return true;
+    case Context::kRoot:
+      if (is_object) {
+        next = Context::kLibrary;
+      }
+      break;
+    case Context::kLibrary:
+      if (key_ == "personalities") {
+        if (is_object) {
+          PersonalityError("Personalities is not a list");
+        }
+        has_personalities_ = true;
+        next = Context::kPersonalities;
+      }
+      break;
+    case Context::kPersonalities:
+      if (!is_object) {
+        PersonalityError("Personality is not an object");
+      }
+      personality_.emplace();
+      next = Context::kPersonality;
+      break;
+    case Context::kPersonality:
+      if (key_ == "parameters") {
+        if (is_object) {
+          PersonalityError("Parameters is not a list");
+        }
+        personality_->has_parameters = true;
+        next = Context::kParameters;
+      } else if (key_ == "manufacturerName" || key_ == "modeName" || key_ == "modelName") {
+        PersonalityError(fmt::format("{} has the wrong type", key_));
+      }
+      break;
+    case Context::kParameters:
+      if (!is_object) {
+        MissingParameterType();
+      }
+      parameter_.emplace();
+      next = Context::kParameter;
+      break;
+    case Context::kParameter:
+      if (key_ == "ranges") {
+        if (is_object) {
+          ParameterError("Ranges is not a list");
+        }
+        next = Context::kRanges;
+      } else if (key_ == "type") {
+        MissingParameterType();
+      } else if (key_ == "fine") {
+        // Not an error unless used, so treat it like any other value of the wrong type
+        parameter_->fine = nullptr;
+      } else if (key_ == "size") {
+        parameter_->size = nullptr;
+      } else if (key_ == "coarse" || key_ == "home" || key_ == "fadeWithIntensity" || key_ == "invert"
+          || key_ == "name" || key_ == "snap") {
+        ParameterError(fmt::format("{} has the wrong type", key_));
+      }
+      break;
+    case Context::kRanges:
+      if (!is_object) {
+        RangeError("Range is not an object");
+      }
+      range_.emplace();
+      next = Context::kRange;
+      break;
+    case Context::kRange:
+      if (key_ == "media") {
+        if (!is_object) {
+          MissingMediaData();
+        }
+        media_.emplace();
+        next = Context::kMedia;
+      } else if (key_ == "begin" || key_ == "default" || key_ == "end" || key_ == "label") {
+        RangeError(fmt::format("{} has the wrong type", key_));
+      }
+      break;
+    case Context::kMedia:
+      if (key_ == "r") {
+        // Not an error unless all three are present, so treat it like any other value of the wrong type
+        media_->r = nullptr;
+      } else if (key_ == "g") {
+        media_->g = nullptr;
+      } else if (key_ == "b") {
+        media_->b = nullptr;
+      } else if (key_ == "dcid" || key_ == "name") {
+        MediaError(fmt::format("{} has the wrong type", key_));
+      }
+      break;
+  }
+
+  if (next.has_value()) {
+    contexts_.push_back(next.value());
+  } else {
+    contexts_.push_back(Context::kSkip);
+    skip_depth_ = 1;
+  }
+  key_.clear();
+  return true;
+}
+
+bool LibraryReader::EndContainer() {
+  const Context context = contexts_.back();
+  if (context == Context::kSkip && --skip_depth_ > 0) {
+    return true;
+  }
+  contexts_.pop_back();
+  switch (context) {
+    case Context::kPersonality:EndPersonality();
+      break;
+    case Context::kParameter:EndParameter();
+      break;
+    case Context::kRange:EndRange();
+      break;
+    case Context::kMedia:EndMedia();
+      break;
+    default:break;
+  }
+  return true;
+}
+
+void LibraryReader::EndPersonality() {
+  PersonalityFields &fields = personality_.value();
+  if (!fields.has_manufacturer_name || !fields.has_mode_name || !fields.has_model_name || !fields.has_parameters) {
+    PersonalityError("Missing required field");
+  }
+  // The console uses a single hyphen to represent empty modes
+  if (fields.personality.GetModeName() == "-") {
+    fields.personality.SetModeName({});
+  }
+  fields.personality.parameters_ = std::move(fields.parameters);
+  personalities_.push_back(std::move(fields.personality));
+  personality_.reset();
+  ReportProgress();
+}
+
+void LibraryReader::ReportProgress() {
+  if (progress_callback_ == nullptr) {
+    return;
+  }
+  // The parser reads straight from the stream buffer, so its position is how far parsing has got.
+  const auto position = in_->rdbuf()->pubseekoff(0, std::ios::cur, std::ios::in);
+  const unsigned long current = position < 0 ? 0 : static_cast<unsigned long>(position);
+  if (!(*progress_callback_)(current, std::max(current, total_))) {
+    logging::info("Loading cancelled after {} personalities", personalities_.size());
+    throw except::LoadCancelled("Loading cancelled");
+  }
+}
+
+void LibraryReader::EndParameter() {
+  ParameterFields &fields = parameter_.value();
+  if (!fields.type.has_value()) {
+    MissingParameterType();
+  }
+  std::unique_ptr<parameter::Parameter> parameter =
+      parameter::Parameter::CreateForType(static_cast<parameter::Type>(fields.type.value()));
+  if (!fields.coarse.has_value() || !fields.fade_with_intensity.has_value() || !fields.home.has_value()
+      || !fields.invert.has_value() || !fields.name.has_value() || !fields.snap.has_value()) {
+    ParameterError("Missing required field");
+  }
+
+  // Addresses are zero-based
+  parameter->SetAddressCourse(fields.coarse.value() + 1);
+  if (fields.fine.has_value()) {
+    std::optional<int> size;
+    SetField(size, fields.size.value_or(nullptr), "size", &ParameterError);
+    if (size.value() == 16) {
+      std::optional<unsigned int> fine;
+      SetField(fine, std::move(fields.fine.value()), "fine", &ParameterError);
+      parameter->SetAddressFine(fine.value() + 1);
+    }
+  }
+  parameter->SetFadeWithIntensity(fields.fade_with_intensity.value());
+  parameter->SetHomeValue(fields.home.value());
+  parameter->SetInvert(fields.invert.value());
+  parameter->SetName(fields.name.value());
+  parameter->SetSnap(fields.snap.value());
+  parameter->ranges_ = std::move(fields.ranges);
+
+  personality_->parameters.push_back(std::move(parameter));
+  parameter_.reset();
+}
+
+void LibraryReader::EndRange() {
+  RangeFields &fields = range_.value();
+  if (!fields.begin.has_value() || !fields.default_value.has_value() || !fields.end.has_value()
+      || !fields.label.has_value()) {
+    RangeError("Missing required field");
+  }
+  parameter::Range range(fields.begin.value(), fields.end.value(), fields.default_value.value());
+  range.SetLabel(fields.label.value());
+  range.SetMedia(fields.media);
+
+  parameter_->ranges.push_back(std::move(range));
+  range_.reset();
+}
+
+void LibraryReader::EndMedia() {
+  MediaFields &fields = media_.value();
+  parameter::Media media;
+  if (fields.r.has_value() && fields.g.has_value() && fields.b.has_value()) {
+    std::optional<uint8_t> r, g, b;
+    SetField(r, std::move(fields.r.value()), "r", &MediaError);
+    SetField(g, std::move(fields.g.value()), "g", &MediaError);
+    SetField(b, std::move(fields.b.value()), "b", &MediaError);
+    media.SetRgb(r.value(), g.value(), b.value());
+  }
+  if (fields.dcid.has_value()) {
+    media.SetGoboDcid(fields.dcid);
+  }
+  if (!media.GetRgb().has_value() && !media.GetGoboDcid().has_value()) {
+    MissingMediaData();
+  }
+  if (!fields.name.has_value()) {
+    MediaError("Missing name");
+  }
+  media.SetName(fields.name.value());
+
+  range_->media = std::move(media);
+  media_.reset();
+}
+
+void LibraryReader::PersonalityError(const std::string &what) {
+  logging::error(fmt::format("Error loading personality: {}", what));
+  throw except::ParseError("Error loading personality");
+}
+
+void LibraryReader::ParameterError(const std::string &what) {
+  logging::error(fmt::format("Error parsing parameter: {}", what));
+  throw except::ParseError("Error parsing parameter");
+}
+
+void LibraryReader::RangeError(const std::string &what) {
+  logging::error(fmt::format("Error parsing range: {}", what));
+  throw except::ParseError("Error parsing range");
+}
+
+void LibraryReader::MediaError(const std::string &what) {
+  logging::error(fmt::format("Error parsing media: {}", what));
+  throw except::ParseError("Error parsing media");
+}
+
+} // csprofile
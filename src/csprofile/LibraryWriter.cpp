@@ -0,0 +1,240 @@
+/**
+ * @file LibraryWriter.cpp
+ *
+ * @author dankeenan
+ * @date 5/16/21
+ * @copyright (c) 2021 Dan Keenan
+ */
+
+#include "csprofile/LibraryWriter.h"
+#include <algorithm>
+#include <charconv>
+#include <nlohmann/json.hpp>
+
+namespace csprofile {
+
+LibraryWriter::LibraryWriter(std::ostream &out, Library::Format format) :
+    out_(&out), pretty_(format == Library::Format::kPretty) {
+  buffer_.reserve(kFlushSize * 2);
+}
+
+LibraryWriter::LibraryWriter(Library::Format format) :
+    out_(nullptr), pretty_(format == Library::Format::kPretty) {}
+
+void LibraryWriter::Write(const std::string &date,
+                          const std::string &editor_version,
+                          const std::vector<Personality> &personalities) {
+  // Keys are written in sorted order to match json objects
+  StartObject();
+  Key("date");
+  Value(date);
+  Key("editorVersion");
+  Value(editor_version);
+  Key("personalities");
+  StartArray();
+  for (const auto &personality : personalities) {
+    Element();
+    WritePersonality(personality);
+    if (out_ != nullptr && buffer_.size() >= kFlushSize) {
+      Flush();
+    }
+  }
+  End(']');
+  End('}');
+}
+
+void LibraryWriter::Flush() {
+  if (out_ == nullptr) {
+    return;
+  }
+  out_->write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+  buffer_.clear();
+}
+
+void LibraryWriter::WritePersonality(const Personality &personality) {
+  StartObject();
+  // Color table
+  const std::optional<ColorTable::ColorMixingType> color_table = personality.GetColorMixingType();
+  if (color_table.has_value()) {
+    Key("colortable");
+    Value(ColorTable::GetColorTableUuid(color_table.value()));
+  }
+  Key("dcid");
+  Value(personality.GetDcid());
+  Key("hasIntensity");
+  Value(std::any_of(personality.parameters_.cbegin(), personality.parameters_.cend(),
+                    [](const std::unique_ptr<parameter::Parameter> &parameter) {
+                      return parameter->GetType() == parameter::Type::kIntensity;
+                    }));
+  Key("manufacturerName");
+  Value(personality.GetManufacturerName().empty() ? "Custom" : personality.GetManufacturerName());
+  // Addresses are zero-based
+  Key("maxOffset");
+  Value(personality.GetFootprint() - 1);
+  Key("modeName");
+  Value(personality.GetModeName().empty() ? "-" : personality.GetModeName());
+  Key("modelName");
+  Value(personality.GetModelName().empty() ? "-" : personality.GetModelName());
+  Key("parameters");
+  StartArray();
+  for (const auto &parameter : personality.parameters_) {
+    Element();
+    WriteParameter(*parameter);
+  }
+  End(']');
+  End('}');
+}
+
+void LibraryWriter::WriteParameter(const parameter::Parameter &parameter) {
+  StartObject();
+  // Addresses are zero-based
+  Key("coarse");
+  Value(parameter.GetAddressCourse() - 1);
+  Key("fadeWithIntensity");
+  Value(parameter.GetFadeWithIntensity());
+  if (parameter.Is16Bit()) {
+    Key("fine");
+    Value(parameter.GetAddressFine() - 1);
+  }
+  Key("highlight");
+  Value(parameter.GetHighlightValue());
+  Key("home");
+  Value(parameter.GetHomeValue());
+  Key("invert");
+  Value(parameter.GetInvert());
+  Key("name");
+  Value(parameter.GetName());
+  if (!parameter.ranges_.empty()) {
+    Key("ranges");
+    StartArray();
+    for (const auto &range : parameter.ranges_) {
+      Element();
+      WriteRange(range);
+    }
+    End(']');
+  }
+  Key("size");
+  Value(parameter.Is16Bit() ? 16 : 8);
+  Key("snap");
+  Value(parameter.GetSnap());
+  Key("type");
+  Value(static_cast<unsigned int>(parameter.GetType()));
+  End('}');
+}
+
+void LibraryWriter::WriteRange(const parameter::Range &range) {
+  StartObject();
+  Key("begin");
+  Value(range.GetBeginValue());
+  Key("default");
+  Value(range.GetDefaultValue());
+  Key("end");
+  Value(range.GetEndValue());
+  Key("label");
+  Value(range.GetLabel());
+  if (range.GetMedia().has_value()) {
+    Key("media");
+    WriteMedia(range.GetMedia().value());
+  }
+  End('}');
+}
+
+void LibraryWriter::WriteMedia(const parameter::Media &media) {
+  const std::optional<uint32_t> rgb = media.GetRgb();
+  const std::optional<std::string> gobo_dcid = media.GetGoboDcid();
+
+  StartObject();
+  if (rgb.has_value()) {
+    Key("b");
+    Value(static_cast<unsigned int>((rgb.value() & (0xFF << 0)) >> 0));
+  }
+  if (gobo_dcid.has_value()) {
+    Key("dcid");
+    Value(gobo_dcid.value());
+  }
+  if (rgb.has_value()) {
+    Key("g");
+    Value(static_cast<unsigned int>((rgb.value() & (0xFF << 8)) >> 8));
+  }
+  Key("name");
+  Value(media.GetName());
+  if (rgb.has_value()) {
+    Key("r");
+    Value(static_cast<unsigned int>((rgb.value() & (0xFF << 16)) >> 16));
+  }
+  End('}');
+}
+
+void LibraryWriter::StartObject() {
+  buffer_ += '{';
+  has_members_.push_back(false);
+}
+
+void LibraryWriter::StartArray() {
+  buffer_ += '[';
+  has_members_.push_back(false);
+}
+
+void LibraryWriter::End(char close) {
+  const bool has_members = has_members_.back();
+  has_members_.pop_back();
+  // Empty containers are written on one line
+  if (has_members) {
+    NewLine();
+  }
+  buffer_ += close;
+}
+
+void LibraryWriter::Key(std::string_view key) {
+  Element();
+  Value(key);
+  buffer_ += pretty_ ? ": " : ":";
+}
+
+void LibraryWriter::Element() {
+  if (has_members_.back()) {
+    buffer_ += ',';
+  }
+  has_members_.back() = true;
+  NewLine();
+}
+
+void LibraryWriter::Value(std::string_view value) {
+  const bool needs_escaping = std::any_of(value.cbegin(), value.cend(), [](char c) {
+    const auto byte = static_cast<unsigned char>(c);
+    return byte < 0x20 || byte >= 0x80 || c == '"' || c == '\\';
+  });
+  if (needs_escaping) {
+    // Rare; let the json library handle escapes and UTF-8 validation so the output matches exactly.
+    buffer_ += nlohmann::json(std::string(value)).dump();
+  } else {
+    buffer_ += '"';
+    buffer_ += value;
+    buffer_ += '"';
+  }
+}
+
+void LibraryWriter::Value(bool value) {
+  buffer_ += value ? "true" : "false";
+}
+
+void LibraryWriter::Value(unsigned int value) {
+  char chars[16];
+  const auto result = std::to_chars(std::begin(chars), std::end(chars), value);
+  buffer_.append(chars, result.ptr);
+}
+
+void LibraryWriter::Value(int value) {
+  char chars[16];
+  const auto result = std::to_chars(std::begin(chars), std::end(chars), value);
+  buffer_.append(chars, result.ptr);
+}
+
+void LibraryWriter::NewLine() {
+  if (pretty_) {
+    buffer_ += '\n';
+    buffer_.append(has_members_.size() * 4, ' ');
+  }
+}
+
+} // csprofile
@@ -0,0 +1,79 @@
+/**
+ * @file AsyncQuery.h
+ *
+ * @author dankeenan
+ * @date 5/16/21
+ * @copyright (c) 2021 Dan Keenan
+ */
+
+#ifndef CSPROFILEEDITOR_SRC_CSPROFILEEDITOR_ASYNCQUERY_H_
+#define CSPROFILEEDITOR_SRC_CSPROFILEEDITOR_ASYNCQUERY_H_
+
+#include <QCoreApplication>
+#include <QPointer>
+#include <cslibs/AsyncDb.h>
+#include <cslibs/except.h>
+#include <csprofile/logging.h>
+#include <sqlite3.h>
+
+namespace csprofileeditor {
+
+/**
+ * Run @p query on a worker thread and pass its result to @p callback on the GUI thread.
+ *
+ * If @p query fails, the error is logged and @p error_callback is called on the GUI thread instead, so callers can
+ * forget about the query and try again later.  Neither is called if @p token has been cancelled or @p context has been
+ * destroyed by the time the query finishes, so owners should cancel @p token when they are destroyed.
+ *
+ * @param async_db
+ * @param context Object that the callbacks use
+ * @param token
+ * @param query Callable taking a `T &`; runs on a worker thread.
+ * @param callback Callable taking the query's result; runs on the GUI thread.
+ * @param error_callback Callable taking no arguments; runs on the GUI thread.
+ */
+template<class T, class Query, class Callback, class ErrorCallback>
+void RunQuery(cslibs::AsyncDb<T> &async_db,
+              QObject *context,
+              cslibs::CancelToken token,
+              Query query,
+              Callback callback,
+              ErrorCallback error_callback) {
+  QPointer<QObject> guard(context);
+  // The token is passed by copy; moving it could empty it before the lambda captures it, since argument evaluation
+  // order is unspecified.
+  async_db.Submit([query = std::move(query), guard, token, callback = std::move(callback),
+                      error_callback = std::move(error_callback)](T &db) mutable {
+    // Deliver through the application object, which outlives the context.
+    const auto deliver = [guard, token](auto function) {
+      QMetaObject::invokeMethod(qApp, [guard, token, function = std::move(function)]() mutable {
+        if (guard && !token.IsCancelled()) {
+          function();
+        }
+      }, Qt::QueuedConnection);
+    };
+    try {
+      auto result = query(db);
+      deliver([callback = std::move(callback), result = std::move(result)]() mutable {
+        callback(std::move(result));
+      });
+      return;
+    } catch (const cslibs::except::QueryCancelled &) {
+      // Nobody is waiting for the result.
+      return;
+    } catch (const SQLite::Exception &e) {
+      if (e.getErrorCode() == SQLITE_INTERRUPT) {
+        // Interrupted because the token was cancelled.
+        return;
+      }
+      csprofile::logging::warn("Database error: {}", e.what());
+    } catch (const std::exception &e) {
+      csprofile::logging::warn("Query failed: {}", e.what());
+    }
+    deliver(std::move(error_callback));
+  }, token);
+}
+
+} // csprofileeditor
+
+#endif //CSPROFILEEDITOR_SRC_CSPROFILEEDITOR_ASYNCQUERY_H_
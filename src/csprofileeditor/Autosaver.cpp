@@ -0,0 +1,369 @@
+/**
+ * @file Autosaver.cpp
+ *
+ * @author dankeenan
+ * @date 5/16/21
+ * @copyright (c) 2021 Dan Keenan
+ */
+
+#include "Autosaver.h"
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStandardPaths>
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <csprofile/logging.h>
+
+namespace csprofileeditor {
+
+namespace {
+
+const auto kSnapshotPrefix = QStringLiteral("snapshot-");
+const auto kSnapshotSuffix = QStringLiteral(".jlib");
+const auto kJournalPrefix = QStringLiteral("journal-");
+
+/**
+ * Find the generations that have files in @p dir.
+ *
+ * @return Generations with a snapshot and generations with a journal, each in ascending order
+ */
+std::pair<std::vector<unsigned int>, std::vector<unsigned int>> ListGenerations(const QDir &dir) {
+  std::vector<unsigned int> snapshots;
+  std::vector<unsigned int> journals;
+  for (const auto &file_name : dir.entryList(QDir::Files)) {
+    bool ok = false;
+    if (file_name.startsWith(kSnapshotPrefix) && file_name.endsWith(kSnapshotSuffix)) {
+      const unsigned int generation = file_name
+          .mid(kSnapshotPrefix.size(), file_name.size() - kSnapshotPrefix.size() - kSnapshotSuffix.size())
+          .toUInt(&ok);
+      if (ok) {
+        snapshots.push_back(generation);
+      }
+    } else if (file_name.startsWith(kJournalPrefix)) {
+      const unsigned int generation = file_name.mid(kJournalPrefix.size()).toUInt(&ok);
+      if (ok) {
+        journals.push_back(generation);
+      }
+    }
+  }
+  std::sort(snapshots.begin(), snapshots.end());
+  std::sort(journals.begin(), journals.end());
+  return {snapshots, journals};
+}
+
+QString GetSnapshotPath(const QDir &dir, unsigned int generation) {
+  return dir.absoluteFilePath(QString("%1%2%3").arg(kSnapshotPrefix).arg(generation).arg(kSnapshotSuffix));
+}
+
+QString GetJournalPath(const QDir &dir, unsigned int generation) {
+  return dir.absoluteFilePath(QString("%1%2").arg(kJournalPrefix).arg(generation));
+}
+
+/**
+ * Record how the file at @p path is on disk now.
+ */
+Autosaver::BaseFile GetBaseFile(const QString &path) {
+  if (path.isEmpty()) {
+    return {};
+  }
+  const QFileInfo info(path);
+  return {path, info.size(), info.lastModified().toMSecsSinceEpoch()};
+}
+
+/**
+ * Serialize @p base_file for the session file.
+ */
+QByteArray WriteSessionFile(const Autosaver::BaseFile &base_file) {
+  // Numbers are stored as doubles, which hold these exactly.
+  const QJsonObject session{
+      {"path", base_file.path},
+      {"size", static_cast<double>(base_file.size)},
+      {"modified", static_cast<double>(base_file.modified)},
+  };
+  return QJsonDocument(session).toJson(QJsonDocument::Compact);
+}
+
+/**
+ * @return The base file from a session file, or nothing if it can't be parsed
+ */
+std::optional<Autosaver::BaseFile> ReadSessionFile(const QByteArray &contents) {
+  const auto document = QJsonDocument::fromJson(contents);
+  if (!document.isObject()) {
+    return {};
+  }
+  const auto session = document.object();
+  return Autosaver::BaseFile{
+      session.value("path").toString(),
+      static_cast<qint64>(session.value("size").toDouble(-1)),
+      static_cast<qint64>(session.value("modified").toDouble(-1)),
+  };
+}
+
+/**
+ * Rebuild the library as it was when @p generation started: the newest snapshot before it (or @p base_file if there
+ * is none) plus the journals written since.
+ *
+ * @param changes Set to the number of changes replayed from the journals
+ * @throws std::exception when the files can't be read, or @p base_file is needed but has changed on disk
+ */
+std::shared_ptr<csprofile::Library> LoadGeneration(const QDir &dir, const Autosaver::BaseFile &base_file,
+                                                   unsigned int generation, unsigned int *changes = nullptr) {
+  auto[snapshots, journals] = ListGenerations(dir);
+  snapshots.erase(std::lower_bound(snapshots.begin(), snapshots.end(), generation), snapshots.end());
+  // Start from the newest complete snapshot; older ones are already included in it.
+  const unsigned int base = snapshots.empty() ? 0 : snapshots.back();
+  std::shared_ptr<csprofile::Library> library;
+  if (!snapshots.empty()) {
+    library = std::make_shared<csprofile::Library>(GetSnapshotPath(dir, base).toStdString());
+  } else if (!base_file.path.isEmpty()) {
+    // Replaying the journals over a different file would silently corrupt it.
+    const auto current = GetBaseFile(base_file.path);
+    if (current.size != base_file.size || current.modified != base_file.modified) {
+      throw std::runtime_error(QString("%1 has changed since it was opened").arg(base_file.path).toStdString());
+    }
+    library = std::make_shared<csprofile::Library>(base_file.path.toStdString());
+  } else {
+    library = std::make_shared<csprofile::Library>();
+  }
+  unsigned int replayed = 0;
+  for (const auto journal : journals) {
+    if (journal >= base && journal < generation) {
+      replayed += csprofile::Journal::Replay(GetJournalPath(dir, journal).toStdString(), *library);
+    }
+  }
+  if (changes != nullptr) {
+    *changes = replayed;
+  }
+  return library;
+}
+
+/**
+ * Remove the snapshots and journals from before @p generation.
+ */
+void RemoveGenerationsBefore(const QDir &dir, unsigned int generation) {
+  const auto[snapshots, journals] = ListGenerations(dir);
+  for (const auto snapshot : snapshots) {
+    if (snapshot < generation) {
+      QFile::remove(GetSnapshotPath(dir, snapshot));
+    }
+  }
+  for (const auto journal : journals) {
+    if (journal < generation) {
+      QFile::remove(GetJournalPath(dir, journal));
+    }
+  }
+}
+
+} // namespace
+
+Autosaver::Autosaver(PersonalityTableModel *model, QObject *parent) :
+    QObject(parent),
+    dir_(QDir(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation)).absoluteFilePath("autosave")),
+    lock_(dir_.absoluteFilePath("lock")),
+    worker_(1),
+    timer_(new QTimer(this)) {
+  // Only one instance can autosave at a time.  A lock left by a crashed instance is stale and will be taken over.
+  enabled_ = dir_.mkpath(".") && lock_.tryLock(0);
+  if (!enabled_) {
+    csprofile::logging::warn("Autosave is not available");
+  }
+
+  connect(model, &PersonalityTableModel::dataChanged, this, &Autosaver::SDataChanged);
+  connect(model, &PersonalityTableModel::rowsInserted, this, &Autosaver::SRowsInserted);
+  connect(model, &PersonalityTableModel::rowsRemoved, this, &Autosaver::SRowsRemoved);
+  connect(timer_, &QTimer::timeout, this, &Autosaver::Snapshot);
+  timer_->start(kSnapshotIntervalMs);
+}
+
+Autosaver::~Autosaver() {
+  WaitForSnapshot();
+}
+
+bool Autosaver::HasRecoveryData() const {
+  if (!enabled_ || !dir_.exists(kSessionFileName)) {
+    return false;
+  }
+  // A session that never changed anything leaves only empty journals, and the file it opened is already up to date.
+  const auto[snapshots, journals] = ListGenerations(dir_);
+  return !snapshots.empty() || std::any_of(journals.cbegin(), journals.cend(), [this](unsigned int generation) {
+    return QFileInfo(GetJournalPath(dir_, generation)).size() > 0;
+  });
+}
+
+std::optional<Autosaver::Recovered> Autosaver::Recover() {
+  if (!HasRecoveryData()) {
+    return {};
+  }
+  WaitForSnapshot();
+  journal_.reset();
+
+  QFile session_file(dir_.absoluteFilePath(kSessionFileName));
+  if (!session_file.open(QIODevice::ReadOnly)) {
+    return {};
+  }
+  const auto base_file = ReadSessionFile(session_file.readAll());
+  session_file.close();
+  if (!base_file.has_value()) {
+    csprofile::logging::error("Could not read autosave session");
+    return {};
+  }
+
+  const auto[snapshots, journals] = ListGenerations(dir_);
+  const unsigned int last_generation = std::max(snapshots.empty() ? 0 : snapshots.back(),
+                                                journals.empty() ? 0 : journals.back());
+  try {
+    unsigned int changes = 0;
+    auto library = LoadGeneration(dir_, *base_file, last_generation + 1, &changes);
+    csprofile::logging::info("Recovered {} changes", changes);
+
+    // Keep the recovered library safe until it is saved.
+    generation_ = last_generation + 1;
+    library->Save(GetSnapshotPath(dir_, generation_).toStdString());
+    RemoveGenerationsBefore(dir_, generation_);
+    library_ = library;
+    base_file_ = *base_file;
+    OpenJournal();
+
+    return Recovered{library, base_file->path};
+  } catch (const std::exception &e) {
+    csprofile::logging::error("Could not recover autosaved library: {}", e.what());
+    return {};
+  }
+}
+
+void Autosaver::Start(std::shared_ptr<csprofile::Library> library, const QString &path) {
+  library_ = std::move(library);
+  base_file_ = GetBaseFile(path);
+  if (!enabled_) {
+    return;
+  }
+  WaitForSnapshot();
+  journal_.reset();
+  RemoveAutosaveFiles();
+
+  generation_ = 0;
+  QFile session_file(dir_.absoluteFilePath(kSessionFileName));
+  if (!session_file.open(QIODevice::WriteOnly | QIODevice::Truncate)
+      || session_file.write(WriteSessionFile(base_file_)) < 0) {
+    csprofile::logging::warn("Could not start autosave");
+    return;
+  }
+  session_file.close();
+  OpenJournal();
+}
+
+void Autosaver::Discard() {
+  library_.reset();
+  if (!enabled_) {
+    return;
+  }
+  WaitForSnapshot();
+  journal_.reset();
+  RemoveAutosaveFiles();
+}
+
+void Autosaver::RemoveAutosaveFiles() {
+  for (const auto &file_name : dir_.entryList(QDir::Files)) {
+    // Don't remove the lock, which is still held.
+    if (dir_.absoluteFilePath(file_name) != lock_.fileName()) {
+      dir_.remove(file_name);
+    }
+  }
+}
+
+void Autosaver::WaitForSnapshot() {
+  if (pending_snapshot_.valid()) {
+    pending_snapshot_.wait();
+  }
+}
+
+void Autosaver::Snapshot() {
+  if (!journal_ || journal_->GetSize() == 0) {
+    // Nothing has changed since the last snapshot.
+    return;
+  }
+  if (pending_snapshot_.valid()
+      && pending_snapshot_.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+    // Still writing the last one; try again later.
+    return;
+  }
+
+  ++generation_;
+  OpenJournal();
+  if (!journal_) {
+    // Autosave has been turned off.
+    return;
+  }
+  // The snapshot is rebuilt from the files that are already written, the same way Recover() would, instead of copying
+  // the library here.  Copying a large library takes long enough to stall the GUI; reading it back takes longer, but
+  // happens on the worker.
+  pending_snapshot_ = worker_.Submit([dir = dir_, base_file = base_file_, generation = generation_,
+                                         snapshot_path = GetSnapshotPath(dir_, generation_).toStdString()]() {
+    try {
+      LoadGeneration(dir, base_file, generation)->Save(snapshot_path);
+    } catch (const std::exception &e) {
+      // The older files are still needed.
+      csprofile::logging::warn("Could not write autosave snapshot: {}", e.what());
+      return;
+    }
+    RemoveGenerationsBefore(dir, generation);
+  });
+}
+
+void Autosaver::OpenJournal() {
+  try {
+    journal_ = std::make_unique<csprofile::Journal>(GetJournalPath(dir_, generation_).toStdString());
+  } catch (const std::runtime_error &e) {
+    csprofile::logging::warn("Could not open autosave journal: {}", e.what());
+    journal_.reset();
+    RemoveAutosaveFiles();
+  }
+}
+
+template<typename Record>
+void Autosaver::RecordChange(Record record) {
+  if (!journal_) {
+    return;
+  }
+  try {
+    record(*journal_);
+  } catch (const std::exception &e) {
+    // Incomplete autosave data would recover the wrong library.
+    csprofile::logging::warn("Could not write autosave journal: {}", e.what());
+    WaitForSnapshot();
+    journal_.reset();
+    RemoveAutosaveFiles();
+    return;
+  }
+  if (journal_->GetSize() >= kSnapshotJournalSize) {
+    Snapshot();
+  }
+}
+
+void Autosaver::SDataChanged(const QModelIndex &top_left, const QModelIndex &bottom_right) {
+  for (int row = top_left.row(); row <= bottom_right.row(); ++row) {
+    RecordChange([this, row](csprofile::Journal &journal) {
+      journal.RecordUpdate(row, library_->personalities.at(row));
+    });
+  }
+}
+
+void Autosaver::SRowsInserted(const QModelIndex &parent, int first, int last) {
+  for (int row = first; row <= last; ++row) {
+    RecordChange([this, row](csprofile::Journal &journal) {
+      journal.RecordInsert(row, library_->personalities.at(row));
+    });
+  }
+}
+
+void Autosaver::SRowsRemoved(const QModelIndex &parent, int first, int last) {
+  RecordChange([first, last](csprofile::Journal &journal) {
+    journal.RecordRemove(first, last - first + 1);
+  });
+}
+
+} // csprofileeditor
@@ -0,0 +1,128 @@
+/**
+ * @file Autosaver.h
+ *
+ * @author dankeenan
+ * @date 5/16/21
+ * @copyright (c) 2021 Dan Keenan
+ */
+
+#ifndef CSPROFILEEDITOR_SRC_CSPROFILEEDITOR_AUTOSAVER_H_
+#define CSPROFILEEDITOR_SRC_CSPROFILEEDITOR_AUTOSAVER_H_
+
+#include <QDir>
+#include <QLockFile>
+#include <QObject>
+#include <QTimer>
+#include <future>
+#include <memory>
+#include <optional>
+#include <cslibs/WorkerPool.h>
+#include <csprofile/Journal.h>
+#include <csprofile/Library.h>
+#include "PersonalityTableModel.h"
+
+namespace csprofileeditor {
+
+/**
+ * Keeps a crash-safe copy of the open library.
+ *
+ * Each change made through the model is appended to a journal right away.  Now and then, a full snapshot of the library
+ * is written on a background thread and a new journal is started, so the journal stays small.  After a crash, the
+ * last complete snapshot (or the file that was opened) plus the journals that follow it rebuild the library.
+ *
+ * Files for generation N are "snapshot-N.jlib" and "journal-N".  Journal N holds the changes made after snapshot N was
+ * taken; generation 0 starts from the opened file, so it has no snapshot.  The opened file's size and modification
+ * time are kept in the session file, and it won't be used as a base if it has changed since.
+ */
+class Autosaver : public QObject {
+ Q_OBJECT
+ public:
+  struct Recovered {
+    std::shared_ptr<csprofile::Library> library;
+    /** Where the library was opened from; empty for a new library */
+    QString path;
+  };
+
+  /**
+   * The file a library was opened from, as it was on disk when autosave started.
+   *
+   * Journals only make sense on top of the exact file they were recorded against.
+   */
+  struct BaseFile {
+    /** Empty for a new library */
+    QString path;
+    qint64 size = -1;
+    /** Milliseconds since the epoch */
+    qint64 modified = -1;
+  };
+
+  /**
+   * @param model Changes made through this model are recorded.
+   * @param parent
+   */
+  explicit Autosaver(PersonalityTableModel *model, QObject *parent = nullptr);
+  ~Autosaver() override;
+
+  /**
+   * Check for changes left behind by a session that didn't shut down cleanly.
+   */
+  [[nodiscard]] bool HasRecoveryData() const;
+
+  /**
+   * Rebuild the library left behind by a previous session and keep autosaving it.
+   *
+   * @return The recovered library, or nothing if it couldn't be rebuilt.
+   */
+  std::optional<Recovered> Recover();
+
+  /**
+   * Start over with a library that matches @p path on disk, e.g. after opening or saving it.
+   *
+   * @param library
+   * @param path Empty for a new library.
+   */
+  void Start(std::shared_ptr<csprofile::Library> library, const QString &path);
+
+  /**
+   * Remove all autosave data, e.g. when closing without saving.
+   */
+  void Discard();
+
+ private:
+  /** Write a snapshot every this often, if anything has changed */
+  static const int kSnapshotIntervalMs = 5 * 60 * 1000;
+  /** Write a snapshot sooner once the journal is this large */
+  static const long kSnapshotJournalSize = 1024 * 1024;
+  static inline const auto kSessionFileName = "session";
+
+  QDir dir_;
+  QLockFile lock_;
+  /** FALSE if another instance is autosaving or autosave data can't be written */
+  bool enabled_;
+  std::shared_ptr<csprofile::Library> library_;
+  BaseFile base_file_;
+  unsigned int generation_ = 0;
+  std::unique_ptr<csprofile::Journal> journal_;
+  cslibs::WorkerPool worker_;
+  std::future<void> pending_snapshot_;
+  QTimer *timer_;
+
+  void RemoveAutosaveFiles();
+  void WaitForSnapshot();
+  void Snapshot();
+  void OpenJournal();
+  /**
+   * Record a change, turning autosave off if it can't be written.
+   */
+  template<typename Record>
+  void RecordChange(Record record);
+
+ private Q_SLOTS:
+  void SDataChanged(const QModelIndex &top_left, const QModelIndex &bottom_right);
+  void SRowsInserted(const QModelIndex &parent, int first, int last);
+  void SRowsRemoved(const QModelIndex &parent, int first, int last);
+};
+
+} // csprofileeditor
+
+#endif //CSPROFILEEDITOR_SRC_CSPROFILEEDITOR_AUTOSAVER_H_
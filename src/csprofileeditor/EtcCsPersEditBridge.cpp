@@ -10,6 +10,7 @@
 #include "Settings.h"
 #include <csprofile/parameter/Parameter.h>
 #include <QApplication>
+#include <cslibs/DcidResolver.h>
 #include <cslibs/disc/DiscDb.h>
 #include <cslibs/effect/EffectDb.h>
 #include <cslibs/gel/GelDb.h>
@@ -28,6 +29,10 @@
 
 namespace csprofileeditor {
 
+std::shared_ptr<cslibs::DcidResolver> EtcCsPersEditBridge::dcid_resolver_;
+unsigned int EtcCsPersEditBridge::dcid_resolver_generation_ = 0;
+std::vector<std::function<void()>> EtcCsPersEditBridge::async_db_pool_clearers_;
+
 const QStringList EtcCsPersEditBridge::kImagesDataPaths = {
     "bin/config/CSEDIT_IMAGES.dat",
     "config/CSEDIT_IMAGES.dat",
@@ -198,6 +203,100 @@ std::shared_ptr<cslibs::gobo::GoboDb> EtcCsPersEditBridge::GetGoboDb() {
   return GetImageDb<cslibs::gobo::GoboDb>(GetCsEditGobosPath(), GetDbPath("gobo.db"));
 }
 
+std::shared_ptr<cslibs::disc::DiscDb> EtcCsPersEditBridge::OpenDiscDbReader() {
+  return OpenReader<cslibs::disc::DiscDb>(GetCsEditDiscsPath(), GetDbPath("disc.db"));
+}
+
+std::shared_ptr<cslibs::effect::EffectDb> EtcCsPersEditBridge::OpenEffectDbReader() {
+  return OpenReader<cslibs::effect::EffectDb>(GetCsEditEffectsPath(), GetDbPath("effect.db"));
+}
+
+std::shared_ptr<cslibs::gel::GelDb> EtcCsPersEditBridge::OpenGelDbReader() {
+  return OpenReader<cslibs::gel::GelDb>(GetCsEditGelsPath(), GetDbPath("gel.db"));
+}
+
+std::shared_ptr<cslibs::gobo::GoboDb> EtcCsPersEditBridge::OpenGoboDbReader() {
+  return OpenReader<cslibs::gobo::GoboDb>(GetCsEditGobosPath(), GetDbPath("gobo.db"));
+}
+
+std::shared_ptr<cslibs::AsyncDb<cslibs::ImageDb>> EtcCsPersEditBridge::GetAsyncDiscDb() {
+  return GetAsyncDb<cslibs::disc::DiscDb, cslibs::ImageDb>(GetCsEditDiscsPath(), GetDbPath("disc.db"));
+}
+
+std::shared_ptr<cslibs::AsyncDb<cslibs::ImageDb>> EtcCsPersEditBridge::GetAsyncEffectDb() {
+  return GetAsyncDb<cslibs::effect::EffectDb, cslibs::ImageDb>(GetCsEditEffectsPath(), GetDbPath("effect.db"));
+}
+
+std::shared_ptr<cslibs::AsyncDb<cslibs::gel::GelDb>> EtcCsPersEditBridge::GetAsyncGelDb() {
+  return GetAsyncDb<cslibs::gel::GelDb>(GetCsEditGelsPath(), GetDbPath("gel.db"));
+}
+
+std::shared_ptr<cslibs::AsyncDb<cslibs::ImageDb>> EtcCsPersEditBridge::GetAsyncGoboDb() {
+  return GetAsyncDb<cslibs::gobo::GoboDb, cslibs::ImageDb>(GetCsEditGobosPath(), GetDbPath("gobo.db"));
+}
+
+std::vector<std::shared_ptr<cslibs::AsyncDb<cslibs::ImageDb>>> EtcCsPersEditBridge::GetAsyncImageLibraries() {
+  // Must match LoadDcidResolver()
+  return {
+      GetAsyncDiscDb(),
+      GetAsyncEffectDb(),
+      GetAsyncGoboDb(),
+  };
+}
+
+std::shared_ptr<cslibs::WorkerPool> EtcCsPersEditBridge::GetWorkerPool() {
+  static auto worker_pool = std::make_shared<cslibs::WorkerPool>();
+  return worker_pool;
+}
+
+std::shared_ptr<cslibs::DcidResolver> EtcCsPersEditBridge::GetDcidResolver() {
+  if (!dcid_resolver_ && dcid_resolver_generation_ == 0) {
+    LoadDcidResolver();
+  }
+  return dcid_resolver_;
+}
+
+void EtcCsPersEditBridge::LoadDcidResolver() {
+  // Same search order as the official editor: discs, then effects, then gobos.  Must match GetAsyncImageLibraries().
+  // The resolver is only used from the GUI thread once it's loaded, so it gets its own connections.
+  std::vector<std::shared_ptr<cslibs::ImageDb>> libraries{
+      OpenDiscDbReader(),
+      OpenEffectDbReader(),
+      OpenGoboDbReader(),
+  };
+  // Reading every dcid is slow, so do it on a worker and keep using the current resolver until it's done.
+  const unsigned int generation = ++dcid_resolver_generation_;
+  GetWorkerPool()->Submit([libraries = std::move(libraries), generation]() mutable {
+    std::shared_ptr<cslibs::DcidResolver> dcid_resolver;
+    try {
+      dcid_resolver = std::make_shared<cslibs::DcidResolver>(std::move(libraries));
+    } catch (const cslibs::except::DbError &e) {
+      csprofile::logging::warn("Failed to load dcids: {}", e.what());
+    } catch (const SQLite::Exception &e) {
+      csprofile::logging::warn("Database error: {}", e.what());
+    }
+    QMetaObject::invokeMethod(qApp, [dcid_resolver = std::move(dcid_resolver), generation]() {
+      // Results from a load that has since been restarted are out of date.
+      if (generation == dcid_resolver_generation_ && dcid_resolver) {
+        dcid_resolver_ = dcid_resolver;
+        Q_EMIT(GetNotifier()->ZDcidResolverLoaded());
+      }
+    }, Qt::QueuedConnection);
+  });
+}
+
+void EtcCsPersEditBridge::LibrariesUpdated() {
+  for (const auto &clear : async_db_pool_clearers_) {
+    clear();
+  }
+  LoadDcidResolver();
+}
+
+EtcCsPersEditBridgeNotifier *EtcCsPersEditBridge::GetNotifier() {
+  static auto *notifier = new EtcCsPersEditBridgeNotifier(qApp);
+  return notifier;
+}
+
 std::optional<QString> EtcCsPersEditBridge::GetFirstExistentPath(const QDir &root, const QStringList &paths) {
   for (const auto &path : paths) {
     if (root.exists(path)) {
@@ -10,11 +10,15 @@
 #define CSPROFILEEDITOR_SRC_CSPROFILEEDITOR_ETCCSPERSEDITBRIDGE_H_
 
 #include <QDir>
+#include <QObject>
+#include <functional>
 #include <memory>
+#include <cslibs/AsyncDb.h>
 #include <cslibs/Db.h>
 #include <cslibs/except.h>
 #include <csprofile/logging.h>
 #include <sqlite3.h>
+#include "ThumbnailCache.h"
 
 namespace csprofile::parameter {
 enum class Type;
@@ -22,6 +26,8 @@ enum class Type;
 
 namespace cslibs {
 
+class DcidResolver;
+
 namespace disc {
 class DiscDb;
 } // disc
@@ -42,6 +48,21 @@ class GoboDb;
 
 namespace csprofileeditor {
 
+/**
+ * Announces changes made by EtcCsPersEditBridge in the background.
+ */
+class EtcCsPersEditBridgeNotifier : public QObject {
+ Q_OBJECT
+ public:
+  using QObject::QObject;
+
+ Q_SIGNALS:
+  /**
+   * A new resolver is available from EtcCsPersEditBridge::GetDcidResolver().
+   */
+  void ZDcidResolverLoaded();
+};
+
 /**
  * Handle interfacing with the official editor
  */
@@ -66,11 +87,87 @@ class EtcCsPersEditBridge {
 
   [[nodiscard]] static QString GetParameterTypeName(csprofile::parameter::Type type);
 
+  /**
+   * Get the library's writer, which creates, upgrades, and updates the database.
+   *
+   * There is one writer per library, shared by all threads.
+   *
+   * @return The writer, or nullptr if the library is not available.
+   */
   [[nodiscard]] static std::shared_ptr<cslibs::disc::DiscDb> GetDiscDb();
   [[nodiscard]] static std::shared_ptr<cslibs::effect::EffectDb> GetEffectDb();
   [[nodiscard]] static std::shared_ptr<cslibs::gel::GelDb> GetGelDb();
   [[nodiscard]] static std::shared_ptr<cslibs::gobo::GoboDb> GetGoboDb();
 
+  /**
+   * Open a read-only connection to the disc library.
+   *
+   * The Get*Db() connections are the libraries' writers.  Code that only reads should use its own connection, so it
+   * never waits for a library update.  Each read-only connection must only be used by one thread at a time.
+   *
+   * @return The connection, or nullptr if the library is not available.
+   */
+  [[nodiscard]] static std::shared_ptr<cslibs::disc::DiscDb> OpenDiscDbReader();
+  /** @copydoc OpenDiscDbReader() */
+  [[nodiscard]] static std::shared_ptr<cslibs::effect::EffectDb> OpenEffectDbReader();
+  /** @copydoc OpenDiscDbReader() */
+  [[nodiscard]] static std::shared_ptr<cslibs::gel::GelDb> OpenGelDbReader();
+  /** @copydoc OpenDiscDbReader() */
+  [[nodiscard]] static std::shared_ptr<cslibs::gobo::GoboDb> OpenGoboDbReader();
+
+  /**
+   * Get read-only connections to the disc library for use off the GUI thread.
+   *
+   * Queries from dialogs should use these instead of the writer, so SQLite and image decoding never block the GUI.
+   *
+   * @return The connections, or nullptr if the library is not available.
+   */
+  [[nodiscard]] static std::shared_ptr<cslibs::AsyncDb<cslibs::ImageDb>> GetAsyncDiscDb();
+  /** @copydoc GetAsyncDiscDb() */
+  [[nodiscard]] static std::shared_ptr<cslibs::AsyncDb<cslibs::ImageDb>> GetAsyncEffectDb();
+  /** @copydoc GetAsyncDiscDb() */
+  [[nodiscard]] static std::shared_ptr<cslibs::AsyncDb<cslibs::gel::GelDb>> GetAsyncGelDb();
+  /** @copydoc GetAsyncDiscDb() */
+  [[nodiscard]] static std::shared_ptr<cslibs::AsyncDb<cslibs::ImageDb>> GetAsyncGoboDb();
+
+  /**
+   * Get the asynchronous connections to the libraries used by the dcid resolver, in the resolver's order.
+   *
+   * Use with cslibs::DcidResolver::Resolve() to load images off the GUI thread.
+   *
+   * @return Libraries that are not available are nullptr.
+   */
+  [[nodiscard]] static std::vector<std::shared_ptr<cslibs::AsyncDb<cslibs::ImageDb>>> GetAsyncImageLibraries();
+
+  /**
+   * Get the resolver for dcids in the disc, effect, and gobo libraries.
+   *
+   * Loaded in the background, starting on first use; reloaded by LibrariesUpdated().
+   *
+   * @return The resolver, or nullptr if it has not been loaded (yet).
+   */
+  [[nodiscard]] static std::shared_ptr<cslibs::DcidResolver> GetDcidResolver();
+
+  /**
+   * Start (re)loading the dcid resolver from the libraries.
+   *
+   * The dcids are read on a worker thread; GetDcidResolver() returns the new resolver once they have been read.  Call
+   * from the GUI thread.
+   */
+  static void LoadDcidResolver();
+
+  /**
+   * Stop using connections opened before the libraries were updated, and reload the dcid resolver.
+   *
+   * Pooled connections keep caches of the old contents.  Call from the GUI thread once an update has finished.
+   */
+  static void LibrariesUpdated();
+
+  /**
+   * Get the object that announces background changes, e.g. when the dcid resolver has loaded.
+   */
+  [[nodiscard]] static EtcCsPersEditBridgeNotifier *GetNotifier();
+
  private:
   static const QStringList kImagesDataPaths;
   static const QStringList kImagesIndexPaths;
@@ -78,9 +175,19 @@ class EtcCsPersEditBridge {
   static const QStringList kEffectsPaths;
   static const QStringList kGelsPaths;
   static const QStringList kGobosPaths;
+  static std::shared_ptr<cslibs::DcidResolver> dcid_resolver_;
+  /** Incremented each time the resolver is reloaded, so only the latest load is used */
+  static unsigned int dcid_resolver_generation_;
+  /** Close the pooled connections of each asynchronous library, see LibrariesUpdated() */
+  static std::vector<std::function<void()>> async_db_pool_clearers_;
 
   [[nodiscard]] static std::optional<QString> GetFirstExistentPath(const QDir &root, const QStringList &paths);
   [[nodiscard]] static QString GetDbPath(const QString &filename);
+  /**
+   * Threads shared by all asynchronous library queries
+   * @return
+   */
+  [[nodiscard]] static std::shared_ptr<cslibs::WorkerPool> GetWorkerPool();
 
   template<class T, typename = std::enable_if_t<std::is_base_of_v<cslibs::ImageDb, T>>>
   static std::shared_ptr<T> GetImageDb(const std::optional<QString> &defs_path, const QString &db_path) {
@@ -92,11 +199,17 @@ class EtcCsPersEditBridge {
         return {};
       }
       try {
-        db = std::make_shared<T>(defs_path->toStdString(),
-                                 data_index_path->toStdString(),
-                                 data_path->toStdString(),
-                                 db_path.toStdString(),
-                                 true);
+        auto new_db = std::make_shared<T>(defs_path->toStdString(),
+                                          data_index_path->toStdString(),
+                                          data_path->toStdString(),
+                                          db_path.toStdString(),
+                                          true);
+        new_db->Migrate();
+        // The data file is part of the official editor's installation, so don't copy it.  If the installation moves,
+        // the next update copies the images instead.
+        new_db->SetImageStorage(cslibs::ImageDb::ImageStorage::kReference);
+        new_db->SetThumbnailRenderer(&ThumbnailCache::Render);
+        db = std::move(new_db);
       } catch (const cslibs::except::DefsError &e) {
         csprofile::logging::warn("Failed to get db: {}", e.what());
         return {};
@@ -122,9 +235,11 @@ class EtcCsPersEditBridge {
         return {};
       }
       try {
-        db = std::make_shared<T>(defs_path->toStdString(),
-                                 db_path.toStdString(),
-                                 true);
+        auto new_db = std::make_shared<T>(defs_path->toStdString(),
+                                          db_path.toStdString(),
+                                          true);
+        new_db->Migrate();
+        db = std::move(new_db);
       } catch (const cslibs::except::DefsError &e) {
         csprofile::logging::warn("Failed to get db: {}", e.what());
         return {};
@@ -141,6 +256,77 @@ class EtcCsPersEditBridge {
 
     return db;
   }
+
+  /**
+   * Make sure the writer for the database exists.  It creates and upgrades the database, so readers need it first.
+   * @return FALSE if the database is not available.
+   */
+  template<class T, typename = std::enable_if_t<std::is_base_of_v<cslibs::Db, T>>>
+  static bool HasWriter(const std::optional<QString> &defs_path, const QString &db_path) {
+    if constexpr (std::is_base_of_v<cslibs::ImageDb, T>) {
+      return GetImageDb<T>(defs_path, db_path) != nullptr;
+    } else {
+      return GetDb<T>(defs_path, db_path) != nullptr;
+    }
+  }
+
+  /**
+   * Get a function that opens read-only connections.  Call HasWriter() first.
+   *
+   * The function doesn't use any Qt classes, so it can be called from any thread.
+   */
+  template<class T, typename = std::enable_if_t<std::is_base_of_v<cslibs::Db, T>>>
+  static std::function<std::unique_ptr<T>()> GetReaderFactory(const QString &defs_path, const QString &db_path) {
+    if constexpr (std::is_base_of_v<cslibs::ImageDb, T>) {
+      return [defs_path = defs_path.toStdString(),
+          data_index_path = GetCsEditImagesIndexPath()->toStdString(),
+          data_path = GetCsEditImagesDataPath()->toStdString(),
+          db_path = db_path.toStdString()]() {
+        return std::make_unique<T>(defs_path, data_index_path, data_path, db_path);
+      };
+    } else {
+      return [defs_path = defs_path.toStdString(), db_path = db_path.toStdString()]() {
+        return std::make_unique<T>(defs_path, db_path);
+      };
+    }
+  }
+
+  template<class T, typename = std::enable_if_t<std::is_base_of_v<cslibs::Db, T>>>
+  static std::shared_ptr<T> OpenReader(const std::optional<QString> &defs_path, const QString &db_path) {
+    if (!HasWriter<T>(defs_path, db_path)) {
+      return {};
+    }
+    try {
+      return GetReaderFactory<T>(*defs_path, db_path)();
+    } catch (const cslibs::except::DefsError &e) {
+      csprofile::logging::warn("Failed to get db: {}", e.what());
+    } catch (const cslibs::except::DbError &e) {
+      csprofile::logging::warn("Failed to get db: {}", e.what());
+    } catch (const SQLite::Exception &e) {
+      csprofile::logging::warn("Database error: {}", e.what());
+    }
+    return {};
+  }
+
+  /**
+   * @tparam T Database to open
+   * @tparam Base Type the queries use
+   */
+  template<class T, class Base = T, typename = std::enable_if_t<std::is_base_of_v<Base, T>>>
+  static std::shared_ptr<cslibs::AsyncDb<Base>> GetAsyncDb(const std::optional<QString> &defs_path,
+                                                           const QString &db_path) {
+    static std::shared_ptr<cslibs::AsyncDb<Base>> async_db;
+    if (!async_db) {
+      if (!HasWriter<T>(defs_path, db_path)) {
+        return {};
+      }
+      auto pool = std::make_shared<cslibs::DbPool<T>>(GetReaderFactory<T>(*defs_path, db_path));
+      async_db_pool_clearers_.emplace_back([pool]() { pool->Clear(); });
+      async_db = std::make_shared<cslibs::AsyncDb<Base>>(std::move(pool), GetWorkerPool());
+    }
+
+    return async_db;
+  }
 };
 
 } // csprofileeditor
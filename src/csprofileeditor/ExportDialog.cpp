@@ -8,6 +8,7 @@
 
 #include "ExportDialog.h"
 #include <QVBoxLayout>
+#include <QMessageBox>
 #include <utility>
 #include <QPushButton>
 
@@ -356,7 +357,18 @@ void ExportDialog::accept() {
 
   QDir output_path(field("drive").value<QStorageInfo>().rootPath());
   // ColorSource console looks for a file with this name in the root of the drive.
-  output.Save(output_path.absoluteFilePath("userlib.jlib").toStdString());
+  const QString output_file_path = output_path.absoluteFilePath("userlib.jlib");
+  try {
+    // Nobody reads this copy, so skip the indentation.
+    output.Save(output_file_path.toStdString(), csprofile::Library::Format::kCompact);
+  } catch (const std::runtime_error &e) {
+    // Leave the wizard open to allow another try.
+    QMessageBox::critical(this,
+                          tr("Error saving file"),
+                          tr("The file %1 cannot be written.  Be sure the drive is still connected and not full.")
+                              .arg(output_file_path));
+    return;
+  }
 
   QWizard::accept();
 }
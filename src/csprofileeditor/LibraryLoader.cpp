@@ -0,0 +1,48 @@
+/**
+ * @file LibraryLoader.cpp
+ *
+ * @author dankeenan
+ * @date 5/16/21
+ * @copyright (c) 2021 Dan Keenan
+ */
+
+#include "LibraryLoader.h"
+#include <csprofile/except.h>
+#include <csprofile/logging.h>
+
+namespace csprofileeditor {
+
+LibraryLoader::~LibraryLoader() {
+  Cancel();
+  wait();
+}
+
+void LibraryLoader::run() {
+  // Only report whole percentages, so a file with many small personalities doesn't flood the GUI thread.
+  unsigned long last_percent = 0;
+  try {
+    library_ = std::make_shared<csprofile::Library>(
+        path_.toStdString(),
+        [this, &last_percent](unsigned long current, unsigned long total) {
+          const auto percent = total > 0
+                               ? static_cast<unsigned long>(static_cast<double>(current) / static_cast<double>(total)
+                                                                * 100.0)
+                               : 0;
+          if (percent != last_percent) {
+            last_percent = percent;
+            Q_EMIT(ZProgressChanged(current, total));
+          }
+          return !cancelled_;
+        });
+    result_ = Result::kLoaded;
+  } catch (const csprofile::except::LoadCancelled &e) {
+    result_ = Result::kCancelled;
+  } catch (const csprofile::except::ParseError &e) {
+    result_ = Result::kInvalid;
+  } catch (const std::exception &e) {
+    csprofile::logging::error(e.what());
+    result_ = Result::kUnreadable;
+  }
+}
+
+} // csprofileeditor
@@ -0,0 +1,76 @@
+/**
+ * @file LibraryLoader.h
+ *
+ * @author dankeenan
+ * @date 5/16/21
+ * @copyright (c) 2021 Dan Keenan
+ */
+
+#ifndef CSPROFILEEDITOR_SRC_CSPROFILEEDITOR_LIBRARYLOADER_H_
+#define CSPROFILEEDITOR_SRC_CSPROFILEEDITOR_LIBRARYLOADER_H_
+
+#include <QThread>
+#include <atomic>
+#include <memory>
+#include <csprofile/Library.h>
+
+namespace csprofileeditor {
+
+/**
+ * Worker thread to load a library file.
+ *
+ * Emits ZProgressChanged as the file is read; check GetResult() once the thread has finished.
+ */
+class LibraryLoader final : public QThread {
+ Q_OBJECT
+ public:
+  enum class Result {
+    kLoaded,
+    kCancelled,
+    /** The file is not a valid library */
+    kInvalid,
+    /** The file cannot be read */
+    kUnreadable,
+  };
+
+  explicit LibraryLoader(QString path, QObject *parent = nullptr) : QThread(parent), path_(std::move(path)) {}
+  ~LibraryLoader() final;
+
+  [[nodiscard]] const QString &GetPath() const {
+    return path_;
+  }
+
+  [[nodiscard]] Result GetResult() const {
+    return result_;
+  }
+
+  /**
+   * Get the loaded library; only set when the result is kLoaded.
+   */
+  [[nodiscard]] std::shared_ptr<csprofile::Library> GetLibrary() const {
+    return library_;
+  }
+
+ public Q_SLOTS:
+  /**
+   * Stop loading as soon as possible.  Safe to call from any thread.
+   */
+  void Cancel() {
+    cancelled_ = true;
+  }
+
+ Q_SIGNALS:
+  void ZProgressChanged(unsigned long current, unsigned long total);
+
+ private:
+  QString path_;
+  std::atomic_bool cancelled_ = false;
+  Result result_ = Result::kCancelled;
+  std::shared_ptr<csprofile::Library> library_;
+
+  void run() final;
+};
+
+} // csprofileeditor
+
+#endif //CSPROFILEEDITOR_SRC_CSPROFILEEDITOR_LIBRARYLOADER_H_
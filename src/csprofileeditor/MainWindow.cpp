@@ -16,7 +16,9 @@
 #include <QMessageBox>
 #include <QApplication>
 #include <QFileDialog>
-#include <csprofile/except.h>
+#include <QFileInfo>
+#include <QProgressDialog>
+#include <cmath>
 #include "EtcCsPersEditBridge.h"
 #include "PersonalityEditDialog.h"
 #include "ExportDialog.h"
@@ -49,10 +51,15 @@ MainWindow::MainWindow(QWidget *parent)
   if (!CsLibUpdater::UpToDate()) {
     auto *updater = new CsLibUpdater(this);
     connect(updater, &CsLibUpdater::rejected, qApp, &QApplication::quit, Qt::QueuedConnection);
+    connect(updater, &CsLibUpdater::accepted, this, &EtcCsPersEditBridge::LibrariesUpdated);
     connect(updater, &CsLibUpdater::finished, updater, &CsLibUpdater::deleteLater);
     updater->setModal(true);
     updater->open();
+  } else {
+    EtcCsPersEditBridge::LoadDcidResolver();
   }
+
+  RecoverAutosave();
 }
 
 void MainWindow::InitActions() {
@@ -168,6 +175,7 @@ void MainWindow::InitUi() {
   widgets_.personality_table->addAction(actions_.act_edit_personality);
   widgets_.personality_table->addAction(actions_.act_delete_personality);
   widgets_.personality_table->addAction(actions_.act_add_personality);
+  autosaver_ = new Autosaver(personality_table_model_, this);
   connect(personality_table_model_, &PersonalityTableModel::dataChanged, this, &MainWindow::SPersonalityChanged);
   connect(personality_table_model_, &PersonalityTableModel::rowsInserted, this, &MainWindow::SPersonalityChanged);
   connect(personality_table_model_, &PersonalityTableModel::rowsRemoved, this, &MainWindow::SPersonalityChanged);
@@ -198,29 +206,108 @@ bool MainWindow::AskAboutUnsavedData() {
   return true;
 }
 
+void MainWindow::RecoverAutosave() {
+  if (autosaver_->HasRecoveryData()) {
+    const auto recover_choice =
+        QMessageBox::question(this,
+                              tr("Recover unsaved changes"),
+                              tr("The editor did not shut down properly.  Do you want to recover unsaved changes?"));
+    if (recover_choice == QMessageBox::Yes) {
+      auto recovered = autosaver_->Recover();
+      if (recovered.has_value()) {
+        library_ = std::move(recovered->library);
+        personality_table_model_->SetLibrary(library_);
+        widgets_.personality_table->resizeColumnsToContents();
+        setWindowFilePath(recovered->path);
+        // The changes still need to be saved.
+        setWindowModified(true);
+        actions_.act_file_export->setEnabled(ExportingAllowed());
+        return;
+      }
+      QMessageBox::critical(this,
+                            tr("Error recovering changes"),
+                            tr("The unsaved changes could not be recovered."));
+    }
+  }
+  autosaver_->Start(library_, {});
+}
+
 void MainWindow::OpenFrom(const QString &path) {
-  try {
-    library_.reset(new csprofile::Library(path.toStdString()));
-    setWindowFilePath(path);
-    personality_table_model_->SetLibrary(library_);
-    widgets_.personality_table->resizeColumnsToContents();
-    setWindowModified(false);
-    AddPathToRecentDocuments(path);
-    actions_.act_file_export->setEnabled(ExportingAllowed());
-  } catch (const csprofile::except::ParseError &e) {
-    QMessageBox::critical(this,
-                          tr("Error opening file"),
-                          tr("The file %1 is not valid.  Either it is not a library file or is corrupted.").arg(path));
-  } catch (const std::runtime_error &e) {
-    QMessageBox::critical(this,
-                          tr("Error opening file"),
-                          tr("The file %1 cannot be read.  Be sure the file is still accessible.").arg(path));
+  if (loader_) {
+    // The newest request wins.
+    loader_->Cancel();
+  }
+  auto *loader = new LibraryLoader(path, this);
+  loader_ = loader;
+  // The progress dialog may not appear right away, so nothing else can be done in the meantime.
+  SetLoading(true);
+
+  auto *progress_dialog = new QProgressDialog(tr("Opening %1...").arg(QFileInfo(path).fileName()),
+                                              tr("Cancel"),
+                                              0,
+                                              100,
+                                              this);
+  progress_dialog->setWindowModality(Qt::WindowModal);
+  progress_dialog->setAutoClose(false);
+  progress_dialog->setAutoReset(false);
+  // Small files open without showing the dialog at all.
+  progress_dialog->setMinimumDuration(500);
+  progress_dialog->setValue(0);
+  connect(loader,
+          &LibraryLoader::ZProgressChanged,
+          progress_dialog,
+          [progress_dialog](unsigned long current, unsigned long total) {
+            progress_dialog->setValue(static_cast<int>(std::floor(
+                static_cast<double>(current) / static_cast<double>(total) * 100.0)));
+          },
+          Qt::QueuedConnection);
+  connect(progress_dialog, &QProgressDialog::canceled, loader, &LibraryLoader::Cancel);
+  connect(loader, &LibraryLoader::finished, this, [this, loader, progress_dialog]() {
+    progress_dialog->deleteLater();
+    loader->deleteLater();
+    if (loader == loader_) {
+      loader_ = nullptr;
+      OpenFinished(*loader);
+      SetLoading(false);
+    }
+  });
+  loader->start();
+}
+
+void MainWindow::OpenFinished(const LibraryLoader &loader) {
+  const QString &path = loader.GetPath();
+  switch (loader.GetResult()) {
+    case LibraryLoader::Result::kLoaded:
+      library_ = loader.GetLibrary();
+      setWindowFilePath(path);
+      personality_table_model_->SetLibrary(library_);
+      autosaver_->Start(library_, path);
+      widgets_.personality_table->resizeColumnsToContents();
+      setWindowModified(false);
+      AddPathToRecentDocuments(path);
+      actions_.act_file_export->setEnabled(ExportingAllowed());
+      break;
+    case LibraryLoader::Result::kCancelled:
+      // Keep the library that was already open.
+      break;
+    case LibraryLoader::Result::kInvalid:
+      QMessageBox::critical(this,
+                            tr("Error opening file"),
+                            tr("The file %1 is not valid.  Either it is not a library file or is corrupted.").arg(path));
+      break;
+    case LibraryLoader::Result::kUnreadable:
+      QMessageBox::critical(this,
+                            tr("Error opening file"),
+                            tr("The file %1 cannot be read.  Be sure the file is still accessible.").arg(path));
+      break;
   }
 }
 
 void MainWindow::SaveTo(const QString &path) {
   try {
     library_->Save(path.toStdString());
+    // The file now has all changes.
+    autosaver_->Start(library_, path);
     setWindowFilePath(path);
     setWindowModified(false);
     AddPathToRecentDocuments(path);
@@ -268,12 +355,24 @@ void MainWindow::UpdateRecentDocuments() {
   }
 }
 
+void MainWindow::SetLoading(bool loading) {
+  // Changes made now would be lost when the library that is loading replaces this one.
+  widgets_.personality_table->setEnabled(!loading);
+  actions_.act_file_new->setEnabled(!loading);
+  actions_.act_file_save->setEnabled(!loading);
+  actions_.act_file_saveas->setEnabled(!loading);
+  actions_.act_add_personality->setEnabled(!loading);
+  actions_.act_file_export->setEnabled(ExportingAllowed());
+  SSelectedTableRowChanged();
+}
+
 bool MainWindow::PersonalityActionsAllowed() const {
-  return widgets_.personality_table != nullptr && widgets_.personality_table->selectionModel()->hasSelection();
+  return !loader_ && widgets_.personality_table != nullptr
+      && widgets_.personality_table->selectionModel()->hasSelection();
 }
 
 bool MainWindow::ExportingAllowed() const {
-  return !library_->personalities.empty();
+  return !loader_ && !library_->personalities.empty();
 }
 
 void MainWindow::closeEvent(QCloseEvent *event) {
@@ -281,6 +380,8 @@ void MainWindow::closeEvent(QCloseEvent *event) {
     event->ignore();
     return;
   }
+  // Changes were either saved or deliberately discarded.
+  autosaver_->Discard();
   Settings::SetMainWindowGeometry(saveGeometry());
   event->accept();
 }
@@ -290,7 +391,11 @@ void MainWindow::SFileNew() {
     return;
   }
   library_.reset(new csprofile::Library);
+  personality_table_model_->SetLibrary(library_);
+  autosaver_->Start(library_, {});
   setWindowFilePath({});
+  setWindowModified(false);
+  actions_.act_file_export->setEnabled(ExportingAllowed());
 }
 
 void MainWindow::SFileOpen() {
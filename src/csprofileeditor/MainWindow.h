@@ -10,8 +10,11 @@
 #define CS_PROFILE_EDITOR_SRC_CSPROFILEEDITOR_MAINWINDOW_H_
 
 #include <QMainWindow>
+#include <QPointer>
 #include <csprofile/Library.h>
 #include <QTableView>
+#include "Autosaver.h"
+#include "LibraryLoader.h"
 #include "PersonalityTableModel.h"
 
 namespace csprofileeditor {
@@ -54,6 +57,9 @@ class MainWindow : public QMainWindow {
   };
   Widgets widgets_;
   PersonalityTableModel *personality_table_model_ = nullptr;
+  Autosaver *autosaver_ = nullptr;
+  /** Library file being opened, if any */
+  QPointer<LibraryLoader> loader_;
 
   std::shared_ptr<csprofile::Library> library_;
 
@@ -71,7 +77,19 @@ class MainWindow : public QMainWindow {
    * @return TRUE if the action should continue, FALSE for cancelled.
    */
   bool AskAboutUnsavedData();
+  /**
+   * Offer to recover changes left behind by a session that didn't shut down cleanly.
+   */
+  void RecoverAutosave();
+  /**
+   * Start loading @p path in the background; the library is shown once it has loaded.
+   */
   void OpenFrom(const QString &path);
+  void OpenFinished(const LibraryLoader &loader);
+  /**
+   * Turn editing off while a library is loading and back on once it is done.
+   */
+  void SetLoading(bool loading);
   void SaveTo(const QString &path);
   void AddPathToRecentDocuments(const QString &path);
   void UpdateRecentDocuments();
@@ -0,0 +1,212 @@
+/**
+ * @file MediaSearchDialog.cpp
+ *
+ * @author dankeenan
+ * @date 5/16/21
+ * @copyright (c) 2021 Dan Keenan
+ */
+
+#include "MediaSearchDialog.h"
+#include <QDialogButtonBox>
+#include <QHeaderView>
+#include <QVBoxLayout>
+#include "AsyncQuery.h"
+#include "EtcCsPersEditBridge.h"
+
+namespace csprofileeditor {
+
+MediaSearchModel::MediaSearchModel(QStringList library_names, QObject *parent) :
+    QAbstractTableModel(parent), library_names_(std::move(library_names)) {
+}
+
+int MediaSearchModel::rowCount(const QModelIndex &parent) const {
+  return results_.size();
+}
+
+int MediaSearchModel::columnCount(const QModelIndex &parent) const {
+  return kColumnCount;
+}
+
+QVariant MediaSearchModel::headerData(int section, Qt::Orientation orientation, int role) const {
+  if (role != Qt::DisplayRole || orientation != Qt::Horizontal) {
+    return {};
+  }
+
+  const auto column = static_cast<Column>(section);
+  switch (column) {
+    case Column::kLibrary:return tr("Library");
+    case Column::kCode:return tr("Code");
+    case Column::kName:return tr("Name");
+    case Column::kManufacturer:return tr("Manufacturer");
+    case Column::kSeries:return tr("Series");
+  }
+
+  return {};
+}
+
+QVariant MediaSearchModel::data(const QModelIndex &index, int role) const {
+  if (role != Qt::DisplayRole) {
+    return {};
+  }
+
+  const auto &[library, result] = results_.at(index.row());
+  const auto column = static_cast<Column>(index.column());
+  switch (column) {
+    case Column::kLibrary:return library_names_.value(static_cast<int>(library));
+    case Column::kCode:return QString::fromStdString(result.code);
+    case Column::kName:return QString::fromStdString(result.name);
+    case Column::kManufacturer:return QString::fromStdString(result.manufacturer);
+    case Column::kSeries:return QString::fromStdString(result.series);
+  }
+
+  return {};
+}
+
+void MediaSearchModel::SetResults(Results results) {
+  beginResetModel();
+  results_ = std::move(results);
+  endResetModel();
+}
+
+namespace {
+
+std::shared_ptr<cslibs::AsyncDb<cslibs::Db>> ToAsyncDb(const std::shared_ptr<cslibs::AsyncDb<cslibs::ImageDb>> &db) {
+  return db ? std::make_shared<cslibs::AsyncDb<cslibs::Db>>(*db) : nullptr;
+}
+
+} // namespace
+
+MediaSearchDialog::MediaSearchDialog(QWidget *parent) :
+    QDialog(parent),
+    // Read-only connections on worker threads, so searching never blocks the GUI or waits for a library update.
+    gel_db_(EtcCsPersEditBridge::GetAsyncGelDb()),
+    dbs_{
+        ToAsyncDb(EtcCsPersEditBridge::GetAsyncDiscDb()),
+        ToAsyncDb(EtcCsPersEditBridge::GetAsyncEffectDb()),
+        gel_db_ ? std::make_shared<cslibs::AsyncDb<cslibs::Db>>(*gel_db_) : nullptr,
+        ToAsyncDb(EtcCsPersEditBridge::GetAsyncGoboDb()),
+    },
+    search_(new QLineEdit(this)),
+    table_(new QTableView(this)),
+    model_(new MediaSearchModel({tr("Disc"), tr("Effect"), tr("Gel"), tr("Gobo")}, this)) {
+  setWindowTitle(tr("Search Media"));
+  resize(640, 480);
+  auto *layout = new QVBoxLayout(this);
+
+  // Search
+  search_->setPlaceholderText(tr("Search"));
+  search_->setClearButtonEnabled(true);
+  layout->addWidget(search_);
+  connect(search_, &QLineEdit::textChanged, this, &MediaSearchDialog::SSearch);
+
+  // Results
+  table_->setModel(model_);
+  table_->setSelectionMode(QTableView::SingleSelection);
+  table_->setSelectionBehavior(QTableView::SelectRows);
+  table_->horizontalHeader()->setStretchLastSection(true);
+  layout->addWidget(table_);
+  connect(table_->selectionModel(), &QItemSelectionModel::selectionChanged,
+          this, &MediaSearchDialog::SSelectionChanged);
+  connect(table_, &QTableView::doubleClicked, this, &MediaSearchDialog::SAccept);
+
+  // Actions
+  auto *actions = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, this);
+  connect(actions, &QDialogButtonBox::accepted, this, &MediaSearchDialog::SAccept);
+  connect(actions, &QDialogButtonBox::rejected, this, &MediaSearchDialog::reject);
+  layout->addWidget(actions);
+}
+
+MediaSearchDialog::~MediaSearchDialog() {
+  search_token_.Cancel();
+  selection_token_.Cancel();
+}
+
+void MediaSearchDialog::SSearch(const QString &query) {
+  // Results for the old query are no longer wanted.
+  search_token_.Cancel();
+  search_token_ = cslibs::CancelToken();
+
+  // Results from each library are merged once they have all arrived.
+  struct PendingSearch {
+    std::vector<std::vector<cslibs::Db::SearchResult>> results;
+    std::size_t remaining = 0;
+  };
+  auto pending = std::make_shared<PendingSearch>();
+  pending->results.resize(dbs_.size());
+  for (const auto &db : dbs_) {
+    if (db) {
+      ++pending->remaining;
+    }
+  }
+  if (pending->remaining == 0) {
+    model_->SetResults({});
+    return;
+  }
+
+  for (std::size_t library = 0; library < dbs_.size(); ++library) {
+    if (!dbs_[library]) {
+      continue;
+    }
+    const auto finish = [this, pending, library](std::vector<cslibs::Db::SearchResult> results) {
+      pending->results[library] = std::move(results);
+      if (--pending->remaining == 0) {
+        model_->SetResults(cslibs::Db::MergeSearchResults(std::move(pending->results), kMaxResults));
+      }
+    };
+    RunQuery(*dbs_[library], this, search_token_,
+             [query = query.toStdString()](cslibs::Db &db) { return db.Search(query, kMaxResults); },
+             finish,
+             // Show what the other libraries found.
+             [finish]() { finish({}); });
+  }
+}
+
+void MediaSearchDialog::SSelectionChanged() {
+  selection_token_.Cancel();
+  selection_token_ = cslibs::CancelToken();
+  selection_pending_ = false;
+  media_.reset();
+  const QItemSelection selection = table_->selectionModel()->selection();
+  if (selection.empty()) {
+    return;
+  }
+
+  const auto &[library, result] = model_->GetResult(selection.first().top());
+  csprofile::parameter::Media media;
+  media.SetName(result.name);
+  if (library != kGelLibrary) {
+    media.SetGoboDcid(result.dcid);
+    media_ = std::move(media);
+    return;
+  }
+
+  // Gels need their color, which isn't part of the search result.
+  selection_pending_ = true;
+  const auto finish = [this, media = std::move(media)](const std::optional<cslibs::gel::Gel> &gel) mutable {
+    selection_pending_ = false;
+    if (gel.has_value()) {
+      media.SetRgb(gel->GetArgb());
+      media_ = std::move(media);
+    }
+    if (accept_pending_) {
+      accept_pending_ = false;
+      accept();
+    }
+  };
+  RunQuery(*gel_db_, this, selection_token_,
+           [id = result.id](cslibs::gel::GelDb &db) { return db.GetGelForId(id); },
+           finish,
+           // Still finish, so accepting isn't held up.
+           [finish]() mutable { finish(std::nullopt); });
+}
+
+void MediaSearchDialog::SAccept() {
+  if (selection_pending_) {
+    // Finish loading the selection first.
+    accept_pending_ = true;
+    return;
+  }
+  accept();
+}
+
+} // csprofileeditor
@@ -0,0 +1,104 @@
+/**
+ * @file MediaSearchDialog.h
+ *
+ * @author dankeenan
+ * @date 5/16/21
+ * @copyright (c) 2021 Dan Keenan
+ */
+
+#ifndef CSPROFILEEDITOR_SRC_CSPROFILEEDITOR_MEDIASEARCHDIALOG_H_
+#define CSPROFILEEDITOR_SRC_CSPROFILEEDITOR_MEDIASEARCHDIALOG_H_
+
+#include <QAbstractTableModel>
+#include <QDialog>
+#include <QLineEdit>
+#include <QPushButton>
+#include <QTableView>
+#include <cslibs/AsyncDb.h>
+#include <cslibs/Db.h>
+#include <cslibs/gel/GelDb.h>
+#include <csprofile/parameter/Media.h>
+
+namespace csprofileeditor {
+
+/**
+ * Model class for MediaSearchDialog
+ */
+class MediaSearchModel final : public QAbstractTableModel {
+ Q_OBJECT
+ public:
+  using Results = std::vector<std::pair<std::size_t, cslibs::Db::SearchResult>>;
+
+  /**
+   * @param library_names Name of each library searched, in the same order as the results' library index.
+   * @param parent
+   */
+  explicit MediaSearchModel(QStringList library_names, QObject *parent = nullptr);
+
+  enum class Column {
+    kLibrary = 0,
+    kCode,
+    kName,
+    kManufacturer,
+    kSeries,
+  };
+  static inline const auto kColumnCount = static_cast<unsigned int>(Column::kSeries) + 1;
+
+  [[nodiscard]] int rowCount(const QModelIndex &parent) const final;
+  [[nodiscard]] int columnCount(const QModelIndex &parent) const final;
+  [[nodiscard]] QVariant headerData(int section, Qt::Orientation orientation, int role) const final;
+  [[nodiscard]] QVariant data(const QModelIndex &index, int role) const final;
+
+  void SetResults(Results results);
+
+  [[nodiscard]] const Results::value_type &GetResult(int row) const {
+    return results_.at(row);
+  }
+
+ private:
+  QStringList library_names_;
+  Results results_;
+};
+
+/**
+ * Search every media library at once
+ */
+class MediaSearchDialog : public QDialog {
+ Q_OBJECT
+ public:
+  explicit MediaSearchDialog(QWidget *parent = nullptr);
+  ~MediaSearchDialog() override;
+
+  [[nodiscard]] const std::optional<csprofile::parameter::Media> &GetMedia() const {
+    return media_;
+  }
+
+ private:
+  static inline const std::size_t kMaxResults = 200;
+  /** Index of the gel library in dbs_ */
+  static inline const std::size_t kGelLibrary = 2;
+  std::shared_ptr<cslibs::AsyncDb<cslibs::gel::GelDb>> gel_db_;
+  /** Searched libraries; some may be missing. */
+  std::vector<std::shared_ptr<cslibs::AsyncDb<cslibs::Db>>> dbs_;
+  std::optional<csprofile::parameter::Media> media_;
+  /** Cancelled when the query changes or the dialog is destroyed */
+  cslibs::CancelToken search_token_;
+  /** Cancelled when the selection changes or the dialog is destroyed */
+  cslibs::CancelToken selection_token_;
+  /** TRUE while the selected gel's color is loading */
+  bool selection_pending_ = false;
+  /** Accept once the selection has loaded */
+  bool accept_pending_ = false;
+  QLineEdit *search_;
+  QTableView *table_;
+  MediaSearchModel *model_;
+
+ private Q_SLOTS:
+  void SSearch(const QString &query);
+  void SSelectionChanged();
+  void SAccept();
+};
+
+} // csprofileeditor
+
+#endif //CSPROFILEEDITOR_SRC_CSPROFILEEDITOR_MEDIASEARCHDIALOG_H_
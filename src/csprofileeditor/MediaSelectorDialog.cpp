@@ -7,29 +7,49 @@
  */
 
 #include "MediaSelectorDialog.h"
+#include <QHBoxLayout>
 #include <QVBoxLayout>
 #include <QTabWidget>
 #include <utility>
 #include <QDialogButtonBox>
+#include <QLabel>
 #include <QColor>
+#include <QPointer>
+#include <algorithm>
+#include <iterator>
+#include "ThumbnailCache.h"
 
 namespace csprofileeditor {
 
-MediaSelectorDialog::MediaSelectorDialog(const std::shared_ptr<cslibs::Db> &db, QWidget *parent)
-    : QDialog(parent), db_(db) {
+MediaSelectorDialog::MediaSelectorDialog(std::shared_ptr<cslibs::AsyncDb<cslibs::Db>> db, QWidget *parent)
+    : QDialog(parent), db_(std::move(db)) {
   resize(640, 480);
 }
 
+MediaSelectorDialog::~MediaSelectorDialog() {
+  token_.Cancel();
+}
+
 void MediaSelectorDialog::Init() {
   auto *layout = new QVBoxLayout(this);
 
-  // Tabs
+  // Tabs are only filled in when first shown, so opening the dialog only loads the first series.
   auto *tabs = new QTabWidget(this);
   layout->addWidget(tabs);
   if (db_) {
-    for (const auto &manufacturer : db_->GetManufacturers()) {
-      tabs->addTab(CreateSeriesWidget(manufacturer), QString::fromStdString(manufacturer.GetName()));
-    }
+    RunQuery(*db_, tabs, token_,
+             [](cslibs::Db &db) { return db.GetManufacturers(); },
+             [this, tabs](const std::vector<cslibs::Manufacturer> &manufacturers) {
+               for (const auto &manufacturer : manufacturers) {
+                 auto *page = new LazyWidget([this, manufacturer](QWidget *parent) {
+                   return CreateSeriesWidget(manufacturer, parent);
+                 }, tabs);
+                 tabs->addTab(page, QString::fromStdString(manufacturer.GetName()));
+               }
+             },
+             [tabs]() {
+               tabs->addTab(new QLabel(tr("The media library could not be read."), tabs), tr("Error"));
+             });
   }
 
   // Actions
@@ -39,21 +59,50 @@ void MediaSelectorDialog::Init() {
   layout->addWidget(actions);
 }
 
-QWidget *MediaSelectorDialog::CreateSeriesWidget(const cslibs::Manufacturer &manufacturer) {
-  const auto series_for_manufacturer = db_->GetSeriesForManufacturer(manufacturer);
+QWidget *MediaSelectorDialog::CreateSeriesWidget(const cslibs::Manufacturer &manufacturer, QWidget *parent) {
+  auto *container = new QWidget(parent);
+  auto *layout = new QVBoxLayout(container);
+  layout->setContentsMargins(0, 0, 0, 0);
+  RunQuery(*db_, container, token_,
+           [manufacturer](cslibs::Db &db) { return db.GetSeriesForManufacturer(manufacturer); },
+           [this, manufacturer, container](const std::vector<cslibs::Series> &series_for_manufacturer) {
+             container->layout()->addWidget(CreateSeriesTabs(manufacturer, series_for_manufacturer, container));
+           },
+           [container]() {
+             container->layout()->addWidget(new QLabel(tr("The media library could not be read."), container));
+           });
+  return container;
+}
+
+QWidget *MediaSelectorDialog::CreateSeriesTabs(const cslibs::Manufacturer &manufacturer,
+                                               const std::vector<cslibs::Series> &series_for_manufacturer,
+                                               QWidget *parent) {
   if (series_for_manufacturer.empty()) {
-    return new QWidget(this);
+    return new QWidget(parent);
   } else if (series_for_manufacturer.size() == 1) {
-    MediaSelectorWidget *widget = this->CreateSelectorWidget(manufacturer, series_for_manufacturer.front());
+    MediaSelectorWidget *widget = this->CreateSelectorWidget(manufacturer, series_for_manufacturer.front(), parent);
     connect(widget, &MediaSelectorWidget::ZSelectionChanged, this, &MediaSelectorDialog::SSelectionChanged);
     return widget;
   } else {
-    auto *tabs = new QTabWidget(this);
+    auto *tabs = new QTabWidget(parent);
     for (const auto &series : series_for_manufacturer) {
-      MediaSelectorWidget *widget = this->CreateSelectorWidget(manufacturer, series);
-      connect(widget, &MediaSelectorWidget::ZSelectionChanged, this, &MediaSelectorDialog::SSelectionChanged);
-      tabs->addTab(widget, QString::fromStdString(series.GetName()));
+      auto *page = new LazyWidget([this, manufacturer, series](QWidget *page_parent) {
+        MediaSelectorWidget *widget = this->CreateSelectorWidget(manufacturer, series, page_parent);
+        connect(widget, &MediaSelectorWidget::ZSelectionChanged, this, &MediaSelectorDialog::SSelectionChanged);
+        return widget;
+      }, tabs);
+      tabs->addTab(page, QString::fromStdString(series.GetName()));
     }
+    // Load the neighbours of the current tab in the background, as they are the likeliest to be opened next.
+    const auto prefetch_adjacent = [this, series_for_manufacturer](int index) {
+      for (const int adjacent : {index - 1, index + 1}) {
+        if (adjacent >= 0 && adjacent < static_cast<int>(series_for_manufacturer.size())) {
+          PrefetchSeries(series_for_manufacturer.at(adjacent));
+        }
+      }
+    };
+    connect(tabs, &QTabWidget::currentChanged, this, prefetch_adjacent);
+    prefetch_adjacent(tabs->currentIndex());
     return tabs;
   }
 }
@@ -62,12 +111,30 @@ void MediaSelectorDialog::SSelectionChanged(std::optional<csprofile::parameter::
   media_ = std::move(media);
 }
 
-MediaSelectorModel::MediaSelectorModel(const std::shared_ptr<cslibs::Db> &db,
-                                       const cslibs::Manufacturer &manufacturer,
+LazyWidget::LazyWidget(Factory factory, QWidget *parent) : QWidget(parent), factory_(std::move(factory)) {
+  auto *layout = new QVBoxLayout(this);
+  layout->setContentsMargins(0, 0, 0, 0);
+}
+
+void LazyWidget::Populate() {
+  if (!factory_) {
+    return;
+  }
+  // Clear the factory first, in case creating the contents shows this widget again.
+  const Factory factory = std::move(factory_);
+  factory_ = nullptr;
+  layout()->addWidget(factory(this));
+}
+
+void LazyWidget::showEvent(QShowEvent *event) {
+  Populate();
+  QWidget::showEvent(event);
+}
+
+MediaSelectorModel::MediaSelectorModel(const cslibs::Manufacturer &manufacturer,
                                        const cslibs::Series &series,
                                        QObject *parent) :
     QAbstractTableModel(parent),
-    db_(db),
     manufacturer_(manufacturer),
     series_(series) {
 }
@@ -77,6 +144,21 @@ void MediaSelectorModel::Init() {
   ready_ = true;
 }
 
+void MediaSelectorModel::SetFilters(Filters filters) {
+  filters_ = std::move(filters);
+  if (ready_) {
+    LoadEntitiesWithFilters();
+  }
+}
+
+bool MediaSelectorModel::MatchesFilters(const std::string &code, const std::string &name) const {
+  const auto matches = [](const std::string &value, const std::string &filter) {
+    return filter.empty()
+        || QString::fromStdString(value).contains(QString::fromStdString(filter), Qt::CaseInsensitive);
+  };
+  return matches(code, filters_.code) && matches(name, filters_.name);
+}
+
 int MediaSelectorModel::columnCount(const QModelIndex &parent) const {
   return kColumnCount;
 }
@@ -117,27 +199,113 @@ QVariant MediaSelectorModel::data(const QModelIndex &index, int role) const {
   return {};
 }
 
-ImageMediaSelectorModel::ImageMediaSelectorModel(const std::shared_ptr<cslibs::ImageDb> &db,
+ImageMediaSelectorModel::ImageMediaSelectorModel(std::shared_ptr<cslibs::AsyncDb<cslibs::ImageDb>> db,
                                                  const cslibs::Manufacturer &manufacturer,
                                                  const cslibs::Series &series,
+                                                 EntityLoader loader,
                                                  QObject *parent) :
-    MediaSelectorModel(db, manufacturer, series, parent), db_(db) {
+    MediaSelectorModel(manufacturer, series, parent), db_(std::move(db)), loader_(std::move(loader)) {
+}
+
+ImageMediaSelectorModel::~ImageMediaSelectorModel() {
+  token_.Cancel();
 }
 
 void ImageMediaSelectorModel::LoadEntitiesWithFilters() {
+  // A series is small enough to filter in memory, so it is only loaded once.
+  if (all_entities_.has_value()) {
+    ApplyFilters();
+    return;
+  }
+  loader_([model = QPointer(this)](std::vector<cslibs::ImageEntityInfo> entities) {
+    if (!model) {
+      return;
+    }
+    model->all_entities_ = std::move(entities);
+    model->ApplyFilters();
+  });
+}
+
+void ImageMediaSelectorModel::ApplyFilters() {
   beginResetModel();
-  // TODO: Filtering
-  entities_ = db_->GetForSeries(series_);
+  entities_.clear();
+  std::copy_if(all_entities_->cbegin(), all_entities_->cend(), std::back_inserter(entities_),
+               [this](const cslibs::ImageEntityInfo &entity) {
+                 return MatchesFilters(entity.GetCode(), entity.GetName());
+               });
   endResetModel();
 }
 
 QVariant ImageMediaSelectorModel::GetEntityDecoration(int row) const {
-  const auto &image_data = entities_.at(row).GetImage();
-  QPixmap pixmap;
-  if (pixmap.loadFromData(reinterpret_cast<const unsigned char *>(image_data.data()), image_data.size())) {
-    return QIcon(pixmap);
+  const auto &dcid = entities_.at(row).GetDcid();
+  const auto icon = ThumbnailCache::Find(dcid, ThumbnailCache::kLargeSize);
+  if (!icon.has_value()) {
+    // Loading doesn't change the model's contents, only how quickly they can be shown.
+    const_cast<ImageMediaSelectorModel *>(this)->LoadDecorations(row);
+    return {};
+  }
+  if (icon->isNull()) {
+    return {};
+  }
+  return *icon;
+}
+
+void ImageMediaSelectorModel::LoadDecorations(int row) {
+  if (!db_) {
+    return;
+  }
+  std::vector<std::string> dcids;
+  const int end_row = std::min(row + kDecorationBatchSize, static_cast<int>(entities_.size()));
+  for (int batch_row = row; batch_row < end_row; ++batch_row) {
+    const auto &dcid = entities_.at(batch_row).GetDcid();
+    if (!ThumbnailCache::Find(dcid, ThumbnailCache::kLargeSize).has_value() && pending_dcids_.insert(dcid).second) {
+      dcids.push_back(dcid);
+    }
+  }
+  if (dcids.empty()) {
+    return;
+  }
+
+  RunQuery(*db_, this, token_,
+           [dcids](cslibs::ImageDb &db) {
+             auto images = db.GetThumbnailsForDcids(dcids, ThumbnailCache::kLargeSize);
+             if (images.size() < dcids.size()) {
+               // Libraries imported before thumbnails were added only have the full image.
+               std::vector<std::string> missing_dcids;
+               for (const auto &dcid : dcids) {
+                 if (images.find(dcid) == images.cend()) {
+                   missing_dcids.push_back(dcid);
+                 }
+               }
+               images.merge(db.GetImagesForDcids(missing_dcids));
+             }
+             std::vector<std::pair<std::string, QImage>> decoded;
+             decoded.reserve(dcids.size());
+             for (const auto &dcid : dcids) {
+               const auto image = images.find(dcid);
+               const std::vector<char> &image_data = image != images.cend() ? image->second : std::vector<char>();
+               decoded.emplace_back(dcid, ThumbnailCache::Decode(image_data));
+             }
+             return decoded;
+           },
+           [this](const std::vector<std::pair<std::string, QImage>> &images) { AddDecorations(images); },
+           [this, dcids]() {
+             // Try again the next time they are shown.
+             for (const auto &dcid : dcids) {
+               pending_dcids_.erase(dcid);
+             }
+           });
+}
+
+void ImageMediaSelectorModel::AddDecorations(const std::vector<std::pair<std::string, QImage>> &images) {
+  for (const auto &[dcid, image] : images) {
+    ThumbnailCache::Insert(dcid, ThumbnailCache::kLargeSize, image);
+    pending_dcids_.erase(dcid);
+  }
+  if (!entities_.empty()) {
+    const auto column = static_cast<int>(Column::kDecoration);
+    Q_EMIT(dataChanged(index(0, column), index(static_cast<int>(entities_.size()) - 1, column), {Qt::DecorationRole}));
   }
-  return {};
 }
 
 QVariant ImageMediaSelectorModel::GetEntityCode(int row) const {
@@ -161,11 +329,11 @@ csprofile::parameter::Media ImageMediaSelectorModel::GetMedia(int row) const {
   return media;
 }
 
-GelMediaSelectorModel::GelMediaSelectorModel(const std::shared_ptr<cslibs::gel::GelDb> &db,
-                                             const cslibs::Manufacturer &manufacturer,
+GelMediaSelectorModel::GelMediaSelectorModel(const cslibs::Manufacturer &manufacturer,
                                              const cslibs::Series &series,
+                                             EntityLoader loader,
                                              QObject *parent) :
-    MediaSelectorModel(db, manufacturer, series, parent), db_(db) {
+    MediaSelectorModel(manufacturer, series, parent), loader_(std::move(loader)) {
 }
 
 int GelMediaSelectorModel::rowCount(const QModelIndex &parent) const {
@@ -173,9 +341,25 @@ int GelMediaSelectorModel::rowCount(const QModelIndex &parent) const {
 }
 
 void GelMediaSelectorModel::LoadEntitiesWithFilters() {
+  // A series is small enough to filter in memory, so it is only loaded once.
+  if (all_entities_.has_value()) {
+    ApplyFilters();
+    return;
+  }
+  loader_([model = QPointer(this)](std::vector<cslibs::gel::Gel> entities) {
+    if (!model) {
+      return;
+    }
+    model->all_entities_ = std::move(entities);
+    model->ApplyFilters();
+  });
+}
+
+void GelMediaSelectorModel::ApplyFilters() {
   beginResetModel();
-  // TODO: Filtering
-  entities_ = db_->GetGelForSeries(series_);
+  entities_.clear();
+  std::copy_if(all_entities_->cbegin(), all_entities_->cend(), std::back_inserter(entities_),
+               [this](const cslibs::gel::Gel &entity) { return MatchesFilters(entity.GetCode(), entity.GetName()); });
   endResetModel();
 }
 
@@ -200,22 +384,43 @@ csprofile::parameter::Media GelMediaSelectorModel::GetMedia(int row) const {
   return media;
 }
 
-ImageMediaSelectorDialog::ImageMediaSelectorDialog(const std::shared_ptr<cslibs::ImageDb> &db, QWidget *parent) :
-    MediaSelectorDialog(db, parent), db_(db) {
+ImageMediaSelectorDialog::ImageMediaSelectorDialog(const std::shared_ptr<cslibs::AsyncDb<cslibs::ImageDb>> &db,
+                                                   QWidget *parent) :
+    MediaSelectorDialog(db ? std::make_shared<cslibs::AsyncDb<cslibs::Db>>(*db) : nullptr, parent),
+    db_(db),
+    loader_(db, [](cslibs::ImageDb &db, const cslibs::Series &series) { return db.GetInfoForSeries(series); }, this) {
 }
 
 MediaSelectorWidget *ImageMediaSelectorDialog::CreateSelectorWidget(const cslibs::Manufacturer &manufacturer,
-                                                                    const cslibs::Series &series) {
-  return new ImageMediaSelectorWidget(db_, manufacturer, series, this);
+                                                                    const cslibs::Series &series,
+                                                                    QWidget *parent) {
+  return new ImageMediaSelectorWidget(
+      db_, manufacturer, series,
+      [this, series](ImageMediaSelectorModel::EntitiesCallback callback) { loader_.Load(series, std::move(callback)); },
+      parent);
 }
 
-GelSelectorDialog::GelSelectorDialog(const std::shared_ptr<cslibs::gel::GelDb> &db, QWidget *parent) :
-    MediaSelectorDialog(db, parent), db_(db) {
+void ImageMediaSelectorDialog::PrefetchSeries(const cslibs::Series &series) {
+  loader_.Prefetch(series);
+}
+
+GelSelectorDialog::GelSelectorDialog(const std::shared_ptr<cslibs::AsyncDb<cslibs::gel::GelDb>> &db,
+                                     QWidget *parent) :
+    MediaSelectorDialog(db ? std::make_shared<cslibs::AsyncDb<cslibs::Db>>(*db) : nullptr, parent),
+    loader_(db, [](cslibs::gel::GelDb &db, const cslibs::Series &series) { return db.GetGelForSeries(series); }, this) {
 }
 
 MediaSelectorWidget *GelSelectorDialog::CreateSelectorWidget(const cslibs::Manufacturer &manufacturer,
-                                                             const cslibs::Series &series) {
-  return new GelSelectorWidget(db_, manufacturer, series, this);
+                                                             const cslibs::Series &series,
+                                                             QWidget *parent) {
+  return new GelSelectorWidget(
+      manufacturer, series,
+      [this, series](GelMediaSelectorModel::EntitiesCallback callback) { loader_.Load(series, std::move(callback)); },
+      parent);
+}
+
+void GelSelectorDialog::PrefetchSeries(const cslibs::Series &series) {
+  loader_.Prefetch(series);
 }
 
 MediaSelectorWidget::MediaSelectorWidget(const cslibs::Manufacturer &manufacturer,
@@ -224,8 +429,23 @@ MediaSelectorWidget::MediaSelectorWidget(const cslibs::Manufacturer &manufacture
     : QWidget(parent),
       manufacturer_(manufacturer),
       series_(series),
+      code_filter_(new QLineEdit(this)),
+      name_filter_(new QLineEdit(this)),
       table_(new QTableView(this)) {
   auto *layout = new QVBoxLayout(this);
+
+  // Filters
+  auto *filters_layout = new QHBoxLayout;
+  code_filter_->setPlaceholderText(tr("Filter by code"));
+  code_filter_->setClearButtonEnabled(true);
+  filters_layout->addWidget(code_filter_);
+  connect(code_filter_, &QLineEdit::textChanged, this, &MediaSelectorWidget::SFiltersChanged);
+  name_filter_->setPlaceholderText(tr("Filter by name"));
+  name_filter_->setClearButtonEnabled(true);
+  filters_layout->addWidget(name_filter_);
+  connect(name_filter_, &QLineEdit::textChanged, this, &MediaSelectorWidget::SFiltersChanged);
+  layout->addLayout(filters_layout);
+
   layout->addWidget(table_);
   table_->setSelectionMode(QTableView::SingleSelection);
   table_->setSelectionBehavior(QTableView::SelectRows);
@@ -244,12 +464,17 @@ void MediaSelectorWidget::SSelectionChanged() {
   Q_EMIT(ZSelectionChanged(GetMedia()));
 }
 
-ImageMediaSelectorWidget::ImageMediaSelectorWidget(const std::shared_ptr<cslibs::ImageDb> &db,
+void MediaSelectorWidget::SFiltersChanged() {
+  GetModel()->SetFilters({code_filter_->text().toStdString(), name_filter_->text().toStdString()});
+}
+
+ImageMediaSelectorWidget::ImageMediaSelectorWidget(const std::shared_ptr<cslibs::AsyncDb<cslibs::ImageDb>> &db,
                                                    const cslibs::Manufacturer &manufacturer,
                                                    const cslibs::Series &series,
+                                                   ImageMediaSelectorModel::EntityLoader loader,
                                                    QWidget *parent) :
     MediaSelectorWidget(manufacturer, series, parent) {
-  model_ = new ImageMediaSelectorModel(db, manufacturer_, series_, this);
+  model_ = new ImageMediaSelectorModel(db, manufacturer_, series_, std::move(loader), this);
   model_->Init();
   table_->setModel(model_);
   connect(table_->selectionModel(),
@@ -258,12 +483,12 @@ ImageMediaSelectorWidget::ImageMediaSelectorWidget(const std::shared_ptr<cslibs:
           &ImageMediaSelectorWidget::SSelectionChanged);
 }
 
-GelSelectorWidget::GelSelectorWidget(const std::shared_ptr<cslibs::gel::GelDb> &db,
-                                     const cslibs::Manufacturer &manufacturer,
+GelSelectorWidget::GelSelectorWidget(const cslibs::Manufacturer &manufacturer,
                                      const cslibs::Series &series,
+                                     GelMediaSelectorModel::EntityLoader loader,
                                      QWidget *parent) :
     MediaSelectorWidget(manufacturer, series, parent) {
-  model_ = new GelMediaSelectorModel(db, manufacturer_, series_, this);
+  model_ = new GelMediaSelectorModel(manufacturer_, series_, std::move(loader), this);
   model_->Init();
   table_->setModel(model_);
   connect(table_->selectionModel(),
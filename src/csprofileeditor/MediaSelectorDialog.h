@@ -10,24 +10,165 @@
 #define CSPROFILEEDITOR_SRC_CSPROFILEEDITOR_MEDIASELECTORDIALOG_H_
 
 #include <QDialog>
+#include <cslibs/AsyncDb.h>
 #include <cslibs/Db.h>
 #include <csprofile/parameter/Media.h>
 #include <QAbstractTableModel>
+#include <QImage>
+#include <QLineEdit>
 #include <cslibs/gel/GelDb.h>
 #include <QTableView>
+#include <functional>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
+#include "AsyncQuery.h"
 
 namespace csprofileeditor {
 
 class MediaSelectorWidget;
 
+/**
+ * Placeholder that creates its contents the first time it is shown (e.g. when its tab is activated).
+ */
+class LazyWidget final : public QWidget {
+ Q_OBJECT
+ public:
+  using Factory = std::function<QWidget *(QWidget *parent)>;
+
+  explicit LazyWidget(Factory factory, QWidget *parent = nullptr);
+
+  /**
+   * Create the contents, if not already created.
+   */
+  void Populate();
+
+ protected:
+  void showEvent(QShowEvent *event) final;
+
+ private:
+  Factory factory_;
+};
+
+/**
+ * Loads series contents on worker threads, optionally before they are needed.
+ *
+ * Only use from the GUI thread.  Loads that are still running when this is destroyed are cancelled.
+ *
+ * @tparam Db_T
+ * @tparam Entity
+ */
+template<class Db_T, class Entity>
+class SeriesLoader {
+ public:
+  using Query = std::function<std::vector<Entity>(Db_T &db, const cslibs::Series &series)>;
+  using Callback = std::function<void(std::vector<Entity> entities)>;
+
+  /**
+   * @param db
+   * @param query Called on a worker thread.
+   * @param context Callbacks are not called after it is destroyed.
+   */
+  SeriesLoader(std::shared_ptr<cslibs::AsyncDb<Db_T>> db, Query query, QObject *context) :
+      db_(std::move(db)), query_(std::move(query)), context_(context) {}
+
+  ~SeriesLoader() {
+    token_.Cancel();
+  }
+
+  SeriesLoader(const SeriesLoader &) = delete;
+  SeriesLoader &operator=(const SeriesLoader &) = delete;
+
+  /**
+   * Start loading @p series, if not already started.
+   * @param series
+   */
+  void Prefetch(const cslibs::Series &series) {
+    Start(series);
+  }
+
+  /**
+   * Pass the contents of @p series to @p callback once they are loaded.
+   *
+   * @p callback is called immediately if the contents were prefetched.  If loading fails, @p callback gets an empty
+   * list and the next call tries again.
+   *
+   * @param series
+   * @param callback
+   */
+  void Load(const cslibs::Series &series, Callback callback) {
+    if (!db_) {
+      return;
+    }
+    const auto entry = entries_.find(series.GetId());
+    if (entry != entries_.end() && entry->second.entities.has_value()) {
+      auto entities = std::move(*entry->second.entities);
+      entries_.erase(entry);
+      callback(std::move(entities));
+      return;
+    }
+    Start(series);
+    entries_.at(series.GetId()).callback = std::move(callback);
+  }
+
+ private:
+  struct Entry {
+    /** Set when the load finishes before anyone asks for it */
+    std::optional<std::vector<Entity>> entities;
+    /** Set when someone asks for the load before it finishes */
+    Callback callback;
+  };
+  std::shared_ptr<cslibs::AsyncDb<Db_T>> db_;
+  Query query_;
+  QObject *context_;
+  cslibs::CancelToken token_;
+  /** Started loads, by series id */
+  std::unordered_map<unsigned int, Entry> entries_;
+
+  void Start(const cslibs::Series &series) {
+    if (!db_ || entries_.find(series.GetId()) != entries_.end()) {
+      return;
+    }
+    entries_.emplace(series.GetId(), Entry());
+    RunQuery(*db_, context_, token_,
+             [query = query_, series](Db_T &db) { return query(db, series); },
+             [this, series_id = series.GetId()](std::vector<Entity> entities) {
+               const auto entry = entries_.find(series_id);
+               if (entry == entries_.end()) {
+                 return;
+               }
+               if (entry->second.callback) {
+                 const Callback callback = std::move(entry->second.callback);
+                 entries_.erase(entry);
+                 callback(std::move(entities));
+               } else {
+                 entry->second.entities = std::move(entities);
+               }
+             },
+             [this, series_id = series.GetId()]() {
+               const auto entry = entries_.find(series_id);
+               if (entry == entries_.end()) {
+                 return;
+               }
+               // Forget the failed load so it can be started again.
+               const Callback callback = std::move(entry->second.callback);
+               entries_.erase(entry);
+               if (callback) {
+                 callback({});
+               }
+             });
+  }
+};
+
 /**
  * Select media for a range
  */
 class MediaSelectorDialog : public QDialog {
  Q_OBJECT
  public:
-  explicit MediaSelectorDialog(const std::shared_ptr<cslibs::Db> &db, QWidget *parent = nullptr);
+  explicit MediaSelectorDialog(std::shared_ptr<cslibs::AsyncDb<cslibs::Db>> db, QWidget *parent = nullptr);
+  ~MediaSelectorDialog() override;
   void Init();
 
   [[nodiscard]] const std::optional<csprofile::parameter::Media> &GetMedia() const {
@@ -39,13 +180,30 @@ class MediaSelectorDialog : public QDialog {
   }
 
  protected:
-  std::shared_ptr<cslibs::Db> db_;
+  std::shared_ptr<cslibs::AsyncDb<cslibs::Db>> db_;
   std::optional<csprofile::parameter::Media> media_;
+  /** Cancelled when the dialog is destroyed */
+  cslibs::CancelToken token_;
 
  private:
-  QWidget *CreateSeriesWidget(const cslibs::Manufacturer &manufacturer);
+  /**
+   * Create a placeholder that is filled in once the manufacturer's series are loaded.
+   * @param manufacturer
+   * @param parent
+   * @return
+   */
+  QWidget *CreateSeriesWidget(const cslibs::Manufacturer &manufacturer, QWidget *parent);
+  QWidget *CreateSeriesTabs(const cslibs::Manufacturer &manufacturer,
+                            const std::vector<cslibs::Series> &series_for_manufacturer,
+                            QWidget *parent);
   virtual MediaSelectorWidget *CreateSelectorWidget(const cslibs::Manufacturer &manufacturer,
-                                                    const cslibs::Series &series) = 0;
+                                                    const cslibs::Series &series,
+                                                    QWidget *parent) = 0;
+  /**
+   * Start loading @p series in the background, so it is ready if the user opens its tab.
+   * @param series
+   */
+  virtual void PrefetchSeries(const cslibs::Series &series) = 0;
 
  private Q_SLOTS:
   void SSelectionChanged(std::optional<csprofile::parameter::Media> media);
@@ -57,8 +215,7 @@ class MediaSelectorDialog : public QDialog {
 class MediaSelectorModel : public QAbstractTableModel {
  Q_OBJECT
  public:
-  explicit MediaSelectorModel(const std::shared_ptr<cslibs::Db> &db,
-                              const cslibs::Manufacturer &manufacturer,
+  explicit MediaSelectorModel(const cslibs::Manufacturer &manufacturer,
                               const cslibs::Series &series,
                               QObject *parent = nullptr);
   void Init();
@@ -76,18 +233,24 @@ class MediaSelectorModel : public QAbstractTableModel {
   [[nodiscard]] QVariant data(const QModelIndex &index, int role) const override;
   [[nodiscard]] virtual csprofile::parameter::Media GetMedia(int row) const = 0;
 
- protected:
-  bool ready_ = false;
-  std::shared_ptr<cslibs::Db> db_;
-  cslibs::Manufacturer manufacturer_;
-  cslibs::Series series_;
   struct Filters {
     std::string code;
     std::string name;
   };
+  /**
+   * Only show entities whose code and name contain these, ignoring case.  Empty filters match everything.
+   * @param filters
+   */
+  void SetFilters(Filters filters);
+
+ protected:
+  bool ready_ = false;
+  cslibs::Manufacturer manufacturer_;
+  cslibs::Series series_;
   Filters filters_;
 
   virtual void LoadEntitiesWithFilters() = 0;
+  [[nodiscard]] bool MatchesFilters(const std::string &code, const std::string &name) const;
   [[nodiscard]] virtual QVariant GetEntityDecoration(int row) const = 0;
   [[nodiscard]] virtual QVariant GetEntityCode(int row) const = 0;
   [[nodiscard]] virtual QVariant GetEntityName(int row) const = 0;
@@ -102,10 +265,23 @@ class MediaSelectorModel : public QAbstractTableModel {
 class ImageMediaSelectorModel : public MediaSelectorModel {
  Q_OBJECT
  public:
-  explicit ImageMediaSelectorModel(const std::shared_ptr<cslibs::ImageDb> &db,
+  using EntitiesCallback = std::function<void(std::vector<cslibs::ImageEntityInfo> entities)>;
+  /** Passes the series contents to the callback once they are loaded */
+  using EntityLoader = std::function<void(EntitiesCallback callback)>;
+
+  /**
+   * @param db Used to load decorations
+   * @param manufacturer
+   * @param series
+   * @param loader
+   * @param parent
+   */
+  explicit ImageMediaSelectorModel(std::shared_ptr<cslibs::AsyncDb<cslibs::ImageDb>> db,
                                    const cslibs::Manufacturer &manufacturer,
                                    const cslibs::Series &series,
+                                   EntityLoader loader,
                                    QObject *parent = nullptr);
+  ~ImageMediaSelectorModel() override;
 
   [[nodiscard]] int rowCount(const QModelIndex &parent) const override;
   [[nodiscard]] csprofile::parameter::Media GetMedia(int row) const override;
@@ -117,8 +293,32 @@ class ImageMediaSelectorModel : public MediaSelectorModel {
   [[nodiscard]] QVariant GetEntityName(int row) const override;
 
  private:
-  std::shared_ptr<cslibs::ImageDb> db_;
-  std::vector<cslibs::ImageEntity> entities_;
+  std::shared_ptr<cslibs::AsyncDb<cslibs::ImageDb>> db_;
+  EntityLoader loader_;
+  /** The whole series, once loaded */
+  std::optional<std::vector<cslibs::ImageEntityInfo>> all_entities_;
+  /** Entities that match the filters */
+  std::vector<cslibs::ImageEntityInfo> entities_;
+  /** Dcids whose decorations are being loaded */
+  std::unordered_set<std::string> pending_dcids_;
+  /** Cancelled when the model is destroyed */
+  cslibs::CancelToken token_;
+  /** Rows fetched at once when a decoration is missing, so scrolling costs one query per screen. */
+  static inline const int kDecorationBatchSize = 32;
+
+  /**
+   * Start loading the decorations for @p row and the rows after it that are not already cached or loading.
+   * @param row
+   */
+  void LoadDecorations(int row);
+
+  /**
+   * Cache decorations decoded by LoadDecorations() and refresh the rows that show them.
+   * @param images dcid => image
+   */
+  void AddDecorations(const std::vector<std::pair<std::string, QImage>> &images);
+
+  void ApplyFilters();
 };
 
 /**
@@ -127,9 +327,19 @@ class ImageMediaSelectorModel : public MediaSelectorModel {
 class GelMediaSelectorModel final : public MediaSelectorModel {
  Q_OBJECT
  public:
-  explicit GelMediaSelectorModel(const std::shared_ptr<cslibs::gel::GelDb> &db,
-                                 const cslibs::Manufacturer &manufacturer,
+  using EntitiesCallback = std::function<void(std::vector<cslibs::gel::Gel> entities)>;
+  /** Passes the series contents to the callback once they are loaded */
+  using EntityLoader = std::function<void(EntitiesCallback callback)>;
+
+  /**
+   * @param manufacturer
+   * @param series
+   * @param loader
+   * @param parent
+   */
+  explicit GelMediaSelectorModel(const cslibs::Manufacturer &manufacturer,
                                  const cslibs::Series &series,
+                                 EntityLoader loader,
                                  QObject *parent = nullptr);
 
   [[nodiscard]] int rowCount(const QModelIndex &parent) const final;
@@ -142,8 +352,13 @@ class GelMediaSelectorModel final : public MediaSelectorModel {
   [[nodiscard]] QVariant GetEntityName(int row) const final;
 
  private:
-  std::shared_ptr<cslibs::gel::GelDb> db_;
+  EntityLoader loader_;
+  /** The whole series, once loaded */
+  std::optional<std::vector<cslibs::gel::Gel>> all_entities_;
+  /** Entities that match the filters */
   std::vector<cslibs::gel::Gel> entities_;
+
+  void ApplyFilters();
 };
 
 /**
@@ -152,14 +367,19 @@ class GelMediaSelectorModel final : public MediaSelectorModel {
 class ImageMediaSelectorDialog : public MediaSelectorDialog {
  Q_OBJECT
  public:
-  explicit ImageMediaSelectorDialog(const std::shared_ptr<cslibs::ImageDb> &db, QWidget *parent = nullptr);
+  explicit ImageMediaSelectorDialog(const std::shared_ptr<cslibs::AsyncDb<cslibs::ImageDb>> &db,
+                                    QWidget *parent = nullptr);
 
  protected:
-  std::shared_ptr<cslibs::ImageDb> db_;
+  std::shared_ptr<cslibs::AsyncDb<cslibs::ImageDb>> db_;
 
  private:
+  SeriesLoader<cslibs::ImageDb, cslibs::ImageEntityInfo> loader_;
+
   MediaSelectorWidget *CreateSelectorWidget(const cslibs::Manufacturer &manufacturer,
-                                            const cslibs::Series &series) override;
+                                            const cslibs::Series &series,
+                                            QWidget *parent) override;
+  void PrefetchSeries(const cslibs::Series &series) override;
 };
 
 /**
@@ -168,13 +388,16 @@ class ImageMediaSelectorDialog : public MediaSelectorDialog {
 class GelSelectorDialog final : public MediaSelectorDialog {
  Q_OBJECT
  public:
-  explicit GelSelectorDialog(const std::shared_ptr<cslibs::gel::GelDb> &db, QWidget *parent = nullptr);
+  explicit GelSelectorDialog(const std::shared_ptr<cslibs::AsyncDb<cslibs::gel::GelDb>> &db,
+                             QWidget *parent = nullptr);
 
  private:
-  std::shared_ptr<cslibs::gel::GelDb> db_;
+  SeriesLoader<cslibs::gel::GelDb, cslibs::gel::Gel> loader_;
 
   MediaSelectorWidget *CreateSelectorWidget(const cslibs::Manufacturer &manufacturer,
-                                            const cslibs::Series &series) final;
+                                            const cslibs::Series &series,
+                                            QWidget *parent) final;
+  void PrefetchSeries(const cslibs::Series &series) final;
 };
 
 /**
@@ -195,12 +418,17 @@ class MediaSelectorWidget : public QWidget {
  protected:
   cslibs::Manufacturer manufacturer_;
   cslibs::Series series_;
+  QLineEdit *code_filter_;
+  QLineEdit *name_filter_;
   QTableView *table_;
 
   [[nodiscard]] virtual MediaSelectorModel *GetModel() const = 0;
 
  protected Q_SLOTS:
   void SSelectionChanged();
+
+ private Q_SLOTS:
+  void SFiltersChanged();
 };
 
 /**
@@ -209,9 +437,10 @@ class MediaSelectorWidget : public QWidget {
 class ImageMediaSelectorWidget final : public MediaSelectorWidget {
  Q_OBJECT
  public:
-  explicit ImageMediaSelectorWidget(const std::shared_ptr<cslibs::ImageDb> &db,
+  explicit ImageMediaSelectorWidget(const std::shared_ptr<cslibs::AsyncDb<cslibs::ImageDb>> &db,
                                     const cslibs::Manufacturer &manufacturer,
                                     const cslibs::Series &series,
+                                    ImageMediaSelectorModel::EntityLoader loader,
                                     QWidget *parent = nullptr);
 
  protected:
@@ -229,9 +458,9 @@ class ImageMediaSelectorWidget final : public MediaSelectorWidget {
 class GelSelectorWidget final : public MediaSelectorWidget {
  Q_OBJECT
  public:
-  explicit GelSelectorWidget(const std::shared_ptr<cslibs::gel::GelDb> &db,
-                             const cslibs::Manufacturer &manufacturer,
+  explicit GelSelectorWidget(const cslibs::Manufacturer &manufacturer,
                              const cslibs::Series &series,
+                             GelMediaSelectorModel::EntityLoader loader,
                              QWidget *parent = nullptr);
 
  protected:
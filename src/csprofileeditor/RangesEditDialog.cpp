@@ -7,12 +7,16 @@
  */
 
 #include "RangesEditDialog.h"
+#include "MediaSearchDialog.h"
 #include "MediaSelectorDialog.h"
 #include <QAction>
 #include <QVBoxLayout>
 #include <QMessageBox>
 #include <QPushButton>
 #include <QMenu>
+#include <cslibs/disc/DiscDb.h>
+#include <cslibs/effect/EffectDb.h>
+#include <cslibs/gobo/GoboDb.h>
 #include "EtcCsPersEditBridge.h"
 #include "PushButtonItemDelegate.h"
 #include "Settings.h"
@@ -158,12 +162,25 @@ QPushButton *RangesEditDialog::CreateRangeMediaButton() {
   auto *menu = new QMenu(this);
   button->setMenu(menu);
 
+  // Search every library
+  auto *search_action = new QAction(tr("Search..."), this);
+  connect(search_action, &QAction::triggered, [this, button]() {
+    const auto index = button->property(PushButtonItemDelegate::kModelIndexProperty).toModelIndex();
+    auto *dialog = new MediaSearchDialog(this);
+    if (dialog->exec() == MediaSearchDialog::Accepted) {
+      ranges_table_model_->SetMedia(index, dialog->GetMedia());
+    }
+    dialog->deleteLater();
+  });
+  menu->addAction(search_action);
+  menu->addSeparator();
+
   // Disc
   auto *disc_action = new QAction(tr("Disc"), this);
   connect(disc_action, &QAction::triggered, [this, button]() {
     ShowMediaSelector<ImageMediaSelectorDialog>(
         button->property(PushButtonItemDelegate::kModelIndexProperty).toModelIndex(),
-        EtcCsPersEditBridge::GetDiscDb());
+        EtcCsPersEditBridge::GetAsyncDiscDb());
   });
   menu->addAction(disc_action);
 
@@ -172,7 +189,7 @@ QPushButton *RangesEditDialog::CreateRangeMediaButton() {
   connect(effect_action, &QAction::triggered, [this, button]() {
     ShowMediaSelector<ImageMediaSelectorDialog>(
         button->property(PushButtonItemDelegate::kModelIndexProperty).toModelIndex(),
-        EtcCsPersEditBridge::GetEffectDb());
+        EtcCsPersEditBridge::GetAsyncEffectDb());
   });
   menu->addAction(effect_action);
 
@@ -181,7 +198,7 @@ QPushButton *RangesEditDialog::CreateRangeMediaButton() {
   connect(gel_action, &QAction::triggered, [this, button]() {
     ShowMediaSelector<GelSelectorDialog>(
         button->property(PushButtonItemDelegate::kModelIndexProperty).toModelIndex(),
-        EtcCsPersEditBridge::GetGelDb());
+        EtcCsPersEditBridge::GetAsyncGelDb());
   });
   menu->addAction(gel_action);
 
@@ -190,7 +207,7 @@ QPushButton *RangesEditDialog::CreateRangeMediaButton() {
   connect(gobo_action, &QAction::triggered, [this, button]() {
     ShowMediaSelector<ImageMediaSelectorDialog>(
         button->property(PushButtonItemDelegate::kModelIndexProperty).toModelIndex(),
-        EtcCsPersEditBridge::GetGoboDb());
+        EtcCsPersEditBridge::GetAsyncGoboDb());
   });
   menu->addAction(gobo_action);
 
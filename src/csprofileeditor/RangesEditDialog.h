@@ -56,12 +56,14 @@ class RangesEditDialog : public QDialog {
   template<class Dialog_T, class Db_T,
       typename = std::enable_if_t<std::is_base_of_v<MediaSelectorDialog, Dialog_T>>,
       typename = std::enable_if_t<std::is_base_of_v<cslibs::Db, Db_T>>>
-  void ShowMediaSelector(const QModelIndex &index, std::shared_ptr<Db_T> db) {
+  void ShowMediaSelector(const QModelIndex &index, std::shared_ptr<cslibs::AsyncDb<Db_T>> db) {
     auto *dialog = new Dialog_T(db, this);
     dialog->Init();
     if (dialog->exec() == Dialog_T::Accepted) {
       ranges_table_model_->SetMedia(index, dialog->GetMedia());
     }
+    // Destroying the dialog cancels any queries it is still waiting for.
+    dialog->deleteLater();
   }
 
  private Q_SLOTS:
@@ -10,8 +10,10 @@
 #include <QColor>
 #include "EtcCsPersEditBridge.h"
 #include "util.h"
+#include "AsyncQuery.h"
 #include <QIcon>
 #include "Settings.h"
+#include "ThumbnailCache.h"
 #include <QBrush>
 
 namespace csprofileeditor {
@@ -19,12 +21,17 @@ namespace csprofileeditor {
 RangesTableModel::RangesTableModel(std::unique_ptr<csprofile::parameter::Parameter> &parameter, QObject *parent) :
     QAbstractTableModel(parent),
     parameter_(parameter),
-    disc_db_(EtcCsPersEditBridge::GetDiscDb()),
-    effect_db_(EtcCsPersEditBridge::GetEffectDb()),
-    gobo_db_(EtcCsPersEditBridge::GetGoboDb()) {
+    libraries_(EtcCsPersEditBridge::GetAsyncImageLibraries()) {
+  // The resolver may still be loading.
+  connect(EtcCsPersEditBridge::GetNotifier(), &EtcCsPersEditBridgeNotifier::ZDcidResolverLoaded,
+          this, &RangesTableModel::SDcidResolverLoaded);
   UpdateImageCache();
 }
 
+RangesTableModel::~RangesTableModel() {
+  token_.Cancel();
+}
+
 int RangesTableModel::rowCount(const QModelIndex &parent) const {
   return parameter_->ranges_.size();
 }
@@ -190,17 +197,40 @@ bool RangesTableModel::removeRows(std::vector<int> rows, const QModelIndex &pare
   return util::remove_model_rows(std::move(rows), parent, this);
 }
 
-std::optional<QIcon> RangesTableModel::GetImageForDcid(const std::string &dcid) {
-  std::optional<std::vector<char>> image;
-  if ((disc_db_ && (image = disc_db_->GetImageForDcid(dcid)))
-      || (effect_db_ && (image = effect_db_->GetImageForDcid(dcid)))
-      || (gobo_db_ && (image = gobo_db_->GetImageForDcid(dcid)))) {
-    QPixmap pixmap;
-    if (pixmap.loadFromData(reinterpret_cast<const unsigned char *>(image->data()), image->size())) {
-      return QIcon(pixmap);
-    }
+void RangesTableModel::LoadImageForDcid(const std::string &dcid) {
+  // The resolver may still be loading, or replaced after an update.
+  const auto dcid_resolver = EtcCsPersEditBridge::GetDcidResolver();
+  if (!dcid_resolver || pending_dcids_.find(dcid) != pending_dcids_.end()) {
+    return;
   }
-  return {};
+  const auto location = dcid_resolver->Resolve(dcid);
+  if (!location.has_value() || location->library >= libraries_.size() || !libraries_.at(location->library)) {
+    return;
+  }
+
+  pending_dcids_.insert(dcid);
+  RunQuery(*libraries_.at(location->library), this, token_,
+           [id = location->id](cslibs::ImageDb &db) {
+             std::optional<std::vector<char>> image = db.GetThumbnailForId(id, ThumbnailCache::kSmallSize);
+             if (!image.has_value()) {
+               // Libraries imported before thumbnails were added only have the full image.
+               image = db.GetImageForId(id);
+             }
+             return ThumbnailCache::Decode(image.value_or(std::vector<char>()));
+           },
+           [this, dcid](const QImage &image) {
+             pending_dcids_.erase(dcid);
+             const QIcon icon = ThumbnailCache::Insert(dcid, ThumbnailCache::kSmallSize, image);
+             if (icon.isNull()) {
+               return;
+             }
+             dcid_images_.insert_or_assign(dcid, icon);
+             MediaImagesChanged();
+           },
+           [this, dcid]() {
+             // Try again the next time the image is needed.
+             pending_dcids_.erase(dcid);
+           });
 }
 
 void RangesTableModel::UpdateImageCache() {
@@ -222,11 +252,30 @@ void RangesTableModel::UpdateImageCache() {
   // Add new images
   for (const auto &dcid : used_dcids) {
     if (dcid_images_.find(dcid) == dcid_images_.end()) {
-      if (const std::optional<QIcon> icon = GetImageForDcid(dcid)) {
+      const std::optional<QIcon> icon = ThumbnailCache::Find(dcid, ThumbnailCache::kSmallSize);
+      if (!icon.has_value()) {
+        LoadImageForDcid(dcid);
+      } else if (!icon->isNull()) {
         dcid_images_.insert({dcid, *icon});
       }
     }
   }
 }
 
+void RangesTableModel::SDcidResolverLoaded() {
+  UpdateImageCache();
+  // Images that were already cached have been added.
+  MediaImagesChanged();
+}
+
+void RangesTableModel::MediaImagesChanged() {
+  if (parameter_->ranges_.empty()) {
+    return;
+  }
+  const auto column = static_cast<int>(Column::kMedia);
+  Q_EMIT(dataChanged(index(0, column),
+                     index(static_cast<int>(parameter_->ranges_.size()) - 1, column),
+                     {Qt::DecorationRole}));
+}
+
 } // csprofileeditor
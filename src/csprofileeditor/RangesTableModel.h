@@ -11,10 +11,10 @@
 
 #include <QAbstractTableModel>
 #include <csprofile/parameter/Parameter.h>
-#include <cslibs/disc/DiscDb.h>
-#include <cslibs/effect/EffectDb.h>
-#include <cslibs/gobo/GoboDb.h>
+#include <cslibs/AsyncDb.h>
+#include <cslibs/DcidResolver.h>
 #include <QIcon>
+#include <unordered_set>
 
 namespace csprofileeditor {
 
@@ -25,6 +25,7 @@ class RangesTableModel : public QAbstractTableModel {
  Q_OBJECT
  public:
   explicit RangesTableModel(std::unique_ptr<csprofile::parameter::Parameter> &parameter, QObject *parent = nullptr);
+  ~RangesTableModel() override;
 
   enum class Column {
     kBegin = 0,
@@ -49,20 +50,35 @@ class RangesTableModel : public QAbstractTableModel {
  private:
   std::unique_ptr<csprofile::parameter::Parameter> &parameter_;
   std::unordered_map<std::string, QIcon> dcid_images_;
-  std::shared_ptr<cslibs::disc::DiscDb> disc_db_;
-  std::shared_ptr<cslibs::effect::EffectDb> effect_db_;
-  std::shared_ptr<cslibs::gobo::GoboDb> gobo_db_;
+  /** Connections to the libraries in the dcid resolver, in the same order */
+  std::vector<std::shared_ptr<cslibs::AsyncDb<cslibs::ImageDb>>> libraries_;
+  /** Dcids whose images are being loaded */
+  std::unordered_set<std::string> pending_dcids_;
+  /** Cancelled when the model is destroyed */
+  cslibs::CancelToken token_;
 
   /**
    * Loads required images from the library and removes unused ones.
    */
   void UpdateImageCache();
   /**
-   * Lookup the image that corresponds to the given @p dcid.
+   * Start loading the image that corresponds to the given @p dcid in the background.
+   *
+   * The image is added to dcid_images_ once it is loaded.
+   *
    * @param dcid
-   * @return The icon, if found
    */
-  std::optional<QIcon> GetImageForDcid(const std::string &dcid);
+  void LoadImageForDcid(const std::string &dcid);
+  /**
+   * Tell views that the images in the media column have changed.
+   */
+  void MediaImagesChanged();
+
+ private Q_SLOTS:
+  /**
+   * Load the images that couldn't be found without the resolver.
+   */
+  void SDcidResolverLoaded();
 };
 
 } // csprofileeditor
@@ -0,0 +1,72 @@
+/**
+ * @file ThumbnailCache.cpp
+ *
+ * @author dankeenan
+ * @date 5/16/21
+ * @copyright (c) 2021 Dan Keenan
+ */
+
+#include "ThumbnailCache.h"
+#include <QBuffer>
+#include <QImage>
+#include <QPixmap>
+
+namespace csprofileeditor {
+
+std::optional<std::vector<char>> ThumbnailCache::Render(std::string_view image, unsigned int size) {
+  // QImage (unlike QPixmap) is safe to use outside the GUI thread.
+  const QImage full_image = QImage::fromData(reinterpret_cast<const unsigned char *>(image.data()),
+                                             static_cast<int>(image.size()));
+  if (full_image.isNull()) {
+    return {};
+  }
+  const QImage thumbnail = full_image.scaled(size, size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+
+  QByteArray thumbnail_data;
+  QBuffer buffer(&thumbnail_data);
+  buffer.open(QIODevice::WriteOnly);
+  if (!thumbnail.save(&buffer, "PNG")) {
+    return {};
+  }
+  return std::vector<char>(thumbnail_data.cbegin(), thumbnail_data.cend());
+}
+
+std::optional<QIcon> ThumbnailCache::Find(const std::string &dcid, unsigned int size) {
+  const QIcon *icon = GetCache().object(GetKey(dcid, size));
+  if (icon == nullptr) {
+    return {};
+  }
+  return *icon;
+}
+
+QIcon ThumbnailCache::Insert(const std::string &dcid, unsigned int size, const std::vector<char> &image) {
+  return Insert(dcid, size, Decode(image));
+}
+
+QImage ThumbnailCache::Decode(const std::vector<char> &image) {
+  if (image.empty()) {
+    return {};
+  }
+  return QImage::fromData(reinterpret_cast<const unsigned char *>(image.data()), static_cast<int>(image.size()));
+}
+
+QIcon ThumbnailCache::Insert(const std::string &dcid, unsigned int size, const QImage &image) {
+  auto *icon = new QIcon;
+  if (!image.isNull()) {
+    *icon = QIcon(QPixmap::fromImage(image));
+  }
+  const QIcon result = *icon;
+  GetCache().insert(GetKey(dcid, size), icon);
+  return result;
+}
+
+QCache<QString, QIcon> &ThumbnailCache::GetCache() {
+  static QCache<QString, QIcon> cache(kMaxCount);
+  return cache;
+}
+
+QString ThumbnailCache::GetKey(const std::string &dcid, unsigned int size) {
+  return QString("%1@%2").arg(QString::fromStdString(dcid)).arg(size);
+}
+
+} // csprofileeditor
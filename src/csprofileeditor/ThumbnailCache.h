@@ -0,0 +1,90 @@
+/**
+ * @file ThumbnailCache.h
+ *
+ * @author dankeenan
+ * @date 5/16/21
+ * @copyright (c) 2021 Dan Keenan
+ */
+
+#ifndef CSPROFILEEDITOR_SRC_CSPROFILEEDITOR_THUMBNAILCACHE_H_
+#define CSPROFILEEDITOR_SRC_CSPROFILEEDITOR_THUMBNAILCACHE_H_
+
+#include <QCache>
+#include <QIcon>
+#include <QImage>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace csprofileeditor {
+
+/**
+ * Renders library thumbnails and keeps the most recently used ones decoded.
+ *
+ * Only Render() and Decode() may be used outside the GUI thread.
+ */
+class ThumbnailCache {
+ public:
+  /** Thumbnail size for table rows */
+  static inline const unsigned int kSmallSize = 32;
+  /** Thumbnail size for the media selector */
+  static inline const unsigned int kLargeSize = 64;
+
+  /**
+   * Render a PNG thumbnail that fits in a square of @p size pixels.
+   *
+   * Suitable for use as a cslibs::ImageDb::ThumbnailRenderer.
+   *
+   * @param image
+   * @param size
+   * @return
+   */
+  [[nodiscard]] static std::optional<std::vector<char>> Render(std::string_view image, unsigned int size);
+
+  /**
+   * Get the cached icon for @p dcid.
+   * @param dcid
+   * @param size
+   * @return The icon (which is null if the image could not be decoded), or none if it is not cached.
+   */
+  [[nodiscard]] static std::optional<QIcon> Find(const std::string &dcid, unsigned int size);
+
+  /**
+   * Decode @p image and add it to the cache.
+   * @param dcid
+   * @param size
+   * @param image Thumbnail or full image data; empty if there is no image.
+   * @return The icon, which is null if the image could not be decoded.
+   */
+  static QIcon Insert(const std::string &dcid, unsigned int size, const std::vector<char> &image);
+
+  /**
+   * Decode @p image, for passing to Insert() later.
+   *
+   * Decoding is the slow part of inserting, so do it off the GUI thread.
+   *
+   * @param image Thumbnail or full image data; empty if there is no image.
+   * @return The image, which is null if it could not be decoded.
+   */
+  [[nodiscard]] static QImage Decode(const std::vector<char> &image);
+
+  /**
+   * Add an image from Decode() to the cache.
+   * @param dcid
+   * @param size
+   * @param image
+   * @return The icon, which is null if the image is null.
+   */
+  static QIcon Insert(const std::string &dcid, unsigned int size, const QImage &image);
+
+ private:
+  static inline const int kMaxCount = 1024;
+
+  [[nodiscard]] static QCache<QString, QIcon> &GetCache();
+  [[nodiscard]] static QString GetKey(const std::string &dcid, unsigned int size);
+};
+
+} // csprofileeditor
+
+#endif //CSPROFILEEDITOR_SRC_CSPROFILEEDITOR_THUMBNAILCACHE_H_
@@ -0,0 +1,228 @@
+/**
+ * @file AsyncDbTest.cpp
+ *
+ * @author dankeenan
+ * @date 5/16/21
+ * @copyright (c) 2021 Dan Keenan
+ */
+
+#include <gtest/gtest.h>
+#include <cslibs/AsyncDb.h>
+#include <cslibs/gel/GelDb.h>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+
+using namespace cslibs;
+
+class AsyncDbTest : public ::testing::Test {
+ private:
+  static inline auto kDefsContents = R"EOF(
+IDENT 3:0
+MANUFACTURER AVAB
+CONSOLE PRONTO
+
+$SOFTWAREVERSION V5.0 R0
+! Gels File
+
+CLEAR $GEL
+$CARALLONVERSION 12.1.0
+
+$GEL
+$$DCID 6356B5B5-0127-2D47-AC1C-5AD540D7D7D9
+$$GELMANUFACTURER Apollo,Gel
+$$GELINFO 1050,Soft Diffusion,254,255,251
+
+$GEL
+$$DCID 4F5EC26C-D332-C146-8988-AEBA12B52916
+$$GELMANUFACTURER Apollo,Gel
+$$GELINFO 1100,Hard Diffusion,254,255,244
+
+ENDDATA
+  )EOF";
+
+ protected:
+  std::filesystem::path defs_file_path_;
+  std::filesystem::path db_path_;
+  unsigned int open_count_ = 0;
+
+  void SetUp() override {
+    defs_file_path_ = std::filesystem::temp_directory_path() / std::tmpnam(nullptr);
+    std::ofstream defs_file(defs_file_path_);
+    defs_file << kDefsContents;
+    defs_file.close();
+
+    db_path_ = std::filesystem::temp_directory_path() / std::tmpnam(nullptr);
+    gel::GelDb(defs_file_path_.string(), db_path_.string(), true).Update();
+  }
+
+  void TearDown() override {
+    std::filesystem::remove(defs_file_path_);
+    std::filesystem::remove(db_path_);
+  }
+
+  std::shared_ptr<DbPool<gel::GelDb>> CreatePool(unsigned int max_size) {
+    return std::make_shared<DbPool<gel::GelDb>>([this]() {
+      ++open_count_;
+      return std::make_unique<gel::GelDb>(defs_file_path_.string(), db_path_.string());
+    }, max_size);
+  }
+};
+
+TEST_F(AsyncDbTest, TestPoolReuse) {
+  auto pool = CreatePool(2);
+  {
+    auto db1 = pool->Acquire();
+    auto db2 = pool->Acquire();
+    EXPECT_EQ(db1->GetManufacturers().size(), 1);
+    EXPECT_EQ(db2->GetManufacturers().size(), 1);
+  }
+  {
+    auto db = pool->Acquire();
+  }
+  EXPECT_EQ(open_count_, 2);
+
+  pool->Clear();
+  {
+    auto db = pool->Acquire();
+  }
+  EXPECT_EQ(open_count_, 3);
+}
+
+TEST_F(AsyncDbTest, TestSubmit) {
+  AsyncDb<gel::GelDb> async_db(CreatePool(2), std::make_shared<WorkerPool>(2));
+  auto manufacturers = async_db.Submit([](gel::GelDb &db) { return db.GetManufacturers(); });
+  auto gels = async_db.Submit([](gel::GelDb &db) {
+    const auto manufacturer = db.GetManufacturers().at(0);
+    const auto series = db.GetSeriesForManufacturer(manufacturer).at(0);
+    return db.GetGelForSeries(series, gel::GelDb::Sort::kCode);
+  });
+
+  ASSERT_EQ(manufacturers.get().size(), 1);
+  const auto gel_results = gels.get();
+  ASSERT_EQ(gel_results.size(), 2);
+  EXPECT_EQ(gel_results.at(0).GetCode(), "1050");
+  EXPECT_EQ(gel_results.at(1).GetCode(), "1100");
+
+  // Queries that only need the base class share the same connections.
+  AsyncDb<Db> base_async_db(async_db);
+  EXPECT_EQ(base_async_db.Submit([](Db &db) { return db.GetManufacturers(); }).get().size(), 1);
+  EXPECT_LE(open_count_, 2);
+}
+
+TEST_F(AsyncDbTest, TestCancelBeforeStart) {
+  auto workers = std::make_shared<WorkerPool>(1);
+  AsyncDb<gel::GelDb> async_db(CreatePool(1), workers);
+
+  // Hold the only worker until the query has been cancelled.
+  std::promise<void> gate;
+  auto blocker = workers->Submit([gate_future = gate.get_future()]() { gate_future.wait(); });
+  bool query_ran = false;
+  CancelToken token;
+  auto result = async_db.Submit([&query_ran](gel::GelDb &db) {
+    query_ran = true;
+    return db.GetManufacturers();
+  }, token);
+  token.Cancel();
+  gate.set_value();
+
+  EXPECT_THROW(result.get(), except::QueryCancelled);
+  EXPECT_FALSE(query_ran);
+  EXPECT_EQ(open_count_, 0);
+}
+
+TEST_F(AsyncDbTest, TestCancelRunning) {
+  // Runs a query that never finishes on its own
+  class SlowDb : public Db {
+   public:
+    using Db::Db;
+
+    void Spin() {
+      db_->exec("WITH RECURSIVE counter(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM counter) "
+                "SELECT COUNT(*) FROM counter;");
+    }
+
+   protected:
+    [[nodiscard]] const char *GetBaseTable() const override {
+      return "gel";
+    }
+    void CreateTables() override {}
+    void LoadFromDefsFile(const ProgressCallback &) override {}
+    void ClearRecords() override {}
+  };
+  auto pool = std::make_shared<DbPool<SlowDb>>([this]() {
+    return std::make_unique<SlowDb>(defs_file_path_.string(), db_path_.string());
+  }, 1);
+  AsyncDb<SlowDb> async_db(pool, std::make_shared<WorkerPool>(1));
+  CancelToken token;
+  auto result = async_db.Submit([](SlowDb &db) { db.Spin(); }, token);
+  // An interrupt that arrives before the statement starts has no effect, so keep trying.
+  while (result.wait_for(std::chrono::milliseconds(10)) == std::future_status::timeout) {
+    token.Cancel();
+  }
+
+  EXPECT_THROW(result.get(), except::QueryCancelled);
+
+  // The connection is still usable afterwards.
+  auto next = async_db.Submit([](SlowDb &db) { return db.GetManufacturers(); });
+  EXPECT_EQ(next.get().size(), 1);
+}
+
+TEST_F(AsyncDbTest, TestCancelSharedToken) {
+  auto pool = std::make_shared<DbPool<gel::GelDb>>([this]() {
+    return std::make_unique<gel::GelDb>(defs_file_path_.string(), db_path_.string());
+  }, 3);
+  AsyncDb<gel::GelDb> async_db(pool, std::make_shared<WorkerPool>(3));
+  CancelToken token;
+  // Runs until interrupted, or the test gives up
+  std::atomic_bool stop = false;
+  const auto spin = [&stop](gel::GelDb &db) {
+    while (!stop) {
+      EXPECT_EQ(db.GetManufacturers().size(), 1);
+    }
+  };
+  auto first = async_db.Submit(spin, token);
+  auto second = async_db.Submit(spin, token);
+  // A query using a different token finishing doesn't affect the others.
+  EXPECT_EQ(async_db.Submit([](gel::GelDb &db) { return db.GetManufacturers(); }).get().size(), 1);
+
+  // An interrupt that arrives between statements has no effect, so keep trying.
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while ((first.wait_for(std::chrono::milliseconds(10)) == std::future_status::timeout
+      || second.wait_for(std::chrono::milliseconds(0)) == std::future_status::timeout)
+      && std::chrono::steady_clock::now() < deadline) {
+    token.Cancel();
+  }
+
+  stop = true;
+  EXPECT_THROW(first.get(), except::QueryCancelled);
+  EXPECT_THROW(second.get(), except::QueryCancelled);
+}
+
+TEST_F(AsyncDbTest, TestReadDuringUpdate) {
+  gel::GelDb writer(defs_file_path_.string(), db_path_.string(), true);
+  AsyncDb<gel::GelDb> async_db(CreatePool(4), std::make_shared<WorkerPool>(4));
+  std::atomic_bool updating = true;
+  std::vector<std::future<unsigned int>> readers;
+  for (unsigned int i = 0; i < 4; ++i) {
+    readers.push_back(async_db.Submit([&updating](gel::GelDb &db) {
+      unsigned int reads = 0;
+      do {
+        // Each update replaces every record in one transaction, so readers always see a complete library.
+        const auto manufacturers = db.GetManufacturers();
+        EXPECT_EQ(manufacturers.size(), 1);
+        EXPECT_EQ(db.GetGelForSeries(db.GetSeriesForManufacturer(manufacturers.at(0)).at(0)).size(), 2);
+        ++reads;
+      } while (updating);
+      return reads;
+    }));
+  }
+  for (unsigned int i = 0; i < 5; ++i) {
+    writer.Update();
+  }
+  updating = false;
+
+  for (auto &reader : readers) {
+    EXPECT_GT(reader.get(), 0);
+  }
+}
@@ -0,0 +1,70 @@
+/**
+ * @file ColorIndexTest.cpp
+ *
+ * @author dankeenan
+ * @date 5/16/21
+ * @copyright (c) 2021 Dan Keenan
+ */
+
+#include <gtest/gtest.h>
+#include <cslibs/gel/ColorIndex.h>
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+using namespace cslibs::gel;
+
+TEST(ColorIndexTest, TestMatchesBruteForce) {
+  std::mt19937 generator(1234);
+  std::uniform_real_distribution<float> distribution(0, 255);
+  std::vector<ColorIndex::Point> points(500);
+  for (auto &point : points) {
+    point = {distribution(generator), distribution(generator), distribution(generator)};
+  }
+  const ColorIndex index(points);
+
+  for (unsigned int query_ix = 0; query_ix < 50; ++query_ix) {
+    const ColorIndex::Point query{distribution(generator), distribution(generator), distribution(generator)};
+    std::vector<std::pair<float, std::size_t>> expected;
+    for (std::size_t ix = 0; ix < points.size(); ++ix) {
+      const float distance = std::sqrt(std::pow(points[ix][0] - query[0], 2.0f)
+                                           + std::pow(points[ix][1] - query[1], 2.0f)
+                                           + std::pow(points[ix][2] - query[2], 2.0f));
+      expected.emplace_back(distance, ix);
+    }
+    std::sort(expected.begin(), expected.end());
+
+    const auto matches = index.FindNearest(query, 5);
+    ASSERT_EQ(matches.size(), 5);
+    for (std::size_t ix = 0; ix < matches.size(); ++ix) {
+      EXPECT_EQ(matches[ix].index, expected[ix].second);
+      EXPECT_NEAR(matches[ix].distance, expected[ix].first, 0.001);
+    }
+  }
+}
+
+TEST(ColorIndexTest, TestSmall) {
+  const ColorIndex empty_index({});
+  EXPECT_TRUE(empty_index.FindNearest({0, 0, 0}, 3).empty());
+
+  const ColorIndex index({{0, 0, 0}, {10, 0, 0}});
+  const auto matches = index.FindNearest({9, 0, 0}, 3);
+  ASSERT_EQ(matches.size(), 2);
+  EXPECT_EQ(matches[0].index, 1);
+  EXPECT_EQ(matches[1].index, 0);
+  EXPECT_TRUE(index.FindNearest({9, 0, 0}, 0).empty());
+}
+
+TEST(ColorIndexTest, TestRgbToLab) {
+  const auto white = ColorIndex::RgbToLab(255, 255, 255);
+  EXPECT_NEAR(white[0], 100, 0.01);
+  EXPECT_NEAR(white[1], 0, 0.01);
+  EXPECT_NEAR(white[2], 0, 0.01);
+  const auto black = ColorIndex::RgbToLab(0, 0, 0);
+  EXPECT_NEAR(black[0], 0, 0.01);
+  // Reference value for sRGB red
+  const auto red = ColorIndex::RgbToLab(255, 0, 0);
+  EXPECT_NEAR(red[0], 53.24, 0.01);
+  EXPECT_NEAR(red[1], 80.09, 0.01);
+  EXPECT_NEAR(red[2], 67.20, 0.01);
+}
@@ -8,7 +8,9 @@
 
 #include <gtest/gtest.h>
 #include <cslibs/DefsFile.h>
+#include <cslibs/except.h>
 #include <filesystem>
+#include <regex>
 
 using namespace cslibs;
 
@@ -52,6 +54,32 @@ ENDDATA
   )EOF";
 
  protected:
+  // Lines that are easy to get wrong when matching by hand.
+  static inline auto kEdgeCaseData = "IDENT 3:0\r\n"
+                                     "$CARALLONVERSION 12.1.0\r\n"
+                                     "$SOFTWAREVERSION V5.0 R0\n"
+                                     "$GEL\r\n"
+                                     "$$DCID 6356B5B5-0127-2D47-AC1C-5AD540D7D7D9\r\n"
+                                     "$$GELINFO 1050,Soft Diffusion,254,255,251 \r\n"
+                                     "$$GELINFO 1051,Duplicate key\n"
+                                     "$$EMPTY \r\n"
+                                     "$$EMPTY2 \n"
+                                     "$$TAB\tvalue\n"
+                                     "$$TWO  spaces\n"
+                                     "$$CR mid\rline\n"
+                                     "$$TRAILING spaces  \n"
+                                     "$$ \n"
+                                     "$\n"
+                                     "$BAD NAME\n"
+                                     "$GEL \r\n"
+                                     "$GEL\t\n"
+                                     "! $GEL\n"
+                                     "$$DCID 4F5EC26C-D332-C146-8988-AEBA12B52916\n"
+                                     "$GEL_2\n"
+                                     "$$GELINFO last\n"
+                                     "$GEL\n"
+                                     "$$NO_NEWLINE at end";
+
   std::filesystem::path data_file_path_;
 
   void SetUp() override {
@@ -65,6 +93,45 @@ ENDDATA
   void TearDown() override {
     std::filesystem::remove(data_file_path_);
   }
+
+  /**
+   * Reference implementation of DefsFile::GetNextRecord() using regular expressions.
+   */
+  static std::vector<DefsFile::Def> LoadWithRegex(const std::filesystem::path &path) {
+    std::ifstream file_stream(path, std::ifstream::in | std::ifstream::binary);
+    file_stream.unsetf(std::ifstream::skipws);
+    static const std::regex record_name_re(R"(^\$(\w+)\s?$)", std::regex::ECMAScript);
+    static const std::regex record_content_re(R"(^\$\$(\w+) (.+)\s?$)", std::regex::ECMAScript);
+    std::vector<DefsFile::Def> records;
+    std::string line;
+    while (std::getline(file_stream, line)) {
+      std::smatch record_name_match;
+      if (!std::regex_match(line, record_name_match, record_name_re)) {
+        continue;
+      }
+      DefsFile::Def record(record_name_match[1]);
+      while (std::getline(file_stream, line)) {
+        std::smatch record_content_match;
+        if (std::regex_match(line, record_content_match, record_content_re)) {
+          record.contents.insert({record_content_match[1], record_content_match[2]});
+        } else if (std::regex_match(line, record_name_re)) {
+          file_stream.seekg(line.size() * -1 - 1, std::ifstream::cur);
+          break;
+        }
+      }
+      records.push_back(std::move(record));
+    }
+    return records;
+  }
+
+  static std::vector<DefsFile::Def> LoadWithDefsFile(const std::filesystem::path &path) {
+    DefsFile defs_file(path.string());
+    std::vector<DefsFile::Def> records;
+    while (auto record = defs_file.GetNextRecord()) {
+      records.push_back(std::move(*record));
+    }
+    return records;
+  }
 };
 
 TEST_F(DefsFileTest, TestLoad) {
@@ -93,3 +160,60 @@ TEST_F(DefsFileTest, TestLoad) {
   EXPECT_EQ(records[1].contents["GELMANUFACTURER"], "Apollo,Gel");
   EXPECT_EQ(records[1].contents["GELINFO"], "1100,Hard Diffusion,254,255,244");
 }
+
+TEST_F(DefsFileTest, TestLoadMatchesRegex) {
+  EXPECT_EQ(LoadWithRegex(data_file_path_), LoadWithDefsFile(data_file_path_));
+
+  std::ofstream data_file(data_file_path_, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+  data_file << kEdgeCaseData;
+  data_file.close();
+  const auto expected = LoadWithRegex(data_file_path_);
+  ASSERT_EQ(expected.size(), 4);
+  EXPECT_EQ(expected, LoadWithDefsFile(data_file_path_));
+}
+
+TEST_F(DefsFileTest, TestLoadView) {
+  DefsFile defs_file(data_file_path_.string());
+
+  std::vector<DefsFile::DefView> records;
+  while (auto record = defs_file.GetNextRecordView()) {
+    records.push_back(record.value());
+  }
+  ASSERT_EQ(records.size(), 2);
+
+  EXPECT_EQ(records[0].record_name, "GEL");
+  EXPECT_EQ(records[0].Get("DCID"), "6356B5B5-0127-2D47-AC1C-5AD540D7D7D9");
+  EXPECT_EQ(records[0].Get("GELINFO"), "1050,Soft Diffusion,254,255,251");
+  EXPECT_FALSE(records[0].Get("IMAGE").has_value());
+
+  const auto gel_info = DefsFile::SplitValue(*records[1].Get("GELINFO"));
+  const std::vector<std::string_view> expected_info{"1100", "Hard Diffusion", "254", "255", "244"};
+  EXPECT_EQ(std::vector<std::string_view>(gel_info.cbegin(), gel_info.cend()), expected_info);
+  EXPECT_EQ(DefsFile::SplitValue("").size(), 1);
+  EXPECT_EQ(DefsFile::SplitValue("a,,b").size(), 3);
+}
+
+TEST_F(DefsFileTest, TestProbeHeader) {
+  const auto header = DefsFile::ProbeHeader(data_file_path_.string());
+  EXPECT_TRUE(header.IsValid());
+  EXPECT_EQ(header.ident, "3:0");
+  EXPECT_EQ(header.version, DefsFile::Version(12, 1, 0));
+
+  // Only the start of the file is read
+  std::ofstream data_file(data_file_path_, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+  data_file << "! Padding\n";
+  for (unsigned int i = 0; i < 1000; ++i) {
+    data_file << "!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!\n";
+  }
+  data_file << "IDENT 3:0\n$CARALLONVERSION 12.1.0\n";
+  data_file.close();
+  EXPECT_FALSE(DefsFile::ProbeHeader(data_file_path_.string()).IsValid());
+}
+
+TEST_F(DefsFileTest, TestInvalid) {
+  std::ofstream data_file(data_file_path_, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+  data_file << "IDENT 2:0\n$CARALLONVERSION 12.1.0\n";
+  data_file.close();
+  EXPECT_FALSE(DefsFile::ProbeHeader(data_file_path_.string()).IsValid());
+  EXPECT_THROW(DefsFile defs_file(data_file_path_.string()), except::DefsError);
+}
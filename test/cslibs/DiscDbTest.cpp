@@ -446,6 +446,7 @@ ENDDATA
   void TearDown() override {
     std::filesystem::remove(defs_file_path_);
     std::filesystem::remove(data_index_path_);
+    std::filesystem::remove(data_index_path_.string() + ".bin");
     std::filesystem::remove(data_path_);
     std::filesystem::remove(db_path_);
   }
@@ -718,6 +718,7 @@ A78836E9-9441-4C4F-83F2-EFEDF2AEED6D,5319,effect,038900R33002.png
   void TearDown() override {
     std::filesystem::remove(defs_file_path_);
     std::filesystem::remove(data_index_path_);
+    std::filesystem::remove(data_index_path_.string() + ".bin");
     std::filesystem::remove(data_path_);
     std::filesystem::remove(db_path_);
   }
@@ -167,3 +167,149 @@ TEST_F(GelDbTest, TestGetForSeries) {
   EXPECT_EQ(expected_gels_name_order, gel_db.GetGelForSeries(expected_series.front(), gel::GelDb::Sort::kName));
   EXPECT_EQ(expected_gels_color_order, gel_db.GetGelForSeries(expected_series.front(), gel::GelDb::Sort::kColor));
 }
+
+TEST_F(GelDbTest, TestFailedUpdateRollsBack) {
+  gel::GelDb gel_db = CreateDb(true);
+  gel_db.Update();
+  ASSERT_TRUE(gel_db.UpToDate());
+
+  // Newer version with a broken record after a good one
+  std::ofstream defs_file(defs_file_path_, std::ofstream::out | std::ofstream::trunc);
+  defs_file << R"EOF(
+IDENT 3:0
+$CARALLONVERSION 12.2.0
+
+$GEL
+$$DCID 6356B5B5-0127-2D47-AC1C-5AD540D7D7D9
+$$GELMANUFACTURER Apollo,Gel
+$$GELINFO 1050,Soft Diffusion,254,255,251
+
+$GEL
+$$DCID 4F5EC26C-D332-C146-8988-AEBA12B52916
+$$GELMANUFACTURER Apollo
+$$GELINFO 1100,Hard Diffusion,254,255,244
+
+ENDDATA
+)EOF";
+  defs_file.close();
+  EXPECT_ANY_THROW(gel_db.Update());
+
+  // Previous contents and version are kept
+  EXPECT_FALSE(gel_db.UpToDate());
+  const auto manufacturers = gel_db.GetManufacturers();
+  ASSERT_EQ(manufacturers.size(), 1);
+  const auto series = gel_db.GetSeriesForManufacturer(manufacturers.front());
+  ASSERT_EQ(series.size(), 1);
+  EXPECT_EQ(gel_db.GetGelForSeries(series.front()).size(), 2);
+}
+
+TEST_F(GelDbTest, TestSortIgnoresCase) {
+  std::ofstream defs_file(defs_file_path_, std::ofstream::out | std::ofstream::trunc);
+  defs_file << R"EOF(
+IDENT 3:0
+$CARALLONVERSION 12.1.0
+
+$GEL
+$$DCID A
+$$GELMANUFACTURER Apollo,Gel
+$$GELINFO b,blue,0,0,255
+
+$GEL
+$$DCID B
+$$GELMANUFACTURER Apollo,Gel
+$$GELINFO _,_Underscore,0,0,0
+
+$GEL
+$$DCID C
+$$GELMANUFACTURER Apollo,Gel
+$$GELINFO A,Amber,255,191,0
+
+ENDDATA
+)EOF";
+  defs_file.close();
+  gel::GelDb gel_db = CreateDb(true);
+  gel_db.Update();
+
+  // Same order as boost::algorithm::ilexicographical_compare, which sorts "_" after letters.
+  const Series series(1, "Gel");
+  std::vector<std::string> codes;
+  for (const auto &gel : gel_db.GetGelForSeries(series, gel::GelDb::Sort::kCode)) {
+    codes.push_back(gel.GetCode());
+  }
+  EXPECT_EQ(codes, (std::vector<std::string>{"A", "b", "_"}));
+  std::vector<std::string> names;
+  for (const auto &gel : gel_db.GetGelForSeries(series, gel::GelDb::Sort::kName)) {
+    names.push_back(gel.GetName());
+  }
+  EXPECT_EQ(names, (std::vector<std::string>{"Amber", "blue", "_Underscore"}));
+}
+
+TEST_F(GelDbTest, TestFindNearest) {
+  gel::GelDb gel_db = CreateDb(true);
+  gel_db.Update();
+
+  const auto nearest = gel_db.FindNearest(0xFEFFF0, 1, gel::GelDb::Metric::kRgb);
+  ASSERT_EQ(nearest.size(), 1);
+  EXPECT_EQ(nearest.front().gel.GetDcid(), "4F5EC26C-D332-C146-8988-AEBA12B52916");
+  EXPECT_FLOAT_EQ(nearest.front().distance, 4);
+
+  const auto all = gel_db.FindNearest(0xFFFFFF, 5);
+  ASSERT_EQ(all.size(), 2);
+  EXPECT_EQ(all[0].gel.GetDcid(), "6356B5B5-0127-2D47-AC1C-5AD540D7D7D9");
+  EXPECT_EQ(all[1].gel.GetDcid(), "4F5EC26C-D332-C146-8988-AEBA12B52916");
+  EXPECT_LT(all[0].distance, all[1].distance);
+
+  // Another connection importing different colors is noticed.
+  gel::GelDb reader = CreateDb();
+  ASSERT_EQ(reader.FindNearest(0xFEFFF0, 1, gel::GelDb::Metric::kRgb).front().gel.GetDcid(),
+            "4F5EC26C-D332-C146-8988-AEBA12B52916");
+  std::string defs_contents;
+  {
+    std::ifstream defs_file(defs_file_path_);
+    defs_contents.assign(std::istreambuf_iterator<char>(defs_file), std::istreambuf_iterator<char>());
+  }
+  defs_contents.replace(defs_contents.find("254,255,244"), 11, "0,0,0");
+  {
+    std::ofstream defs_file(defs_file_path_, std::ofstream::trunc);
+    defs_file << defs_contents;
+  }
+  gel_db.Update();
+  EXPECT_EQ(reader.FindNearest(0xFEFFF0, 1, gel::GelDb::Metric::kRgb).front().gel.GetDcid(),
+            "6356B5B5-0127-2D47-AC1C-5AD540D7D7D9");
+}
+
+TEST_F(GelDbTest, TestSearch) {
+  auto gel_db = std::make_shared<gel::GelDb>(CreateDb(true));
+  gel_db->Update();
+
+  const auto results = gel::GelDb::SearchAll({nullptr, gel_db}, "diffusion", 1);
+  ASSERT_EQ(results.size(), 1);
+  EXPECT_EQ(results.front().first, 1);
+  const auto gel = gel_db->GetGelForId(results.front().second.id);
+  ASSERT_TRUE(gel.has_value());
+  EXPECT_EQ(gel->GetName(), results.front().second.name);
+  EXPECT_EQ(gel_db->Search("hard", 10).size(), 1);
+
+  // Ranks from different databases are comparable, and matches without the full-text index come last.
+  const auto other_db_path = db_path_.string() + "_other";
+  auto other_gel_db = std::make_shared<gel::GelDb>(defs_file_path_.string(), other_db_path, true);
+  other_gel_db->Update();
+  {
+    SQLite::Database db(other_db_path, SQLite::OPEN_READWRITE);
+    db.exec("DROP TABLE search;");
+  }
+  const auto merged = gel::GelDb::SearchAll({other_gel_db, gel_db, gel_db}, "diffusion", 10);
+  const auto single = gel_db->Search("diffusion", 10);
+  ASSERT_EQ(merged.size(), single.size() * 3);
+  EXPECT_DOUBLE_EQ(merged.front().second.rank, -1);
+  for (std::size_t ix = 0; ix < single.size() * 2; ++ix) {
+    EXPECT_NE(merged[ix].first, 0);
+    EXPECT_LT(merged[ix].second.rank, 0);
+  }
+  for (std::size_t ix = single.size() * 2; ix < merged.size(); ++ix) {
+    EXPECT_EQ(merged[ix].first, 0);
+    EXPECT_GT(merged[ix].second.rank, 0);
+  }
+  other_gel_db.reset();
+  std::filesystem::remove(other_db_path);
+}
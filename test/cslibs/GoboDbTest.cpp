@@ -7,6 +7,7 @@
  */
 
 #include <gtest/gtest.h>
+#include <cslibs/DcidResolver.h>
 #include <cslibs/gobo/GoboDb.h>
 #include <filesystem>
 
@@ -740,6 +741,7 @@ D40A4E71-8CB1-9A48-9D36-793290AFD829,5730,gobo,059900CS-0005.png
   void TearDown() override {
     std::filesystem::remove(defs_file_path_);
     std::filesystem::remove(data_index_path_);
+    std::filesystem::remove(data_index_path_.string() + ".bin");
     std::filesystem::remove(data_path_);
     std::filesystem::remove(db_path_);
   }
@@ -820,3 +822,271 @@ TEST_F(GoboDbTest, TestGetForSeries) {
   };
   EXPECT_EQ(expected_gobos, gobo_db.GetForSeries(expected_series.front()));
 }
+
+TEST_F(GoboDbTest, TestGetInfoForSeries) {
+  gobo::GoboDb gobo_db = CreateDb(true);
+  gobo_db.Update();
+  ASSERT_TRUE(gobo_db.UpToDate());
+
+  const std::vector<ImageEntityInfo> expected_gobos{
+      ImageEntityInfo("FDBB42B2-9242-154D-B536-55BD54EF9E93", "0004", "Blue Cauldron"),
+      ImageEntityInfo("D40A4E71-8CB1-9A48-9D36-793290AFD829", "0005", "Firework Splatter"),
+  };
+  EXPECT_EQ(expected_gobos, gobo_db.GetInfoForSeries(Series(1, "Colour Scenic gobos")));
+}
+
+TEST_F(GoboDbTest, TestGetImagesForDcids) {
+  gobo::GoboDb gobo_db = CreateDb(true);
+  gobo_db.Update();
+  ASSERT_TRUE(gobo_db.UpToDate());
+
+  const std::unordered_map<std::string, std::vector<char>> expected_images{
+      {"FDBB42B2-9242-154D-B536-55BD54EF9E93", std::vector<char>(kAp0004Image, kAp0004Image + sizeof(kAp0004Image))},
+      {"D40A4E71-8CB1-9A48-9D36-793290AFD829", std::vector<char>(kAp0005Image, kAp0005Image + sizeof(kAp0005Image))},
+  };
+  EXPECT_EQ(expected_images, gobo_db.GetImagesForDcids({
+      "FDBB42B2-9242-154D-B536-55BD54EF9E93",
+      "00000000-0000-0000-0000-000000000000",
+      "D40A4E71-8CB1-9A48-9D36-793290AFD829",
+  }));
+  EXPECT_TRUE(gobo_db.GetImagesForDcids({}).empty());
+}
+
+TEST_F(GoboDbTest, TestThumbnails) {
+  gobo::GoboDb gobo_db = CreateDb(true);
+  // Not a real renderer; the thumbnail is the size followed by the first byte of the image.
+  gobo_db.SetThumbnailRenderer([](std::string_view image, unsigned int size) -> std::optional<std::vector<char>> {
+    return std::vector<char>{static_cast<char>(size), image.front()};
+  });
+  gobo_db.Update();
+  ASSERT_TRUE(gobo_db.UpToDate());
+
+  const std::unordered_map<std::string, std::vector<char>> expected_thumbnails{
+      {"FDBB42B2-9242-154D-B536-55BD54EF9E93", {32, static_cast<char>(kAp0004Image[0])}},
+      {"D40A4E71-8CB1-9A48-9D36-793290AFD829", {32, static_cast<char>(kAp0005Image[0])}},
+  };
+  EXPECT_EQ(expected_thumbnails, gobo_db.GetThumbnailsForDcids({
+      "FDBB42B2-9242-154D-B536-55BD54EF9E93",
+      "D40A4E71-8CB1-9A48-9D36-793290AFD829",
+  }, 32));
+  EXPECT_EQ(gobo_db.GetThumbnailForId(1, 64), (std::vector<char>{64, static_cast<char>(kAp0004Image[0])}));
+  EXPECT_FALSE(gobo_db.GetThumbnailForId(1, 16).has_value());
+
+  // Without a renderer there are no thumbnails.
+  gobo_db.SetThumbnailRenderer({});
+  gobo_db.Update();
+  EXPECT_TRUE(gobo_db.GetThumbnailsForDcids({"FDBB42B2-9242-154D-B536-55BD54EF9E93"}, 32).empty());
+}
+
+TEST_F(GoboDbTest, TestSearch) {
+  gobo::GoboDb gobo_db = CreateDb(true);
+  gobo_db.Update();
+  ASSERT_TRUE(gobo_db.UpToDate());
+
+  const auto get_dcids = [&gobo_db](const std::string &query) {
+    std::vector<std::string> dcids;
+    for (const auto &result : gobo_db.Search(query, 10)) {
+      dcids.push_back(result.dcid);
+    }
+    return dcids;
+  };
+  const auto check_search = [&get_dcids]() {
+    EXPECT_EQ(get_dcids("blue"), std::vector<std::string>{"FDBB42B2-9242-154D-B536-55BD54EF9E93"});
+    EXPECT_EQ(get_dcids("FIRE"), std::vector<std::string>{"D40A4E71-8CB1-9A48-9D36-793290AFD829"});
+    EXPECT_EQ(get_dcids("apollo 0005"), std::vector<std::string>{"D40A4E71-8CB1-9A48-9D36-793290AFD829"});
+    EXPECT_EQ(get_dcids("scenic").size(), 2);
+    EXPECT_TRUE(get_dcids("blue firework").empty());
+    EXPECT_TRUE(get_dcids("  ").empty());
+    EXPECT_TRUE(get_dcids("\"").empty());
+  };
+  check_search();
+  const auto results = gobo_db.Search("cauldron", 10);
+  ASSERT_EQ(results.size(), 1);
+  EXPECT_EQ(results.front().code, "0004");
+  EXPECT_EQ(results.front().name, "Blue Cauldron");
+  EXPECT_EQ(results.front().manufacturer, "Apollo");
+  EXPECT_EQ(results.front().series, "Colour Scenic gobos");
+
+  // Without the full-text index
+  {
+    SQLite::Database db(db_path_.string(), SQLite::OPEN_READWRITE);
+    db.exec("DROP TABLE search;");
+  }
+  check_search();
+}
+
+TEST_F(GoboDbTest, TestImageReferences) {
+  gobo::GoboDb gobo_db = CreateDb(true);
+  gobo_db.SetImageStorage(ImageDb::ImageStorage::kReference);
+  gobo_db.Update();
+  ASSERT_TRUE(gobo_db.UpToDate());
+
+  const std::vector<ImageEntity> expected_gobos{
+      ImageEntity("FDBB42B2-9242-154D-B536-55BD54EF9E93",
+                  "0004",
+                  "Blue Cauldron",
+                  kAp0004Image,
+                  sizeof(kAp0004Image)),
+      ImageEntity("D40A4E71-8CB1-9A48-9D36-793290AFD829",
+                  "0005",
+                  "Firework Splatter",
+                  kAp0005Image,
+                  sizeof(kAp0005Image)),
+  };
+  const Series series(1, "Colour Scenic gobos");
+  EXPECT_EQ(expected_gobos, gobo_db.GetForSeries(series));
+  const auto image = gobo_db.GetImageForDcid("D40A4E71-8CB1-9A48-9D36-793290AFD829");
+  ASSERT_TRUE(image.has_value());
+  EXPECT_EQ(expected_gobos.at(1).GetImage(), *image);
+
+  // The data file changed, so the references can't be used.
+  std::ofstream data_file(data_path_, std::ofstream::out | std::ofstream::binary | std::ofstream::app);
+  data_file << "More data";
+  data_file.close();
+  gobo::GoboDb changed_gobo_db = CreateDb(true);
+  EXPECT_FALSE(changed_gobo_db.UpToDate());
+  EXPECT_FALSE(changed_gobo_db.GetImageForDcid("D40A4E71-8CB1-9A48-9D36-793290AFD829").has_value());
+
+  // Updating again in blob mode doesn't depend on the data file.
+  changed_gobo_db.Update();
+  EXPECT_TRUE(changed_gobo_db.UpToDate());
+}
+
+TEST_F(GoboDbTest, TestImageReferencesMoved) {
+  {
+    gobo::GoboDb gobo_db = CreateDb(true);
+    gobo_db.SetImageStorage(ImageDb::ImageStorage::kReference);
+    gobo_db.Update();
+  }
+
+  // Moving the data file keeps its size and modification time, so the references still work.
+  const auto old_data_path = data_path_;
+  data_path_ += "-moved";
+  std::filesystem::rename(old_data_path, data_path_);
+  {
+    gobo::GoboDb gobo_db = CreateDb(true);
+    gobo_db.SetImageStorage(ImageDb::ImageStorage::kReference);
+    EXPECT_TRUE(gobo_db.UpToDate());
+    EXPECT_TRUE(gobo_db.GetImageForDcid("D40A4E71-8CB1-9A48-9D36-793290AFD829").has_value());
+    // The next import copies the images instead of relying on the data file.
+    gobo_db.Update();
+  }
+  const auto get_images_without_data_file = [this]() {
+    const auto hidden_data_path = std::filesystem::path(data_path_) += "-hidden";
+    std::filesystem::rename(data_path_, hidden_data_path);
+    gobo::GoboDb gobo_db = CreateDb(true);
+    EXPECT_TRUE(gobo_db.UpToDate());
+    const auto image = gobo_db.GetImageForDcid("D40A4E71-8CB1-9A48-9D36-793290AFD829");
+    std::filesystem::rename(hidden_data_path, data_path_);
+    return image;
+  };
+  EXPECT_TRUE(get_images_without_data_file().has_value());
+
+  // The fallback sticks.
+  {
+    gobo::GoboDb gobo_db = CreateDb(true);
+    gobo_db.SetImageStorage(ImageDb::ImageStorage::kReference);
+    gobo_db.Update();
+  }
+  EXPECT_TRUE(get_images_without_data_file().has_value());
+}
+
+TEST_F(GoboDbTest, TestImageReferencesChangedWhileOpen) {
+  gobo::GoboDb gobo_db = CreateDb(true);
+  gobo_db.SetImageStorage(ImageDb::ImageStorage::kReference);
+  gobo_db.Update();
+  const std::string dcid("D40A4E71-8CB1-9A48-9D36-793290AFD829");
+  const auto image = gobo_db.GetImageForDcid(dcid);
+  ASSERT_TRUE(image.has_value());
+
+  // The same connection notices that the data file has been rewritten.
+  const auto original_path = std::filesystem::path(data_path_) += "-original";
+  std::filesystem::copy_file(data_path_, original_path);
+  const auto original_modified = std::filesystem::last_write_time(data_path_);
+  {
+    std::ofstream data_file(data_path_, std::ofstream::out | std::ofstream::binary | std::ofstream::app);
+    data_file << "More data";
+  }
+  EXPECT_FALSE(gobo_db.GetImageForDcid(dcid).has_value());
+
+  // A missing data file is looked for again.
+  std::filesystem::remove(data_path_);
+  EXPECT_FALSE(gobo_db.GetImageForDcid(dcid).has_value());
+  std::filesystem::copy_file(original_path, data_path_);
+  std::filesystem::last_write_time(data_path_, original_modified);
+  EXPECT_EQ(gobo_db.GetImageForDcid(dcid), image);
+  std::filesystem::remove(original_path);
+}
+
+TEST_F(GoboDbTest, TestMigrate) {
+  // Database from before schema versions were tracked, loaded with duplicate dcids
+  {
+    gobo::GoboDb gobo_db = CreateDb(true);
+  }
+  {
+    SQLite::Database db(db_path_.string(), SQLite::OPEN_READWRITE);
+    db.exec(R"EOF(
+      CREATE TABLE manufacturer (id INTEGER PRIMARY KEY, name TEXT NOT NULL);
+      CREATE TABLE series (id INTEGER PRIMARY KEY, manufacturer_id INTEGER NOT NULL, name TEXT NOT NULL);
+      CREATE TABLE gobo
+      (
+          id        INTEGER PRIMARY KEY,
+          dcid      TEXT    NOT NULL,
+          series_id INTEGER NOT NULL,
+          code      TEXT    NOT NULL,
+          name      TEXT    NOT NULL,
+          image     BLOB    NOT NULL
+      );
+      INSERT INTO manufacturer(id, name) VALUES (1, 'Apollo');
+      INSERT INTO series(id, manufacturer_id, name) VALUES (1, 1, 'Colour Scenic gobos');
+      INSERT INTO gobo(dcid, series_id, code, name, image) VALUES ('A', 1, '0001', 'First', x'01');
+      INSERT INTO gobo(dcid, series_id, code, name, image) VALUES ('A', 1, '0002', 'Duplicate', x'02');
+      INSERT INTO gobo(dcid, series_id, code, name, image) VALUES ('B', 1, '0003', 'Other', x'03');
+    )EOF");
+  }
+
+  gobo::GoboDb gobo_db = CreateDb(true);
+  gobo_db.Migrate();
+  EXPECT_EQ(gobo_db.GetImageForDcid("A"), std::vector<char>{0x01});
+  EXPECT_EQ(gobo_db.GetImageForDcid("B"), std::vector<char>{0x03});
+  EXPECT_EQ(gobo_db.GetForSeries(Series(1, "Colour Scenic gobos")).size(), 2);
+  // Migrating again does nothing
+  gobo_db.Migrate();
+
+  {
+    SQLite::Database db(db_path_.string(), SQLite::OPEN_READONLY);
+    EXPECT_EQ(db.execAndGet("SELECT COUNT(*) FROM sqlite_master WHERE name = 'gobo_dcid_index';").getInt(), 1);
+  }
+
+  // Loading replaces the old table
+  gobo_db.Update();
+  EXPECT_TRUE(gobo_db.UpToDate());
+  EXPECT_FALSE(gobo_db.GetImageForDcid("A").has_value());
+  EXPECT_TRUE(gobo_db.GetImageForDcid("FDBB42B2-9242-154D-B536-55BD54EF9E93").has_value());
+}
+
+TEST_F(GoboDbTest, TestDcidResolver) {
+  auto gobo_db = std::make_shared<gobo::GoboDb>(CreateDb(true));
+  gobo_db->Update();
+  ASSERT_TRUE(gobo_db->UpToDate());
+  const auto other_db_path = db_path_.string() + "_other";
+  auto other_gobo_db = std::make_shared<gobo::GoboDb>(
+      defs_file_path_.string(), data_index_path_.string(), data_path_.string(), other_db_path, true);
+  other_gobo_db->Update();
+
+  // Missing libraries are skipped and the first library with a dcid wins.
+  const DcidResolver resolver({nullptr, gobo_db, other_gobo_db});
+  EXPECT_EQ(resolver.GetSize(), 2);
+  const auto location = resolver.Resolve("FDBB42B2-9242-154D-B536-55BD54EF9E93");
+  ASSERT_TRUE(location.has_value());
+  EXPECT_EQ(location->library, 1);
+  EXPECT_FALSE(resolver.Resolve("00000000-0000-0000-0000-000000000000").has_value());
+
+  const auto image = resolver.GetImageForDcid("FDBB42B2-9242-154D-B536-55BD54EF9E93");
+  ASSERT_TRUE(image.has_value());
+  EXPECT_EQ(*image, std::vector<char>(kAp0004Image, kAp0004Image + sizeof(kAp0004Image)));
+  EXPECT_FALSE(resolver.GetImageForDcid("00000000-0000-0000-0000-000000000000").has_value());
+
+  other_gobo_db.reset();
+  std::filesystem::remove(other_db_path);
+}
@@ -0,0 +1,123 @@
+/**
+ * @file ImageDataIndexTest.cpp
+ *
+ * @author dankeenan
+ * @date 5/9/21
+ * @copyright (c) 2021 Dan Keenan
+ */
+
+#include <gtest/gtest.h>
+#include <cslibs/ImageDataIndex.h>
+#include <cslibs/except.h>
+#include <filesystem>
+#include <fstream>
+
+using namespace cslibs;
+
+class ImageDataIndexTest : public ::testing::Test {
+ private:
+  static inline auto kDataIndexContents = R"EOF(
+FDBB42B2-9242-154D-B536-55BD54EF9E93,0,gobo,059900CS-0004.png
+D40A4E71-8CB1-9A48-9D36-793290AFD829,5730,animation,059900CS-0005.png
+2FC47FB8-7C4F-4D4A-9E0A-2C6B0E1B7C1E,6000,gobo,059900CS-0006.png
+)EOF";
+
+ protected:
+  std::filesystem::path data_index_path_;
+
+  void SetUp() override {
+    data_index_path_ = std::filesystem::temp_directory_path() / std::tmpnam(nullptr);
+    std::ofstream data_index_file(data_index_path_);
+    data_index_file << kDataIndexContents;
+    data_index_file.close();
+  }
+
+  void TearDown() override {
+    std::filesystem::remove(data_index_path_);
+  }
+};
+
+TEST_F(ImageDataIndexTest, TestFind) {
+  const auto index = ImageDataIndex::Load(data_index_path_.string());
+
+  const auto first = index->Find("gobo", "FDBB42B2-9242-154D-B536-55BD54EF9E93");
+  ASSERT_TRUE(first.has_value());
+  EXPECT_EQ(first->offset, 0);
+  EXPECT_EQ(first->size, 5730);
+
+  const auto second = index->Find("animation", "D40A4E71-8CB1-9A48-9D36-793290AFD829");
+  ASSERT_TRUE(second.has_value());
+  EXPECT_EQ(second->offset, 5730);
+  EXPECT_EQ(second->size, 270);
+
+  const auto last = index->Find("gobo", "2FC47FB8-7C4F-4D4A-9E0A-2C6B0E1B7C1E");
+  ASSERT_TRUE(last.has_value());
+  EXPECT_EQ(last->offset, 6000);
+  EXPECT_EQ(last->size, -1);
+
+  // Wrong type
+  EXPECT_FALSE(index->Find("gobo", "D40A4E71-8CB1-9A48-9D36-793290AFD829").has_value());
+  EXPECT_FALSE(index->Find("effect", "FDBB42B2-9242-154D-B536-55BD54EF9E93").has_value());
+}
+
+TEST_F(ImageDataIndexTest, TestShared) {
+  const auto index = ImageDataIndex::Load(data_index_path_.string());
+  EXPECT_EQ(index, ImageDataIndex::Load(data_index_path_.string()));
+
+  // Changing the file loads it again
+  std::ofstream data_index_file(data_index_path_, std::ofstream::out | std::ofstream::app);
+  data_index_file << "4C1A1D1B-0E61-4F5B-8E0B-3A6C4B1D2E3F,7000,effect,059900CS-0007.png\n";
+  data_index_file.close();
+  const auto reloaded = ImageDataIndex::Load(data_index_path_.string());
+  EXPECT_NE(index, reloaded);
+  EXPECT_TRUE(reloaded->Find("effect", "4C1A1D1B-0E61-4F5B-8E0B-3A6C4B1D2E3F").has_value());
+}
+
+TEST_F(ImageDataIndexTest, TestMissing) {
+  std::filesystem::remove(data_index_path_);
+  EXPECT_THROW(static_cast<void>(ImageDataIndex::Load(data_index_path_.string())), except::DefsError);
+}
+
+TEST_F(ImageDataIndexTest, TestCacheFile) {
+  const std::filesystem::path cache_path = data_index_path_.string() + ".bin";
+  const auto built = ImageDataIndex::Load(data_index_path_.string(), cache_path.string());
+  EXPECT_FALSE(built->IsFromCache());
+  ASSERT_TRUE(std::filesystem::exists(cache_path));
+
+  // An identical index file uses the cache instead of being parsed.
+  const std::filesystem::path copy_path = data_index_path_.string() + ".copy";
+  std::filesystem::copy_file(data_index_path_, copy_path);
+  std::filesystem::last_write_time(copy_path, std::filesystem::last_write_time(data_index_path_));
+  const auto cached = ImageDataIndex::Load(copy_path.string(), cache_path.string());
+  EXPECT_TRUE(cached->IsFromCache());
+  for (const auto &index : {built, cached}) {
+    const auto position = index->Find("animation", "D40A4E71-8CB1-9A48-9D36-793290AFD829");
+    ASSERT_TRUE(position.has_value());
+    EXPECT_EQ(position->offset, 5730);
+    EXPECT_EQ(position->size, 270);
+    EXPECT_FALSE(index->Find("animation", "D40A4E71").has_value());
+  }
+
+  // A damaged cache is replaced.
+  std::filesystem::resize_file(cache_path, 40);
+  std::filesystem::last_write_time(copy_path, std::filesystem::last_write_time(copy_path) + std::chrono::seconds(1));
+  const auto rebuilt = ImageDataIndex::Load(copy_path.string(), cache_path.string());
+  EXPECT_FALSE(rebuilt->IsFromCache());
+  EXPECT_TRUE(rebuilt->Find("gobo", "2FC47FB8-7C4F-4D4A-9E0A-2C6B0E1B7C1E").has_value());
+  EXPECT_GT(std::filesystem::file_size(cache_path), 40);
+
+  // A cache that was cut short is replaced, even though its header is intact.
+  const auto cache_size = std::filesystem::file_size(cache_path);
+  const std::filesystem::path torn_path = data_index_path_.string() + ".torn";
+  std::filesystem::copy_file(copy_path, torn_path);
+  std::filesystem::last_write_time(torn_path, std::filesystem::last_write_time(copy_path));
+  std::filesystem::resize_file(cache_path, cache_size - 1);
+  const auto untorn = ImageDataIndex::Load(torn_path.string(), cache_path.string());
+  EXPECT_FALSE(untorn->IsFromCache());
+  EXPECT_TRUE(untorn->Find("gobo", "2FC47FB8-7C4F-4D4A-9E0A-2C6B0E1B7C1E").has_value());
+  EXPECT_EQ(std::filesystem::file_size(cache_path), cache_size);
+
+  std::filesystem::remove(torn_path);
+  std::filesystem::remove(copy_path);
+  std::filesystem::remove(cache_path);
+}
@@ -0,0 +1,96 @@
+/**
+ * @file ImportPipelineTest.cpp
+ *
+ * @author dankeenan
+ * @date 5/9/21
+ * @copyright (c) 2021 Dan Keenan
+ */
+
+#include <gtest/gtest.h>
+#include <cslibs/ImportPipeline.h>
+#include <cslibs/except.h>
+#include <filesystem>
+#include <fstream>
+
+using namespace cslibs;
+
+class ImportPipelineTest : public ::testing::Test {
+ protected:
+  static inline const unsigned int kRecordCount = 1000;
+
+  std::filesystem::path data_file_path_;
+
+  void SetUp() override {
+    data_file_path_ = std::filesystem::temp_directory_path() / std::tmpnam(nullptr);
+    std::ofstream data_file(data_file_path_);
+    data_file << "IDENT 3:0\n$CARALLONVERSION 12.1.0\n\n";
+    for (unsigned int i = 0; i < kRecordCount; ++i) {
+      data_file << "$ITEM\n$$NUMBER " << i << "\n\n";
+      // Other records are skipped
+      data_file << "$OTHER\n$$NUMBER " << i << "\n\n";
+    }
+    data_file.close();
+  }
+
+  void TearDown() override {
+    std::filesystem::remove(data_file_path_);
+  }
+
+  static unsigned int ParseNumber(const DefsFile::DefView &record) {
+    return std::stoul(std::string(*record.Get("NUMBER")));
+  }
+};
+
+TEST_F(ImportPipelineTest, TestOrder) {
+  DefsFile defs_file(data_file_path_.string());
+  std::vector<unsigned int> inserted;
+  ImportPipeline<unsigned int> pipeline(
+      "ITEM",
+      [](const DefsFile::DefView &record) -> std::optional<unsigned int> {
+        const unsigned int number = ParseNumber(record);
+        if (number % 10 == 0) {
+          return {};
+        }
+        return number;
+      },
+      [&inserted](unsigned int &number) { inserted.push_back(number); },
+      4);
+  unsigned long last_progress = 0;
+  pipeline.Run(defs_file, [&last_progress](unsigned long current, unsigned long total) {
+    EXPECT_GT(current, last_progress);
+    EXPECT_LE(current, total);
+    last_progress = current;
+  });
+
+  std::vector<unsigned int> expected;
+  for (unsigned int i = 0; i < kRecordCount; ++i) {
+    if (i % 10 != 0) {
+      expected.push_back(i);
+    }
+  }
+  EXPECT_EQ(inserted, expected);
+}
+
+TEST_F(ImportPipelineTest, TestParseError) {
+  DefsFile defs_file(data_file_path_.string());
+  std::vector<unsigned int> inserted;
+  ImportPipeline<unsigned int> pipeline(
+      "ITEM",
+      [](const DefsFile::DefView &record) -> std::optional<unsigned int> {
+        const unsigned int number = ParseNumber(record);
+        if (number == 500) {
+          throw except::DefsError("Bad record");
+        }
+        return number;
+      },
+      [&inserted](unsigned int &number) { inserted.push_back(number); },
+      4);
+  EXPECT_THROW(pipeline.Run(defs_file, {}), except::DefsError);
+
+  // Records before the bad one are inserted, in order.
+  ASSERT_GE(inserted.size(), 1);
+  for (unsigned int i = 0; i < inserted.size(); ++i) {
+    EXPECT_EQ(inserted.at(i), i);
+  }
+  EXPECT_LT(inserted.size(), 500);
+}
@@ -0,0 +1,96 @@
+/**
+ * @file JournalTest.cpp
+ *
+ * @author dankeenan
+ * @date 5/16/21
+ * @copyright (c) 2021 Dan Keenan
+ */
+
+#include <gtest/gtest.h>
+#include <csprofile/Journal.h>
+#include <csprofile/except.h>
+#include <filesystem>
+#include <fstream>
+
+using namespace csprofile;
+
+class JournalTest : public ::testing::Test {
+ protected:
+  std::filesystem::path journal_path_;
+
+  void SetUp() override {
+    journal_path_ = std::filesystem::temp_directory_path() / std::tmpnam(nullptr);
+  }
+
+  void TearDown() override {
+    std::filesystem::remove(journal_path_);
+  }
+
+  static Personality CreatePersonality(const std::string &model_name) {
+    Personality personality;
+    personality.SetModelName(model_name);
+    auto param = std::make_unique<parameter::IntensityParameter>();
+    param->SetAddressCourse(1);
+    param->ranges_.emplace_back(0, 255, 0);
+    personality.parameters_.push_back(std::move(param));
+    return personality;
+  }
+};
+
+TEST_F(JournalTest, TestReplay) {
+  Library original;
+  original.personalities.push_back(CreatePersonality("First"));
+  original.personalities.push_back(CreatePersonality("Second"));
+  original.personalities.push_back(CreatePersonality("Third"));
+
+  Library library(original);
+  {
+    Journal journal(journal_path_.string());
+    library.personalities.at(1).SetModeName("Basic");
+    journal.RecordUpdate(1, library.personalities.at(1));
+    library.personalities.insert(library.personalities.cbegin(), CreatePersonality("Zeroth"));
+    journal.RecordInsert(0, library.personalities.at(0));
+    library.personalities.erase(library.personalities.cbegin() + 2, library.personalities.cbegin() + 4);
+    journal.RecordRemove(2, 2);
+    EXPECT_GT(journal.GetSize(), 0);
+  }
+  {
+    // Reopening appends
+    Journal journal(journal_path_.string());
+    library.personalities.push_back(CreatePersonality("Last"));
+    journal.RecordInsert(2, library.personalities.at(2));
+  }
+
+  Library replayed(original);
+  EXPECT_EQ(Journal::Replay(journal_path_.string(), replayed), 4);
+  EXPECT_EQ(replayed, library);
+}
+
+TEST_F(JournalTest, TestIncompleteChange) {
+  Library library;
+  {
+    Journal journal(journal_path_.string());
+    journal.RecordInsert(0, CreatePersonality("First"));
+    journal.RecordInsert(1, CreatePersonality("Second"));
+  }
+  // Simulate a crash partway through writing the last change
+  std::filesystem::resize_file(journal_path_, std::filesystem::file_size(journal_path_) - 10);
+
+  EXPECT_EQ(Journal::Replay(journal_path_.string(), library), 1);
+  ASSERT_EQ(library.personalities.size(), 1);
+  EXPECT_EQ(library.personalities.at(0).GetModelName(), "First");
+}
+
+TEST_F(JournalTest, TestInvalidChange) {
+  {
+    Journal journal(journal_path_.string());
+    journal.RecordRemove(0, 1);
+  }
+  Library library;
+  EXPECT_THROW(Journal::Replay(journal_path_.string(), library), except::ParseError);
+
+  std::ofstream corrupt(journal_path_, std::ios::trunc);
+  corrupt << "not json\n" << R"({"op":"remove","row":0,"count":0})" << "\n";
+  corrupt.close();
+  EXPECT_THROW(Journal::Replay(journal_path_.string(), library), except::ParseError);
+}
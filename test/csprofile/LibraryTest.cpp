@@ -8,6 +8,10 @@
 
 #include <gtest/gtest.h>
 #include "csprofile/Library.h"
+#include "csprofile/except.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
 
 using namespace csprofile;
 
@@ -366,3 +370,338 @@ TEST(LibraryTest, SaveJson) {
   actual_stream << std::setw(4) << library << std::endl;
   EXPECT_EQ(expected, actual_stream.str());
 }
+
+TEST(LibraryTest, LoadMatchesJsonDocument) {
+  const auto json = R"EOF(
+{
+    "date": "2020-06-28T15:11:11Z",
+    "editorVersion": "1.1.1.9.0.4",
+    "unknown": {"personalities": [1, 2, {"a": [3]}]},
+    "personalities": [
+        {
+            "dcid": "EFDB8293-3E80-4048-908B-306E37842D59",
+            "manufacturerName": "Custom",
+            "modeName": "-",
+            "modelName": "first",
+            "parameters": [
+                {
+                    "coarse": 0,
+                    "fadeWithIntensity": false,
+                    "fine": 1,
+                    "home": 0,
+                    "invert": false,
+                    "name": "Hue",
+                    "size": 16,
+                    "snap": false,
+                    "type": 5
+                },
+                {
+                    "coarse": 2,
+                    "fadeWithIntensity": false,
+                    "fine": 3,
+                    "home": 0,
+                    "invert": true,
+                    "name": "Not a color",
+                    "size": 8,
+                    "snap": false,
+                    "type": 5
+                },
+                {
+                    "coarse": 4,
+                    "extra": [{"name": "Ignored"}],
+                    "fadeWithIntensity": false,
+                    "home": 12,
+                    "invert": false,
+                    "name": "Gobo",
+                    "ranges": [
+                        {
+                            "begin": 0,
+                            "default": 5,
+                            "end": 10,
+                            "label": "Stars",
+                            "media": {"dcid": "7F2FB4D2-2CB6-4C1E-8F40-4A5D4A4A6B2B", "name": "Stars"}
+                        },
+                        {
+                            "begin": 11,
+                            "default": 11,
+                            "end": 20.0,
+                            "label": "Open"
+                        }
+                    ],
+                    "size": 8,
+                    "snap": true,
+                    "type": 4
+                }
+            ]
+        },
+        {
+            "manufacturerName": "Acme",
+            "modeName": "Basic",
+            "modelName": "second",
+            "parameters": []
+        },
+        {
+            "manufacturerName": "Acme",
+            "modeName": "Null lists",
+            "modelName": "third",
+            "parameters": [
+                {
+                    "coarse": 0,
+                    "fadeWithIntensity": false,
+                    "home": 0,
+                    "invert": false,
+                    "name": "Gobo",
+                    "ranges": null,
+                    "size": 8,
+                    "snap": false,
+                    "type": 4
+                }
+            ]
+        },
+        {
+            "manufacturerName": "Acme",
+            "modeName": "No parameters",
+            "modelName": "fourth",
+            "parameters": null
+        }
+    ]
+}
+  )EOF";
+  std::stringstream json_stream(json);
+  Library library;
+  json_stream >> library;
+
+  const auto document = nlohmann::json::parse(json);
+  const auto &personalities_json = document.at("personalities");
+  ASSERT_EQ(library.personalities.size(), personalities_json.size());
+  for (unsigned int i = 0; i < personalities_json.size(); ++i) {
+    // DCIDs are not loaded from the file, so compare everything else
+    const auto expected = personalities_json.at(i).get<Personality>();
+    const auto &actual = library.personalities.at(i);
+    EXPECT_EQ(actual.GetManufacturerName(), expected.GetManufacturerName());
+    EXPECT_EQ(actual.GetModelName(), expected.GetModelName());
+    EXPECT_EQ(actual.GetModeName(), expected.GetModeName());
+    ASSERT_EQ(actual.parameters_.size(), expected.parameters_.size());
+    for (unsigned int j = 0; j < expected.parameters_.size(); ++j) {
+      EXPECT_EQ(*actual.parameters_.at(j), *expected.parameters_.at(j));
+    }
+  }
+  EXPECT_EQ(library.personalities.at(0).GetModeName(), "");
+  EXPECT_EQ(library.personalities.at(0).parameters_.at(1)->GetAddressFine(), 0);
+  EXPECT_EQ(library.personalities.at(0).parameters_.at(2)->ranges_.at(0).GetMedia()->GetGoboDcid(),
+            "7F2FB4D2-2CB6-4C1E-8F40-4A5D4A4A6B2B");
+  EXPECT_TRUE(library.personalities.at(2).parameters_.at(0)->ranges_.empty());
+  EXPECT_TRUE(library.personalities.at(3).parameters_.empty());
+
+  // A null list of personalities is empty, too.
+  std::stringstream null_stream(R"({"personalities": null})");
+  library.personalities.push_back(Personality());
+  null_stream >> library;
+  EXPECT_TRUE(library.personalities.empty());
+}
+
+TEST(LibraryTest, LoadInvalid) {
+  const std::vector<std::string> invalid_libraries{
+      // Invalid JSON
+      R"({"personalities": [)",
+      R"({"personalities": []} trailing)",
+      // Missing personalities
+      R"({"date": "2020-06-28T15:11:11Z"})",
+      R"([{"personalities": []}])",
+      // Bad personality
+      R"({"personalities": {}})",
+      R"({"personalities": [1]})",
+      R"({"personalities": [{"manufacturerName": "Custom", "modeName": "-", "modelName": "test"}]})",
+      R"({"personalities": [{"manufacturerName": 1, "modeName": "-", "modelName": "test", "parameters": []}]})",
+      // Bad parameter
+      R"({"personalities": [{"manufacturerName": "Custom", "modeName": "-", "modelName": "test", "parameters": [
+          {"coarse": 0, "fadeWithIntensity": false, "home": 0, "invert": false, "name": "Pan", "snap": false}
+      ]}]})",
+      R"({"personalities": [{"manufacturerName": "Custom", "modeName": "-", "modelName": "test", "parameters": [
+          {"coarse": 0, "fadeWithIntensity": false, "home": 0, "invert": false, "name": "Pan", "snap": false,
+           "type": 3}
+      ]}]})",
+      R"({"personalities": [{"manufacturerName": "Custom", "modeName": "-", "modelName": "test", "parameters": [
+          {"coarse": 0, "fadeWithIntensity": 0, "home": 0, "invert": false, "name": "Pan", "snap": false, "type": 2}
+      ]}]})",
+      R"({"personalities": [{"manufacturerName": "Custom", "modeName": "-", "modelName": "test", "parameters": [
+          {"coarse": 0, "fadeWithIntensity": false, "fine": 1, "home": 0, "invert": false, "name": "Pan",
+           "snap": false, "type": 2}
+      ]}]})",
+      // Bad range
+      R"({"personalities": [{"manufacturerName": "Custom", "modeName": "-", "modelName": "test", "parameters": [
+          {"coarse": 0, "fadeWithIntensity": false, "home": 0, "invert": false, "name": "Gobo", "snap": false,
+           "type": 4, "ranges": [{"begin": 0, "default": 0, "end": 10}]}
+      ]}]})",
+      // Bad media
+      R"({"personalities": [{"manufacturerName": "Custom", "modeName": "-", "modelName": "test", "parameters": [
+          {"coarse": 0, "fadeWithIntensity": false, "home": 0, "invert": false, "name": "Gobo", "snap": false,
+           "type": 4, "ranges": [{"begin": 0, "default": 0, "end": 10, "label": "Open", "media": {"name": "Open"}}]}
+      ]}]})",
+  };
+  for (const auto &invalid_library : invalid_libraries) {
+    std::stringstream json_stream(invalid_library);
+    Library library;
+    library.personalities.emplace_back();
+    EXPECT_THROW(json_stream >> library, except::ParseError) << invalid_library;
+    // The library is left alone
+    EXPECT_EQ(library.personalities.size(), 1);
+  }
+}
+
+TEST(LibraryTest, SaveMatchesJsonDocument) {
+  Library library;
+  library.SetUpdated(boost::posix_time::ptime(boost::gregorian::date(2020, 6, 28),
+                                              boost::posix_time::time_duration(15, 11, 11)));
+
+  Personality personality("EFDB8293-3E80-4048-908B-306E37842D59");
+  personality.SetManufacturerName("Fixtures \"R\" Us\\\t\x01\x7f \xC3\x9C");
+  auto red = std::unique_ptr<parameter::Parameter>(new parameter::ColorParameter);
+  dynamic_cast<parameter::ColorParameter *>(red.get())->SetColorParam(ColorTable::Color::kRed);
+  red->SetAddressCourse(3);
+  red->SetAddressFine(4);
+  red->SetHomeValue(1000);
+  personality.parameters_.push_back(std::move(red));
+  auto intensity = std::unique_ptr<parameter::Parameter>(new parameter::IntensityParameter);
+  intensity->SetAddressCourse(1);
+  intensity->SetInvert(true);
+  personality.parameters_.push_back(std::move(intensity));
+  auto gobo = std::unique_ptr<parameter::Parameter>(new parameter::BeamParameter);
+  gobo->SetName("Gobo");
+  gobo->SetAddressCourse(2);
+  parameter::Media gobo_media;
+  gobo_media.SetName("Stars");
+  gobo_media.SetGoboDcid("7F2FB4D2-2CB6-4C1E-8F40-4A5D4A4A6B2B");
+  parameter::Range stars(0, 10, 5);
+  stars.SetLabel("Stars");
+  stars.SetMedia(gobo_media);
+  gobo->ranges_.push_back(stars);
+  parameter::Media gel_media;
+  gel_media.SetName("Red");
+  gel_media.SetRgb(255, 0, 1);
+  parameter::Range gel(11, 20, 11);
+  gel.SetLabel("Red");
+  gel.SetMedia(gel_media);
+  gobo->ranges_.push_back(gel);
+  parameter::Range open(21, 255, 255);
+  open.SetLabel("Open");
+  gobo->ranges_.push_back(open);
+  personality.parameters_.push_back(std::move(gobo));
+  library.personalities.push_back(std::move(personality));
+
+  // No parameters
+  Personality empty_personality("4F5EC26C-D332-C146-8988-AEBA12B52916");
+  empty_personality.SetModeName("Basic");
+  library.personalities.push_back(std::move(empty_personality));
+
+  for (const auto format : {Library::Format::kPretty, Library::Format::kCompact}) {
+    std::ostringstream actual_stream;
+    library.Write(actual_stream, format);
+    const std::string actual = actual_stream.str();
+
+    nlohmann::json json = nlohmann::json::parse(actual);
+    json["personalities"] = library.personalities;
+    const std::string expected = json.dump(format == Library::Format::kPretty ? 4 : -1);
+    EXPECT_EQ(expected, actual);
+  }
+
+  // Empty library
+  library.personalities.clear();
+  std::ostringstream actual_stream;
+  actual_stream << library;
+  const std::string actual = actual_stream.str();
+  EXPECT_EQ(nlohmann::json::parse(actual).dump(4), actual);
+  EXPECT_NE(actual.find("\"personalities\": []"), std::string::npos);
+}
+
+TEST(LibraryTest, SaveFile) {
+  Library library;
+  library.SetUpdated(boost::posix_time::ptime(boost::gregorian::date(2020, 6, 28),
+                                              boost::posix_time::time_duration(15, 11, 11)));
+  Personality personality("EFDB8293-3E80-4048-908B-306E37842D59");
+  personality.SetModelName("test");
+  personality.parameters_.push_back(std::make_unique<parameter::IntensityParameter>());
+  library.personalities.push_back(std::move(personality));
+  std::ostringstream expected;
+  library.Write(expected);
+
+  const auto read_file = [](const std::filesystem::path &path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  };
+  const auto dir = std::filesystem::temp_directory_path() / std::tmpnam(nullptr);
+  std::filesystem::create_directory(dir);
+  const auto path = dir / "library.jlib";
+
+  // New file
+  library.Save(path.string());
+  EXPECT_EQ(read_file(path), expected.str());
+
+  // Replace an existing file
+  {
+    std::ofstream existing(path, std::ios::trunc);
+    existing << "Existing contents that are longer than the library file.";
+    existing << std::string(expected.str().size(), '-');
+  }
+  library.Save(path.string());
+  EXPECT_EQ(read_file(path), expected.str());
+  EXPECT_EQ(std::distance(std::filesystem::directory_iterator(dir), std::filesystem::directory_iterator()), 1);
+
+  // Doesn't touch a temporary file left by someone else
+  auto other_temp = path;
+  other_temp += ".tmp";
+  {
+    std::ofstream other(other_temp);
+    other << "Another writer";
+  }
+  library.Save(path.string());
+  EXPECT_EQ(read_file(path), expected.str());
+  EXPECT_EQ(read_file(other_temp), "Another writer");
+  std::filesystem::remove(other_temp);
+  EXPECT_EQ(std::distance(std::filesystem::directory_iterator(dir), std::filesystem::directory_iterator()), 1);
+
+  // Failures leave everything in place
+  EXPECT_THROW(library.Save((dir / "missing" / "library.jlib").string()), std::runtime_error);
+  const auto occupied = dir / "occupied";
+  std::filesystem::create_directories(occupied / "child");
+  EXPECT_THROW(library.Save(occupied.string()), std::runtime_error);
+  EXPECT_TRUE(std::filesystem::is_directory(occupied / "child"));
+  EXPECT_EQ(std::distance(std::filesystem::directory_iterator(dir), std::filesystem::directory_iterator()), 2);
+
+  std::filesystem::remove_all(dir);
+}
+
+TEST(LibraryTest, LoadFileProgress) {
+  Library library;
+  for (const auto &model_name : {"First", "Second", "Third"}) {
+    Personality personality;
+    personality.SetModelName(model_name);
+    personality.parameters_.push_back(std::make_unique<parameter::IntensityParameter>());
+    library.personalities.push_back(std::move(personality));
+  }
+  const auto path = std::filesystem::temp_directory_path() / std::tmpnam(nullptr);
+  library.Save(path.string());
+  const auto size = std::filesystem::file_size(path);
+
+  std::vector<unsigned long> positions;
+  const Library loaded(path.string(), [&positions, size](unsigned long current, unsigned long total) {
+    EXPECT_EQ(total, size);
+    positions.push_back(current);
+    return true;
+  });
+  EXPECT_EQ(loaded.personalities.size(), 3);
+  ASSERT_EQ(positions.size(), 3);
+  EXPECT_TRUE(std::is_sorted(positions.cbegin(), positions.cend()));
+  EXPECT_GT(positions.front(), 0);
+  EXPECT_LE(positions.back(), size);
+
+  // Stop after the first personality
+  unsigned int calls = 0;
+  EXPECT_THROW(Library(path.string(), [&calls](unsigned long, unsigned long) {
+    ++calls;
+    return false;
+  }), except::LoadCancelled);
+  EXPECT_EQ(calls, 1);
+
+  std::filesystem::remove(path);
+}